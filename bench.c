@@ -0,0 +1,275 @@
+/* * * * * * * * *
+ * Module for benchmarking hash tables: loads a whole file of interpreter
+ * commands into memory and replays it against a table with output turned
+ * off, timing every insert, lookup and delete
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#define _POSIX_C_SOURCE 199309L // for clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <time.h>
+
+#include "bench.h"
+
+#define INSERT 'i'
+#define LOOKUP 'l'
+#define DELETE 'd'
+#define QUIT   'q'
+
+// how many empty timer calls to make when estimating the timer's own cost
+#define CALIBRATION_ROUNDS 1000
+
+/* * * *
+ * helper functions
+ */
+
+// current time in nanoseconds, from a clock that never jumps
+static int64 now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// read the whole of 'file' into a null-terminated buffer
+static char *read_all(FILE *file) {
+	size_t size = 0;
+	size_t capacity = 1 << 16;
+	char *buffer = malloc(capacity);
+	assert(buffer);
+
+	size_t n;
+	while ((n = fread(buffer + size, 1, capacity - size - 1, file)) > 0) {
+		size += n;
+		if (size + 1 == capacity) {
+			capacity *= 2;
+			buffer = realloc(buffer, capacity);
+			assert(buffer);
+		}
+	}
+	buffer[size] = '\0';
+	return buffer;
+}
+
+// append a command to 'workload', growing its array if necessary
+static void add_command(Workload *workload, int *capacity, char op,
+	int64 key) {
+	if (workload->ncommands == *capacity) {
+		*capacity *= 2;
+		workload->commands = realloc(workload->commands,
+			(sizeof *workload->commands) * *capacity);
+		assert(workload->commands);
+	}
+	workload->commands[workload->ncommands].op = op;
+	workload->commands[workload->ncommands].key = key;
+	workload->ncommands++;
+}
+
+// estimate how long a pair of timer calls takes on its own, so that it can
+// be taken out of each measured latency
+static int64 timer_overhead() {
+	int64 best = UINT64_MAX;
+	int i;
+	for (i = 0; i < CALIBRATION_ROUNDS; i++) {
+		int64 start = now_ns();
+		int64 elapsed = now_ns() - start;
+		if (elapsed < best) {
+			best = elapsed;
+		}
+	}
+	return best;
+}
+
+static int compare_int64(const void *a, const void *b) {
+	int64 x = *(const int64 *)a;
+	int64 y = *(const int64 *)b;
+	return (x > y) - (x < y);
+}
+
+// fill in the totals and percentiles of 'stats' from its 'samples'
+static void summarise(OpStats *stats, int64 *samples) {
+	int64 total = 0;
+	int i;
+	for (i = 0; i < stats->count; i++) {
+		total += samples[i];
+	}
+	stats->seconds = total / 1e9;
+
+	if (stats->count == 0) {
+		stats->p50 = stats->p99 = stats->p999 = 0;
+		return;
+	}
+	qsort(samples, stats->count, sizeof *samples, compare_int64);
+	stats->p50  = samples[(int)(stats->count * 0.5)];
+	stats->p99  = samples[(int)(stats->count * 0.99)];
+	stats->p999 = samples[(int)(stats->count * 0.999)];
+}
+
+static void print_op_stats(const char *name, OpStats *stats) {
+	if (stats->count == 0) {
+		printf("%8s: no operations\n", name);
+		return;
+	}
+	double ns = stats->seconds * 1e9 / stats->count;
+	double ops = stats->seconds > 0 ? stats->count / stats->seconds : 0;
+	printf("%8s: %d ops (%d true), %.0f ops/sec, %.1f ns/op\n",
+		name, stats->count, stats->hits, ops, ns);
+	printf("%8s  latency p50 %llu ns, p99 %llu ns, p99.9 %llu ns\n",
+		"", stats->p50, stats->p99, stats->p999);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// read and parse all commands from file 'filename' ("-" for stdin) into
+// 'workload', stopping at the first quit command
+// returns false (and prints an error) if the file can't be read
+bool load_workload(Workload *workload, char *filename) {
+	FILE *file = stdin;
+	if (strcmp(filename, "-") != 0) {
+		file = fopen(filename, "r");
+		if (file == NULL) {
+			perror(filename);
+			return false;
+		}
+	}
+	char *text = read_all(file);
+	if (file != stdin) {
+		fclose(file);
+	}
+
+	int capacity = 1024;
+	workload->commands = malloc((sizeof *workload->commands) * capacity);
+	assert(workload->commands);
+	workload->ncommands = 0;
+	workload->ninserts = 0;
+	workload->nlookups = 0;
+	workload->ndeletes = 0;
+
+	// parse line by line. like 'get_command()', a key is read as an unsigned
+	// long long, so negative keys wrap around
+	char *line = text;
+	while (*line != '\0') {
+		char *end = strchr(line, '\n');
+		if (end != NULL) {
+			*end = '\0';
+		}
+
+		char op = line[0];
+		if (op == QUIT) {
+			break;
+		}
+		if (op == INSERT || op == LOOKUP || op == DELETE) {
+			char *rest = line + 1;
+			while (isspace((unsigned char)*rest)) {
+				rest++;
+			}
+			char *keyend;
+			int64 key = strtoull(rest, &keyend, 10);
+			if (keyend != rest) {
+				add_command(workload, &capacity, op, key);
+				if (op == INSERT) {
+					workload->ninserts++;
+				} else if (op == LOOKUP) {
+					workload->nlookups++;
+				} else {
+					workload->ndeletes++;
+				}
+			}
+		}
+		// other commands (print, stats, ...) produce output, so skip them
+
+		if (end == NULL) {
+			break;
+		}
+		line = end + 1;
+	}
+
+	free(text);
+	return true;
+}
+
+// free all memory associated with 'workload'
+void free_workload(Workload *workload) {
+	free(workload->commands);
+	workload->commands = NULL;
+	workload->ncommands = 0;
+}
+
+// replay 'workload' against 'table' without printing anything, and return
+// the timings of its inserts, lookups and deletes
+BenchResult run_workload(HashTable *table, Workload *workload) {
+	BenchResult result;
+	memset(&result, 0, sizeof result);
+
+	// one latency sample per operation, kept separately for each kind
+	int64 *insert_samples = malloc((sizeof *insert_samples)
+		* (workload->ninserts + 1));
+	assert(insert_samples);
+	int64 *lookup_samples = malloc((sizeof *lookup_samples)
+		* (workload->nlookups + 1));
+	assert(lookup_samples);
+	int64 *delete_samples = malloc((sizeof *delete_samples)
+		* (workload->ndeletes + 1));
+	assert(delete_samples);
+
+	int64 overhead = timer_overhead();
+
+	int i;
+	for (i = 0; i < workload->ncommands; i++) {
+		Command *command = &workload->commands[i];
+		int64 start, elapsed;
+		bool ok;
+
+		if (command->op == INSERT) {
+			start = now_ns();
+			ok = hash_table_insert(table, command->key);
+			elapsed = now_ns() - start;
+			insert_samples[result.insert.count++] =
+				elapsed > overhead ? elapsed - overhead : 0;
+			result.insert.hits += ok;
+
+		} else if (command->op == LOOKUP) {
+			start = now_ns();
+			ok = hash_table_lookup(table, command->key);
+			elapsed = now_ns() - start;
+			lookup_samples[result.lookup.count++] =
+				elapsed > overhead ? elapsed - overhead : 0;
+			result.lookup.hits += ok;
+
+		} else {
+			start = now_ns();
+			ok = hash_table_delete(table, command->key);
+			elapsed = now_ns() - start;
+			delete_samples[result.delete.count++] =
+				elapsed > overhead ? elapsed - overhead : 0;
+			result.delete.hits += ok;
+		}
+	}
+
+	summarise(&result.insert, insert_samples);
+	summarise(&result.lookup, lookup_samples);
+	summarise(&result.delete, delete_samples);
+
+	free(insert_samples);
+	free(lookup_samples);
+	free(delete_samples);
+	return result;
+}
+
+// print the throughput and latency of each operation in 'result' to stdout
+void print_bench_result(BenchResult *result) {
+	printf("--- benchmark ---\n");
+	print_op_stats("insert", &result->insert);
+	print_op_stats("lookup", &result->lookup);
+	print_op_stats("delete", &result->delete);
+	printf("--- end benchmark ---\n");
+}
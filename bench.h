@@ -0,0 +1,65 @@
+/* * * * * * * * *
+ * Module for benchmarking hash tables: loads a whole file of interpreter
+ * commands into memory and replays it against a table with output turned
+ * off, timing every insert, lookup and delete
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include "inthash.h"
+#include "hashtbl.h"
+
+// a single parsed command: an operation character and its key (if any)
+typedef struct command {
+	char op;
+	int64 key;
+} Command;
+
+// a workload is a whole command file, parsed up front so that reading and
+// parsing input doesn't get mixed up with the timings
+typedef struct workload {
+	Command *commands;	// array of commands, in file order
+	int ncommands;		// how many commands there are
+	int ninserts;		// how many of them are inserts
+	int nlookups;		// how many of them are lookups
+	int ndeletes;		// how many of them are deletes
+} Workload;
+
+// timing results for one kind of operation
+typedef struct op_stats {
+	int count;			// how many operations were timed
+	int hits;			// how many returned true (inserted / found / deleted)
+	double seconds;		// total time spent in these operations
+	int64 p50;			// latency percentiles, in nanoseconds
+	int64 p99;
+	int64 p999;
+} OpStats;
+
+// timing results for a whole workload
+typedef struct bench_result {
+	OpStats insert;
+	OpStats lookup;
+	OpStats delete;
+} BenchResult;
+
+// read and parse all commands from file 'filename' ("-" for stdin) into
+// 'workload', stopping at the first quit command
+// returns false (and prints an error) if the file can't be read
+bool load_workload(Workload *workload, char *filename);
+
+// free all memory associated with 'workload'
+void free_workload(Workload *workload);
+
+// replay 'workload' against 'table' without printing anything, and return
+// the timings of its inserts, lookups and deletes
+BenchResult run_workload(HashTable *table, Workload *workload);
+
+// print the throughput and latency of each operation in 'result' to stdout
+void print_bench_result(BenchResult *result);
+
+#endif
@@ -0,0 +1,440 @@
+/* * * * * * * * *
+ * Benchmark suite:
+ * runs every table type through the same key sets at a range of sizes, and
+ * prints throughput, memory usage and load factor for each run as CSV
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#define _POSIX_C_SOURCE 200809L // for clock_gettime, fork and friends
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "inthash.h"
+#include "hashtbl.h"
+#include "sharded.h"
+
+// command line options
+#define DEFAULT_MIN_KEYS 1000
+#define DEFAULT_MAX_KEYS 1000000
+#define DEFAULT_SIZE 4
+#define DEFAULT_SEED 1
+#define DEFAULT_TIMEOUT 600
+#define NTYPES (CXTNDBLN + 1)
+typedef struct options {
+	bool types[NTYPES];	// which table types to run (all, unless -t given)
+	int min_keys;		// smallest key set size
+	int max_keys;		// largest key set size (sizes go up by 10x)
+	int initial_size;	// passed to new_hash_table() as with 'a2 -s'
+	int64 seed;			// seed for generating keys
+	int timeout;		// seconds before a single run is abandoned
+	HashFamily family;	// hash functions for the tables to use
+	double max_load;	// load factor to grow at, or 0 for the table default
+	int shallow;		// directory bits to try lookups with first, or 0
+	bool batch;			// use hash_table_insert_batch() and _lookup_batch()
+	int shards;			// split each table into this many shards, or 0
+	int threads;		// build each table from all of its keys at once
+						// with hash_table_build_parallel() on this many
+						// threads, or 0 to insert them
+} Options;
+Options get_options(int argc, char** argv);
+
+
+/* * * *
+ * helper functions
+ */
+
+// current time in seconds, from a clock that never jumps
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// current resident set size of this process in bytes (0 if unknown)
+static long current_rss() {
+	long pages = 0;
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (statm) {
+		if (fscanf(statm, "%*ld %ld", &pages) != 1) {
+			pages = 0;
+		}
+		fclose(statm);
+	}
+	return pages * sysconf(_SC_PAGESIZE);
+}
+
+// peak resident set size of this process in kilobytes
+static long peak_rss_kb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+// key number 'i' of the key sets generated from 'seed'. keys 0..n-1 are
+// inserted, and keys n..2n-1 are used for lookups which should miss.
+// this mixing function is a bijection, so all of the keys are distinct
+static int64 nth_key(int64 seed, int64 i) {
+	int64 x = i + seed * 0x9e3779b97f4a7c15ULL;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+// shuffle 'keys' so that lookups don't visit keys in insertion order
+static void shuffle(int64 *keys, int n, int64 seed) {
+	int64 state = seed;
+	int i;
+	for (i = n - 1; i > 0; i--) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		int j = (state >> 33) % (i + 1);
+		int64 tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+}
+
+// the table a run works on: a plain table, or (with -S) a sharded one
+typedef struct subject {
+	HashTable *table;			// NULL if sharded
+	ShardedHashTable *sharded;	// NULL if not
+} Subject;
+
+// create the table for a run of type 'type', as set up by 'options'
+static Subject new_subject(Options *options, TableType type) {
+	Subject subject = { NULL, NULL };
+	if (options->shards) {
+		subject.sharded = new_sharded_hash_table(type, options->initial_size,
+			options->shards);
+		if (options->max_load > 0) {
+			sharded_hash_table_set_max_load(subject.sharded, options->max_load);
+		}
+		if (options->shallow > 0) {
+			sharded_hash_table_set_shallow_depth(subject.sharded,
+				options->shallow);
+		}
+	} else {
+		subject.table = new_hash_table(type, options->initial_size);
+		if (options->max_load > 0) {
+			hash_table_set_max_load(subject.table, options->max_load);
+		}
+		if (options->shallow > 0) {
+			hash_table_set_shallow_depth(subject.table, options->shallow);
+		}
+	}
+	return subject;
+}
+
+// build the table for a run of type 'type' from the 'n' keys in 'keys' on
+// 'options->threads' threads (with -P, which can't be combined with -S)
+static Subject build_subject(Options *options, TableType type, int64 *keys,
+	int n) {
+	Subject subject = { NULL, NULL };
+	subject.table = hash_table_build_parallel(type, options->initial_size,
+		keys, n, options->threads);
+	if (options->max_load > 0) {
+		hash_table_set_max_load(subject.table, options->max_load);
+	}
+	if (options->shallow > 0) {
+		hash_table_set_shallow_depth(subject.table, options->shallow);
+	}
+	return subject;
+}
+
+// free the table for a run
+static void free_subject(Subject *subject) {
+	if (subject->sharded) {
+		free_sharded_hash_table(subject->sharded);
+	} else {
+		free_hash_table(subject->table);
+	}
+}
+
+// the table operations a run makes, on whichever table it has
+static bool subject_insert(Subject *subject, int64 key) {
+	return subject->sharded ? sharded_hash_table_insert(subject->sharded, key)
+		: hash_table_insert(subject->table, key);
+}
+static int subject_insert_batch(Subject *subject, int64 *keys, int n,
+	bool *results) {
+	return subject->sharded
+		? sharded_hash_table_insert_batch(subject->sharded, keys, n, results)
+		: hash_table_insert_batch(subject->table, keys, n, results);
+}
+static bool subject_lookup(Subject *subject, int64 key) {
+	return subject->sharded ? sharded_hash_table_lookup(subject->sharded, key)
+		: hash_table_lookup(subject->table, key);
+}
+static int subject_lookup_batch(Subject *subject, int64 *keys, int n,
+	bool *results) {
+	return subject->sharded
+		? sharded_hash_table_lookup_batch(subject->sharded, keys, n, results)
+		: hash_table_lookup_batch(subject->table, keys, n, results);
+}
+static int subject_capacity(Subject *subject) {
+	return subject->sharded ? sharded_hash_table_capacity(subject->sharded)
+		: hash_table_capacity(subject->table);
+}
+
+// build a table of type 'type' from 'n' keys, then look them all up (and
+// 'n' keys which aren't there), printing a row of results
+// this runs in its own process, so that memory usage can be measured
+// independently and a crash or hang only loses one row
+static void run_one(Options *options, TableType type, int n) {
+	int64 *keys = malloc((sizeof *keys) * n);
+	assert(keys);
+	int i;
+	for (i = 0; i < n; i++) {
+		keys[i] = nth_key(options->seed, i);
+	}
+
+	long rss_before = current_rss();
+	Subject table = { NULL, NULL };
+	if (!options->threads) {
+		table = new_subject(options, type);
+	}
+
+	// inserts (or, with -P, the whole build; the lookups below check it)
+	bool *results = malloc((sizeof *results) * n);
+	assert(results);
+	int wrong = 0;
+	double start = now();
+	if (options->threads) {
+		table = build_subject(options, type, keys, n);
+	} else if (options->batch) {
+		wrong += n - subject_insert_batch(&table, keys, n, results);
+	} else {
+		for (i = 0; i < n; i++) {
+			wrong += !subject_insert(&table, keys[i]);
+		}
+	}
+	double insert_time = now() - start;
+	long rss_after = current_rss();
+
+	// successful lookups, in a different order
+	shuffle(keys, n, options->seed);
+	start = now();
+	if (options->batch) {
+		wrong += n - subject_lookup_batch(&table, keys, n, results);
+	} else {
+		for (i = 0; i < n; i++) {
+			wrong += !subject_lookup(&table, keys[i]);
+		}
+	}
+	double hit_time = now() - start;
+
+	// unsuccessful lookups
+	for (i = 0; i < n; i++) {
+		keys[i] = nth_key(options->seed, (int64)n + i);
+	}
+	start = now();
+	if (options->batch) {
+		wrong += subject_lookup_batch(&table, keys, n, results);
+	} else {
+		for (i = 0; i < n; i++) {
+			wrong += subject_lookup(&table, keys[i]);
+		}
+	}
+	double miss_time = now() - start;
+
+	int capacity = subject_capacity(&table);
+	printf("%s,%s,%d,%d,%d,%s,%.0f,%.0f,%.0f,%ld,%.2f,%.4f\n",
+		typetostr(type), familytostr(options->family), options->shards,
+		options->threads, n,
+		wrong ? "wrong" : "ok",
+		n / insert_time, n / hit_time, n / miss_time,
+		peak_rss_kb(), (rss_after - rss_before) * 1.0 / n,
+		capacity ? n * 1.0 / capacity : 0.0);
+	fflush(stdout);
+
+	free_subject(&table);
+	free(results);
+	free(keys);
+}
+
+// run 'run_one' in a child process, printing a row of its own if the child
+// doesn't finish successfully
+static void run_isolated(Options *options, TableType type, int n) {
+	fflush(stdout);
+	pid_t pid = fork();
+	assert(pid >= 0);
+
+	if (pid == 0) {
+		alarm(options->timeout);
+		run_one(options, type, n);
+		exit(EXIT_SUCCESS);
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+	if (WIFSIGNALED(status)) {
+		printf("%s,%s,%d,%d,%d,%s,,,,,,\n", typetostr(type),
+			familytostr(options->family), options->shards, options->threads, n,
+			WTERMSIG(status) == SIGALRM ? "timeout" : "crashed");
+	} else if (WEXITSTATUS(status) != EXIT_SUCCESS) {
+		printf("%s,%s,%d,%d,%d,failed,,,,,,\n", typetostr(type),
+			familytostr(options->family), options->shards, options->threads,
+			n);
+	}
+}
+
+
+// main program
+
+int main(int argc, char **argv) {
+	Options options = get_options(argc, argv);
+
+	set_hash_family(options.family);
+
+	printf("type,hash,shards,threads,keys,status,insert_ops_per_sec,hit_ops_per_sec,"
+		"miss_ops_per_sec,peak_rss_kb,bytes_per_key,load_factor\n");
+
+	long n;
+	for (n = options.min_keys; n <= options.max_keys; n *= 10) {
+		int type;
+		for (type = 0; type < NTYPES; type++) {
+			if (options.types[type]) {
+				run_isolated(&options, type, n);
+			}
+		}
+	}
+	return 0;
+}
+
+// scans command line arguments for program options,
+// prints usage info and exits if commands are missing or otherwise invalid
+Options get_options(int argc, char** argv) {
+
+	// create the Options structure with defaults
+	Options options = {
+		.min_keys = DEFAULT_MIN_KEYS, .max_keys = DEFAULT_MAX_KEYS,
+		.initial_size = DEFAULT_SIZE, .seed = DEFAULT_SEED,
+		.timeout = DEFAULT_TIMEOUT, .family = get_hash_family(),
+		.max_load = 0, .shallow = 0, .batch = false, .shards = 0,
+		.threads = 0
+	};
+	bool anytype = false;
+	bool valid = true;
+
+	// use C's built-in getopt function to scan inputs by flag
+	int option;
+	TableType type;
+	while ((option = getopt(argc, argv, "t:n:m:s:r:T:H:l:d:BS:P:")) != EOF) {
+		switch (option) {
+			case 't': // run this table type (may be given more than once)
+				type = strtotype(optarg);
+				if (type == NOTYPE) {
+					fprintf(stderr, "unknown table type '%s'\n", optarg);
+					valid = false;
+				} else {
+					options.types[type] = true;
+					anytype = true;
+				}
+				break;
+			case 'n': // set smallest number of keys
+				options.min_keys = atoi(optarg);
+				break;
+			case 'm': // set largest number of keys
+				options.max_keys = atoi(optarg);
+				break;
+			case 's': // set initial table size
+				options.initial_size = atoi(optarg);
+				break;
+			case 'r': // set random seed
+				options.seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'T': // set timeout per run
+				options.timeout = atoi(optarg);
+				break;
+			case 'H': // set hash function family
+				options.family = strtofamily(optarg);
+				break;
+			case 'l': // set maximum load factor
+				options.max_load = atof(optarg);
+				break;
+			case 'd': // set shallow directory depth for lookups
+				options.shallow = atoi(optarg);
+				break;
+			case 'B': // use batched inserts and lookups
+				options.batch = true;
+				break;
+			case 'S': // split each table into shards
+				options.shards = atoi(optarg);
+				break;
+			case 'P': // build each table on several threads
+				options.threads = atoi(optarg);
+				break;
+			default:
+				break;
+		}
+	}
+
+	// no types given? run them all
+	if (!anytype) {
+		for (type = 0; type < NTYPES; type++) {
+			options.types[type] = true;
+		}
+	}
+
+	// validation and printing error / usage messages
+	if (options.min_keys <= 0 || options.max_keys < options.min_keys) {
+		fprintf(stderr, "please specify a smallest (-n) and largest (-m) "
+			"number of keys, with 0 < n <= m\n");
+		valid = false;
+	}
+	if (options.initial_size <= 0) {
+		fprintf(stderr,
+			"please specify initial table size (>0) using the -s flag\n");
+		valid = false;
+	}
+
+	if (options.max_load < 0 || options.max_load > 1) {
+		fprintf(stderr, "maximum load factor (-l) must be between 0 and 1\n");
+		valid = false;
+	}
+	if (options.shallow < 0 || options.shallow > 30) {
+		fprintf(stderr, "shallow directory depth (-d) must be between 0 and "
+			"30\n");
+		valid = false;
+	}
+	if (options.shards < 0 || (options.shards & (options.shards - 1))) {
+		fprintf(stderr, "number of shards (-S) must be a power of two (or 0 "
+			"for none)\n");
+		valid = false;
+	}
+	if (options.threads < 0) {
+		fprintf(stderr, "number of build threads (-P) must be positive (or 0 "
+			"to insert keys instead)\n");
+		valid = false;
+	}
+	if (options.threads && options.shards) {
+		fprintf(stderr, "parallel builds (-P) can't be sharded (-S)\n");
+		valid = false;
+	}
+	if (options.family == NOFAMILY) {
+		fprintf(stderr, "hash family (-H) must be one of modprime, multshift, "
+			"splitmix or wyhash\n");
+		valid = false;
+	}
+
+	// check overall validity before continuing
+	if (!valid) {
+		exit(EXIT_FAILURE);
+	}
+
+	return options;
+}
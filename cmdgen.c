@@ -0,0 +1,473 @@
+/* * * * * * * * *
+ * Command generator:
+ * writes a stream of hash table interpreter commands (in the format read by
+ * 'get_command()' in main.c) to stdout, for producing repeatable workloads
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "inthash.h"
+
+// the key distributions we know how to generate
+typedef enum distribution {
+	NODIST = -1, UNIFORM, ZIPF, SEQUENTIAL, ADVERSARIAL
+} Distribution;
+
+// command line options
+#define DEFAULT_OPS 1000
+#define DEFAULT_INSERT 50.0
+#define DEFAULT_HIT 50.0
+#define DEFAULT_DELETE 0.0
+#define DEFAULT_SKEW 0.99
+#define DEFAULT_SEED 1
+#define DEFAULT_BITS 10
+typedef struct options {
+	Distribution dist;
+	int nops;			// how many insert/lookup commands to generate
+	int keyspace;		// how many distinct keys inserts are drawn from
+	double insert;		// percentage of commands which are inserts
+	double hit;			// percentage of lookups which should be found
+	double delete;		// percentage of commands which delete an inserted key
+	double skew;		// zipf skew parameter (theta)
+	int64 seed;			// random seed, same seed means same commands
+	int bits;			// adversarial keys share this many hash bits
+	bool top;			// share the top bits rather than the lowest ones?
+	bool stats;			// finish with a stats command before quitting?
+	HashFamily family;	// hash functions to collide under (for ADVERSARIAL)
+} Options;
+Options get_options(int argc, char** argv);
+
+
+/* * * *
+ * random number generation
+ */
+
+// splitmix64 generator state: small, fast and (most importantly) gives the
+// same sequence on every platform for a given seed
+static int64 rng_state;
+
+static int64 next_random() {
+	int64 z = (rng_state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// uniform random integer in [0, n)
+static int64 random_below(int64 n) {
+	return next_random() % n;
+}
+
+// uniform random double in [0, 1)
+static double random_unit() {
+	return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// scramble a key index into a key. this is a bijection on 64-bit integers
+// (each step is invertible), so distinct indices always give distinct keys
+static int64 scramble(int64 x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+
+/* * * *
+ * zipfian distribution
+ * using the method from Gray et al., "Quickly Generating Billion-Record
+ * Synthetic Databases" (SIGMOD 1994), as popularised by YCSB
+ */
+
+typedef struct zipf {
+	int64 n;		// number of items
+	double theta;	// skew
+	double alpha;	// 1 / (1 - theta)
+	double zetan;	// zeta(n, theta)
+	double eta;
+	double half;	// 1 + 0.5^theta
+} Zipf;
+
+static double zeta(int64 n, double theta) {
+	double sum = 0;
+	int64 i;
+	for (i = 1; i <= n; i++) {
+		sum += 1.0 / pow(i, theta);
+	}
+	return sum;
+}
+
+static void initialise_zipf(Zipf *zipf, int64 n, double theta) {
+	zipf->n = n;
+	zipf->theta = theta;
+	zipf->alpha = 1.0 / (1.0 - theta);
+	zipf->zetan = zeta(n, theta);
+	zipf->eta = (1.0 - pow(2.0 / n, 1.0 - theta))
+		/ (1.0 - zeta(2, theta) / zipf->zetan);
+	zipf->half = 1.0 + pow(0.5, theta);
+}
+
+// random rank in [0, n), where rank 0 is the most popular
+static int64 next_zipf(Zipf *zipf) {
+	double u = random_unit();
+	double uz = u * zipf->zetan;
+	if (uz < 1.0) {
+		return 0;
+	}
+	if (uz < zipf->half) {
+		return 1;
+	}
+	int64 rank = zipf->n * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha);
+	return rank < zipf->n ? rank : zipf->n - 1;
+}
+
+
+/* * * *
+ * adversarial keys
+ */
+
+// the 'bits' bits of 'hash' that adversarial keys must agree in: the top
+// ones if 'top', else the lowest ones
+static int64 collision_bits(int64 hash, int bits, bool top) {
+	if (top) {
+		return hash >> (64 - bits);
+	}
+	return hash & (((int64)1 << bits) - 1);
+}
+
+// next key (after 'k') whose first hash (from the chosen family) agrees with
+// 'target' in 'bits' bits (the top ones if 'top', else the lowest ones).
+// keys agreeing in the lowest bits collide in every table that masks hash
+// values down to up to 'bits' bits (linear, swiss and bcuckoo tables of size
+// <= 2^bits, and extendible tables of depth <= bits). keys agreeing in the
+// top bits collide in tables that scale hash values down to their size
+// (with 'hash_to_range()', as cuckoo tables do) instead, unless the family
+// is modprime (whose range reduction is a plain remainder)
+static int64 next_colliding_key(int64 k, int bits, bool top, int64 target) {
+	do {
+		k++;
+	} while (collision_bits(h1_64(k), bits, top) != target);
+	return k;
+}
+
+
+/* * * *
+ * workload generation
+ */
+
+// a generator maps random choices onto concrete keys for one distribution
+typedef struct generator {
+	Options *options;
+	Zipf zipf;			// only used for ZIPF
+	int64 *colliding;	// only used for ADVERSARIAL: the insertable keys
+	int64 target;		// only used for ADVERSARIAL: the shared hash bits
+	int64 lastmiss;		// only used for ADVERSARIAL: last key used as a miss
+	int64 next;			// only used for SEQUENTIAL: next index to insert
+	int64 salt;			// offsets indices before scrambling, from the seed
+
+	unsigned char *present;	// bitmap of key indices inserted so far
+	int64 *inserted;		// the distinct key indices inserted so far
+	int ninserted;			// how many of them there are
+} Generator;
+
+#define TESTBIT(map, i) ((map)[(i) >> 3] &  (1 << ((i) & 7)))
+#define SETBIT(map, i)  ((map)[(i) >> 3] |= (1 << ((i) & 7)))
+#define CLEARBIT(map, i) ((map)[(i) >> 3] &= ~(1 << ((i) & 7)))
+
+static void initialise_generator(Generator *gen, Options *options) {
+	gen->options = options;
+	gen->salt = next_random();
+	gen->next = 0;
+
+	int64 n = options->keyspace;
+	gen->present = calloc(n / 8 + 1, sizeof *gen->present);
+	assert(gen->present);
+	gen->inserted = malloc((sizeof *gen->inserted) * n);
+	assert(gen->inserted);
+	gen->ninserted = 0;
+
+	gen->colliding = NULL;
+	if (options->dist == ZIPF) {
+		initialise_zipf(&gen->zipf, n, options->skew);
+
+	} else if (options->dist == ADVERSARIAL) {
+		gen->colliding = malloc((sizeof *gen->colliding) * n);
+		assert(gen->colliding);
+		gen->target = collision_bits(h1_64(0), options->bits, options->top);
+		int64 k = 0;
+		int64 i;
+		for (i = 0; i < n; i++) {
+			k = next_colliding_key(k, options->bits, options->top,
+				gen->target);
+			gen->colliding[i] = k;
+		}
+		gen->lastmiss = k;
+	}
+}
+
+static void free_generator(Generator *gen) {
+	free(gen->present);
+	free(gen->inserted);
+	free(gen->colliding);
+}
+
+// the key corresponding to key index 'i' (for i < keyspace)
+static int64 index_to_key(Generator *gen, int64 i) {
+	switch (gen->options->dist) {
+		case SEQUENTIAL:
+			return i + 1;
+		case ADVERSARIAL:
+			return gen->colliding[i];
+		default:
+			return scramble(i + gen->salt);
+	}
+}
+
+// choose the index of a key to insert, according to the distribution
+static int64 next_insert_index(Generator *gen) {
+	switch (gen->options->dist) {
+		case ZIPF:
+			// scatter the popular ranks across the key space
+			return scramble(next_zipf(&gen->zipf) ^ gen->salt)
+				% gen->options->keyspace;
+		case SEQUENTIAL:
+			return gen->next++ % gen->options->keyspace;
+		default:
+			return random_below(gen->options->keyspace);
+	}
+}
+
+// a key which has definitely been inserted already
+static int64 next_hit_key(Generator *gen) {
+	// prefer following the insert distribution, so that popular keys are
+	// looked up often, but fall back to any inserted key
+	int tries;
+	if (gen->options->dist != SEQUENTIAL) {
+		for (tries = 0; tries < 8; tries++) {
+			int64 i = next_insert_index(gen);
+			if (TESTBIT(gen->present, i)) {
+				return index_to_key(gen, i);
+			}
+		}
+	}
+	return index_to_key(gen, gen->inserted[random_below(gen->ninserted)]);
+}
+
+// remove a random key from those inserted so far, and return it
+static int64 next_delete_key(Generator *gen) {
+	int position = random_below(gen->ninserted);
+	int64 index = gen->inserted[position];
+	gen->inserted[position] = gen->inserted[--gen->ninserted];
+	CLEARBIT(gen->present, index);
+	return index_to_key(gen, index);
+}
+
+// a key which will never be inserted
+static int64 next_miss_key(Generator *gen) {
+	int64 n = gen->options->keyspace;
+	switch (gen->options->dist) {
+		case SEQUENTIAL:
+			return n + 1 + random_below(n);
+		case ADVERSARIAL:
+			// keep colliding, but with keys outside the insertable set
+			gen->lastmiss = next_colliding_key(gen->lastmiss,
+				gen->options->bits, gen->options->top, gen->target);
+			return gen->lastmiss;
+		default:
+			// indices from [n, 2n) scramble to keys no insert can produce
+			return scramble(n + random_below(n) + gen->salt);
+	}
+}
+
+static void generate(Options *options) {
+	Generator gen;
+	initialise_generator(&gen, options);
+
+	int i;
+	for (i = 0; i < options->nops; i++) {
+		double choice = random_unit() * 100;
+		if (choice < options->insert) {
+			int64 index = next_insert_index(&gen);
+			if (!TESTBIT(gen.present, index)) {
+				SETBIT(gen.present, index);
+				gen.inserted[gen.ninserted++] = index;
+			}
+			printf("i %llu\n", index_to_key(&gen, index));
+
+		} else if (choice < options->insert + options->delete) {
+			if (gen.ninserted > 0) {
+				printf("d %llu\n", next_delete_key(&gen));
+			} else {
+				printf("d %llu\n", next_miss_key(&gen));
+			}
+
+		} else if (gen.ninserted > 0 && random_unit() * 100 < options->hit) {
+			printf("l %llu\n", next_hit_key(&gen));
+
+		} else {
+			printf("l %llu\n", next_miss_key(&gen));
+		}
+	}
+
+	if (options->stats) {
+		printf("s\n");
+	}
+	printf("q\n");
+
+	free_generator(&gen);
+}
+
+
+// main program
+
+int main(int argc, char **argv) {
+	Options options = get_options(argc, argv);
+	rng_state = options.seed;
+	set_hash_family(options.family);
+	generate(&options);
+	return 0;
+}
+
+// converts from a string representation to a Distribution constant
+static Distribution strtodist(char *str) {
+	if (strcmp("uniform", str) == 0) {
+		return UNIFORM;
+	}
+	if (strcmp("zipf", str) == 0) {
+		return ZIPF;
+	}
+	if (strcmp("sequential", str) == 0) {
+		return SEQUENTIAL;
+	}
+	if (strcmp("adversarial", str) == 0) {
+		return ADVERSARIAL;
+	}
+	return NODIST;
+}
+
+// scans command line arguments for program options,
+// prints usage info and exits if commands are missing or otherwise invalid
+Options get_options(int argc, char** argv) {
+
+	// create the Options structure with defaults
+	Options options = {
+		.dist = UNIFORM, .nops = DEFAULT_OPS, .keyspace = 0,
+		.insert = DEFAULT_INSERT, .hit = DEFAULT_HIT,
+		.delete = DEFAULT_DELETE, .skew = DEFAULT_SKEW,
+		.seed = DEFAULT_SEED, .bits = DEFAULT_BITS, .top = false,
+		.stats = false,
+		.family = get_hash_family()
+	};
+
+	// use C's built-in getopt function to scan inputs by flag
+	int option;
+	while ((option = getopt(argc, argv, "d:n:k:i:x:h:z:r:b:TsH:")) != EOF) {
+		switch (option) {
+			case 'd': // set key distribution
+				options.dist = strtodist(optarg);
+				break;
+			case 'n': // set number of commands
+				options.nops = atoi(optarg);
+				break;
+			case 'k': // set number of distinct keys
+				options.keyspace = atoi(optarg);
+				break;
+			case 'i': // set insert percentage
+				options.insert = atof(optarg);
+				break;
+			case 'x': // set delete percentage
+				options.delete = atof(optarg);
+				break;
+			case 'h': // set lookup hit percentage
+				options.hit = atof(optarg);
+				break;
+			case 'z': // set zipf skew
+				options.skew = atof(optarg);
+				break;
+			case 'r': // set random seed
+				options.seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'b': // set adversarial collision bits
+				options.bits = atoi(optarg);
+				break;
+			case 'T': // collide in the top hash bits instead
+				options.top = true;
+				break;
+			case 's': // print stats at the end
+				options.stats = true;
+				break;
+			case 'H': // set hash function family
+				options.family = strtofamily(optarg);
+				break;
+			default:
+				break;
+		}
+	}
+
+	// by default, there are as many distinct keys as commands
+	if (options.keyspace == 0) {
+		options.keyspace = options.nops;
+	}
+
+	// validation and printing error / usage messages
+	bool valid = true;
+
+	if (options.dist == NODIST) {
+		fprintf(stderr, "please specify a key distribution using the -d "
+			"flag:\n");
+		fprintf(stderr, " -d uniform:     keys chosen uniformly at random\n");
+		fprintf(stderr, " -d zipf:        popular keys chosen more often "
+			"(skew set with -z)\n");
+		fprintf(stderr, " -d sequential:  keys 1, 2, 3, ... in order\n");
+		fprintf(stderr, " -d adversarial: keys with colliding hash values "
+			"(bits set with -b, and -T\n"
+			"                 to collide in the top bits, as cuckoo tables "
+			"use)\n");
+		valid = false;
+	}
+	if (options.nops < 0 || options.keyspace <= 0) {
+		fprintf(stderr, "please specify a number of commands (-n) and "
+			"distinct keys (-k) greater than 0\n");
+		valid = false;
+	}
+	if (options.insert < 0 || options.delete < 0
+			|| options.insert + options.delete > 100
+			|| options.hit < 0 || options.hit > 100) {
+		fprintf(stderr, "insert (-i), delete (-x) and hit (-h) percentages "
+			"must be between 0 and 100 (and -i plus -x at most 100)\n");
+		valid = false;
+	}
+	if (options.skew <= 0 || options.skew == 1) {
+		fprintf(stderr, "zipf skew (-z) must be positive and not equal to 1\n");
+		valid = false;
+	}
+	if (options.bits < 1 || options.bits > 30) {
+		fprintf(stderr, "adversarial collision bits (-b) must be between "
+			"1 and 30\n");
+		valid = false;
+	}
+
+	if (options.family == NOFAMILY) {
+		fprintf(stderr, "hash family (-H) must be one of modprime, multshift, "
+			"splitmix or wyhash\n");
+		valid = false;
+	}
+
+	// check overall validity before continuing
+	if (!valid) {
+		exit(EXIT_FAILURE);
+	}
+
+	return options;
+}
@@ -0,0 +1,337 @@
+/* * * * * * * * *
+ * Concurrent benchmark:
+ * builds a table of one type, then has several threads look its keys up
+ * while other threads insert (and then delete) as many keys again, and
+ * prints the throughput of each side as CSV. every lookup is of a key that
+ * stays in the table throughout, so any lookup that misses is an error
+ * (as is any insert or delete that fails, since each writer has keys of its
+ * own)
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#define _POSIX_C_SOURCE 200809L // for clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "inthash.h"
+#include "hashtbl.h"
+#include "sharded.h"
+
+// command line options
+#define DEFAULT_KEYS 1000000
+#define DEFAULT_READERS 4
+#define DEFAULT_WRITERS 1
+#define DEFAULT_SIZE 4
+#define DEFAULT_SEED 1
+typedef struct options {
+	TableType type;		// which table type to run
+	int nkeys;			// how many keys to build the table from (and then
+						// insert and delete while reading)
+	int nreaders;		// how many threads to look keys up from
+	int nwriters;		// how many threads to insert and delete keys from
+	int initial_size;	// passed to new_hash_table() as with 'a2 -s'
+	int64 seed;			// seed for generating keys
+	HashFamily family;	// hash functions for the table to use
+	int shards;			// split the table into this many shards, or 0
+} Options;
+Options get_options(int argc, char** argv);
+
+// the table the threads share: a plain table, or (with -S) a sharded one
+// (as in benchmark.c)
+typedef struct subject {
+	HashTable *table;			// NULL if sharded
+	ShardedHashTable *sharded;	// NULL if not
+} Subject;
+
+// what each reader thread needs to know, and what it found out
+typedef struct reader {
+	pthread_t thread;
+	Subject *table;
+	int64 *keys;		// the keys to look up (all in the table)
+	int nkeys;
+	int first;			// where in 'keys' this reader starts
+	bool *stop;			// set once the writer is done
+	long lookups;		// how many lookups this reader made
+	long errors;		// how many of them failed to find their key
+} Reader;
+
+
+/* * * *
+ * helper functions
+ */
+
+// current time in seconds, from a clock that never jumps
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// key number 'i' of the key sets generated from 'seed' (as in benchmark.c)
+static int64 nth_key(int64 seed, int64 i) {
+	int64 x = i + seed * 0x9e3779b97f4a7c15ULL;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+// the table operations the threads make, on whichever table they share
+static bool subject_insert(Subject *subject, int64 key) {
+	return subject->sharded ? sharded_hash_table_insert(subject->sharded, key)
+		: hash_table_insert(subject->table, key);
+}
+static bool subject_lookup(Subject *subject, int64 key) {
+	return subject->sharded ? sharded_hash_table_lookup(subject->sharded, key)
+		: hash_table_lookup(subject->table, key);
+}
+static bool subject_delete(Subject *subject, int64 key) {
+	return subject->sharded ? sharded_hash_table_delete(subject->sharded, key)
+		: hash_table_delete(subject->table, key);
+}
+
+// what each writer thread needs to know, and what it found out
+typedef struct writer {
+	pthread_t thread;
+	Subject *table;
+	int64 *keys;		// the keys to insert and then delete (none of them in
+	int nkeys;			// the table to begin with, nor given to other writers)
+	long errors;		// how many inserts or deletes failed
+} Writer;
+
+
+// look keys up (walking through them from the reader's starting point) until
+// told to stop, counting lookups and any which fail
+static void *run_reader(void *arg) {
+	Reader *reader = arg;
+	int i = reader->first;
+	long lookups = 0, errors = 0;
+	while (!__atomic_load_n(reader->stop, __ATOMIC_RELAXED)) {
+		if (!subject_lookup(reader->table, reader->keys[i])) {
+			errors++;
+		}
+		lookups++;
+		if (++i == reader->nkeys) {
+			i = 0;
+		}
+	}
+	reader->lookups = lookups;
+	reader->errors = errors;
+	return NULL;
+}
+
+// insert all of the writer's keys, and then delete them all again
+static void *run_writer(void *arg) {
+	Writer *writer = arg;
+	long errors = 0;
+	int i;
+	for (i = 0; i < writer->nkeys; i++) {
+		if (!subject_insert(writer->table, writer->keys[i])) {
+			errors++;
+		}
+	}
+	for (i = 0; i < writer->nkeys; i++) {
+		if (!subject_delete(writer->table, writer->keys[i])) {
+			errors++;
+		}
+	}
+	writer->errors = errors;
+	return NULL;
+}
+
+
+/* * * *
+ * main program
+ */
+
+int main(int argc, char **argv) {
+	Options options = get_options(argc, argv);
+	set_hash_family(options.family);
+	int n = options.nkeys;
+
+	// keys 0..n-1 stay in the table, keys n..2n-1 come and go
+	int64 *keys = malloc((sizeof *keys) * 2 * n);
+	assert(keys);
+	int i;
+	for (i = 0; i < 2 * n; i++) {
+		keys[i] = nth_key(options.seed, i);
+	}
+
+	// (shards each have a lock of their own, so a sharded table doesn't need
+	// concurrent reads turned on)
+	Subject subject = { NULL, NULL };
+	Subject *table = &subject;
+	if (options.shards) {
+		subject.sharded = new_sharded_hash_table(options.type,
+			options.initial_size, options.shards);
+	} else {
+		subject.table = new_hash_table(options.type, options.initial_size);
+	}
+	for (i = 0; i < n; i++) {
+		subject_insert(table, keys[i]);
+	}
+	if (!options.shards) {
+		hash_table_set_concurrent_reads(subject.table, true);
+	}
+
+	// start the readers, spread out over the keys (allocating one spare, so
+	// that there's still something to allocate with no readers)
+	bool stop = false;
+	Reader *readers = malloc((sizeof *readers) * (options.nreaders + 1));
+	assert(readers);
+	int r;
+	for (r = 0; r < options.nreaders; r++) {
+		readers[r] = (Reader){ .table = table, .keys = keys, .nkeys = n,
+			.first = (int)((int64)n * r / options.nreaders), .stop = &stop };
+		int error = pthread_create(&readers[r].thread, NULL, run_reader,
+			&readers[r]);
+		assert(!error);
+	}
+
+	// meanwhile, grow the table to twice the size and shrink it back again,
+	// with the keys to do so split between the writers
+	Writer *writers = malloc((sizeof *writers) * options.nwriters);
+	assert(writers);
+	double start = now();
+	int w;
+	for (w = 0; w < options.nwriters; w++) {
+		int first = (int)((int64)n * w / options.nwriters);
+		int last = (int)((int64)n * (w + 1) / options.nwriters);
+		writers[w] = (Writer){ .table = table, .keys = keys + n + first,
+			.nkeys = last - first };
+		int error = pthread_create(&writers[w].thread, NULL, run_writer,
+			&writers[w]);
+		assert(!error);
+	}
+	long errors = 0;
+	for (w = 0; w < options.nwriters; w++) {
+		pthread_join(writers[w].thread, NULL);
+		errors += writers[w].errors;
+	}
+	double seconds = now() - start;
+
+	__atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+	long lookups = 0;
+	for (r = 0; r < options.nreaders; r++) {
+		pthread_join(readers[r].thread, NULL);
+		lookups += readers[r].lookups;
+		errors += readers[r].errors;
+	}
+
+	printf("type,hash,shards,keys,readers,writers,status,write_ops_per_sec,"
+		"read_ops_per_sec,errors\n");
+	printf("%s,%s,%d,%d,%d,%d,%s,%.0f,%.0f,%ld\n", typetostr(options.type),
+		familytostr(options.family), options.shards, n, options.nreaders,
+		options.nwriters,
+		errors ? "wrong" : "ok", 2 * n / seconds, lookups / seconds, errors);
+
+	free(writers);
+	free(readers);
+	if (options.shards) {
+		free_sharded_hash_table(subject.sharded);
+	} else {
+		free_hash_table(subject.table);
+	}
+	free(keys);
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+// scans command line arguments for program options,
+// prints usage info and exits if options are missing or otherwise invalid
+Options get_options(int argc, char** argv) {
+
+	// create the Options structure with defaults
+	Options options = {
+		.type = NOTYPE, .nkeys = DEFAULT_KEYS, .nreaders = DEFAULT_READERS,
+		.nwriters = DEFAULT_WRITERS,
+		.initial_size = DEFAULT_SIZE, .seed = DEFAULT_SEED,
+		.family = get_hash_family(), .shards = 0
+	};
+	bool valid = true;
+
+	// use C's built-in getopt function to scan inputs by flag
+	int option;
+	while ((option = getopt(argc, argv, "t:n:j:w:s:r:H:S:")) != EOF) {
+		switch (option) {
+			case 't': // set table type
+				options.type = strtotype(optarg);
+				break;
+			case 'n': // set number of keys
+				options.nkeys = atoi(optarg);
+				break;
+			case 'j': // set number of reader threads
+				options.nreaders = atoi(optarg);
+				break;
+			case 'w': // set number of writer threads
+				options.nwriters = atoi(optarg);
+				break;
+			case 's': // set initial table size
+				options.initial_size = atoi(optarg);
+				break;
+			case 'r': // set random seed
+				options.seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'H': // set hash function family
+				options.family = strtofamily(optarg);
+				break;
+			case 'S': // split the table into shards
+				options.shards = atoi(optarg);
+				break;
+			default:
+				break;
+		}
+	}
+
+	// validation and printing error / usage messages
+	if (options.type == NOTYPE) {
+		fprintf(stderr, "please specify a table type with -t (as for a2)\n");
+		valid = false;
+	}
+	if (options.nkeys <= 0) {
+		fprintf(stderr, "please specify a number of keys (>0) with -n\n");
+		valid = false;
+	}
+	if (options.nreaders < 0) {
+		fprintf(stderr, "please specify a number of readers (>=0) with -j\n");
+		valid = false;
+	}
+	if (options.nwriters <= 0 || options.nwriters > options.nkeys) {
+		fprintf(stderr, "please specify a number of writers (>0, and no more "
+			"than keys) with -w\n");
+		valid = false;
+	}
+	if (options.initial_size <= 0) {
+		fprintf(stderr,
+			"please specify initial table size (>0) using the -s flag\n");
+		valid = false;
+	}
+	if (options.shards < 0 || (options.shards & (options.shards - 1))) {
+		fprintf(stderr, "number of shards (-S) must be a power of two (or 0 "
+			"for none)\n");
+		valid = false;
+	}
+	if (options.family == NOFAMILY) {
+		fprintf(stderr, "hash family (-H) must be one of modprime, multshift, "
+			"splitmix or wyhash\n");
+		valid = false;
+	}
+
+	// check overall validity before continuing
+	if (!valid) {
+		exit(EXIT_FAILURE);
+	}
+
+	return options;
+}
@@ -18,6 +18,18 @@
 #include "tables/xtndbln.h" // create for part 2
 #include "tables/xuckoo.h"	// create for part 3
 #include "tables/xuckoon.h"
+#include "tables/swiss.h"
+#include "tables/bcuckoo.h"
+#include "tables/ccuckoo.h"
+#include "tables/clinear.h"
+#include "tables/cxtndbln.h"
+#include "tables/seqlock.h"
+#include "tables/parallel.h"
+
+// lookup batches are split into pieces of this many keys, each read on its
+// own, so that a steady stream of writes can't keep forcing a whole batch
+// to be repeated
+#define READ_PIECE 256
 
 // converts from a string representation to a TableType constant:
 // "linear"			->	LINEAR
@@ -25,6 +37,12 @@
 // "1" or "cuckoo"	->	CUCKOO
 // "2" or "xtndbln"	->	XTNDBLN
 // "3" or "xuckoo"	->	XUCKOO
+// "4" or "xuckoon" ->  XUCKOON
+// "swiss"			->	SWISS
+// "bcuckoo"		->	BCUCKOO
+// "ccuckoo"		->	CCUCKOO
+// "clinear"		->	CLINEAR
+// "cxtndbln"		->	CXTNDBLN
 TableType strtotype(char *str) {
 	if (strcmp("linear",  str) == 0) {
 		return LINEAR;
@@ -44,16 +62,72 @@ TableType strtotype(char *str) {
 	if (strcmp("4", str) == 0 || strcmp("xuckoon", str) == 0) {
 		return XUCKOON;
 	}
+	if (strcmp("swiss", str) == 0) {
+		return SWISS;
+	}
+	if (strcmp("bcuckoo", str) == 0) {
+		return BCUCKOO;
+	}
+	if (strcmp("ccuckoo", str) == 0) {
+		return CCUCKOO;
+	}
+	if (strcmp("clinear", str) == 0) {
+		return CLINEAR;
+	}
+	if (strcmp("cxtndbln", str) == 0) {
+		return CXTNDBLN;
+	}
 	return NOTYPE;
 }
 
+// converts from a TableType constant to its name (e.g. LINEAR -> "linear")
+char *typetostr(TableType type) {
+	switch (type) {
+		case LINEAR:
+			return "linear";
+		case XTNDBL1:
+			return "xtndbl1";
+		case CUCKOO:
+			return "cuckoo";
+		case XTNDBLN:
+			return "xtndbln";
+		case XUCKOO:
+			return "xuckoo";
+		case XUCKOON:
+			return "xuckoon";
+		case SWISS:
+			return "swiss";
+		case BCUCKOO:
+			return "bcuckoo";
+		case CCUCKOO:
+			return "ccuckoo";
+		case CLINEAR:
+			return "clinear";
+		case CXTNDBLN:
+			return "cxtndbln";
+		default:
+			return "none";
+	}
+}
+
 // a HashTable is a wrapper for an actual table structure of some type,
 // and it also remembers is own type
 struct table {
 	TableType type;	// what type of hash table is this?
 	void *table;	// the hash table itself
+	SeqLock *lock;	// lets readers run alongside a writer (NULL unless
+					// concurrent reads are turned on)
 };
 
+// the keys a concurrent table is being built from, shared between the
+// threads inserting them (see 'hash_table_build_parallel()')
+typedef struct build {
+	HashTable *table;
+	int64 *keys;
+	int n;
+	int nthreads;
+} Build;
+
 // initialise a hash table of type 'type' with initial size 'size',
 // and return its pointer
 HashTable *new_hash_table(TableType type, int size) {
@@ -64,6 +138,7 @@ HashTable *new_hash_table(TableType type, int size) {
 
 	// store the table type, so we know which functions to call later
 	table->type = type;
+	table->lock = NULL;
 
 	// create and store the table itself
 	switch (type) {
@@ -85,6 +160,21 @@ HashTable *new_hash_table(TableType type, int size) {
 		case XUCKOON:
 			table->table = new_xuckoon_hash_table(size);
 			break;
+		case SWISS:
+			table->table = new_swiss_hash_table(size);
+			break;
+		case BCUCKOO:
+			table->table = new_bcuckoo_hash_table(size);
+			break;
+		case CCUCKOO:
+			table->table = new_ccuckoo_hash_table(size);
+			break;
+		case CLINEAR:
+			table->table = new_clinear_hash_table(size);
+			break;
+		case CXTNDBLN:
+			table->table = new_cxtndbln_hash_table(size);
+			break;
 		default:
 			// no such table type? error. release memory and return NULL
 			free(table);
@@ -118,19 +208,35 @@ void free_hash_table(HashTable *table) {
 		case XUCKOON:
 			free_xuckoon_hash_table(table->table);
 			break;
+		case SWISS:
+			free_swiss_hash_table(table->table);
+			break;
+		case BCUCKOO:
+			free_bcuckoo_hash_table(table->table);
+			break;
+		case CCUCKOO:
+			free_ccuckoo_hash_table(table->table);
+			break;
+		case CLINEAR:
+			free_clinear_hash_table(table->table);
+			break;
+		case CXTNDBLN:
+			free_cxtndbln_hash_table(table->table);
+			break;
 		default:
 			break;
 	}
 
 	// free the wrapper struct itself
+	if (table->lock) {
+		free_seqlock(table->lock);
+	}
 	free(table);
 }
 
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
-bool hash_table_insert(HashTable *table, int64 key) {
-	assert(table != NULL);
-
+static bool insert_key(HashTable *table, int64 key) {
 	// forward the call onto the relevant insert function
 	switch (table->type) {
 		case LINEAR:
@@ -145,16 +251,55 @@ bool hash_table_insert(HashTable *table, int64 key) {
 			return xuckoo_hash_table_insert(table->table, key);
 		case XUCKOON:
 			return xuckoon_hash_table_insert(table->table, key);
+		case SWISS:
+			return swiss_hash_table_insert(table->table, key);
+		case BCUCKOO:
+			return bcuckoo_hash_table_insert(table->table, key);
+		case CCUCKOO:
+			return ccuckoo_hash_table_insert(table->table, key);
+		case CLINEAR:
+			return clinear_hash_table_insert(table->table, key);
+		case CXTNDBLN:
+			return cxtndbln_hash_table_insert(table->table, key);
 		default:
 			return false;
 	}
 }
 
+// insert each of the 'n' keys in 'keys' into 'table', if it's not in there
+// already, storing whether each one was inserted in 'inserted'
+// returns how many of the keys were inserted
+static int insert_batch(HashTable *table, int64 *keys, int n,
+	bool *inserted) {
+	// forward the call onto the relevant batched insert function, for the
+	// table types which have one
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_insert_batch(table->table, keys, n,
+				inserted);
+		case CUCKOO:
+			return cuckoo_hash_table_insert_batch(table->table, keys, n,
+				inserted);
+		case XTNDBLN:
+			return xtndbln_hash_table_insert_batch(table->table, keys, n,
+				inserted);
+		default:
+			break;
+	}
+
+	// otherwise, insert the keys one at a time
+	int count = 0;
+	int i;
+	for (i = 0; i < n; i++) {
+		inserted[i] = insert_key(table, keys[i]);
+		count += inserted[i];
+	}
+	return count;
+}
+
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
-bool hash_table_lookup(HashTable *table, int64 key) {
-	assert(table != NULL);
-
+static bool lookup_key(HashTable *table, int64 key) {
 	// forward the call onto the relevant lookup function
 	switch (table->type) {
 		case LINEAR:
@@ -169,15 +314,419 @@ bool hash_table_lookup(HashTable *table, int64 key) {
 			return xuckoo_hash_table_lookup(table->table, key);
 		case XUCKOON:
 			return xuckoon_hash_table_lookup(table->table, key);
+		case SWISS:
+			return swiss_hash_table_lookup(table->table, key);
+		case BCUCKOO:
+			return bcuckoo_hash_table_lookup(table->table, key);
+		case CCUCKOO:
+			return ccuckoo_hash_table_lookup(table->table, key);
+		case CLINEAR:
+			return clinear_hash_table_lookup(table->table, key);
+		case CXTNDBLN:
+			return cxtndbln_hash_table_lookup(table->table, key);
 		default:
 			return false;
 	}
 }
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+static int lookup_batch(HashTable *table, int64 *keys, int n,
+	bool *results) {
+	// forward the call onto the relevant batched lookup function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		case XTNDBL1:
+			return xtndbl1_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		case CUCKOO:
+			return cuckoo_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		case XTNDBLN:
+			return xtndbln_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		case XUCKOO:
+			return xuckoo_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		case XUCKOON:
+			return xuckoon_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		case SWISS:
+			return swiss_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		case BCUCKOO:
+			return bcuckoo_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		case CCUCKOO:
+			return ccuckoo_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		case CLINEAR:
+			return clinear_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		case CXTNDBLN:
+			return cxtndbln_hash_table_lookup_batch(table->table, keys, n,
+				results);
+		default:
+			return 0;
+	}
+}
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+static bool put_key(HashTable *table, int64 key, int64 value) {
+	// forward the call onto the relevant put function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_put(table->table, key, value);
+		case XTNDBL1:
+			return xtndbl1_hash_table_put(table->table, key, value);
+		case CUCKOO:
+			return cuckoo_hash_table_put(table->table, key, value);
+		case XTNDBLN:
+			return xtndbln_hash_table_put(table->table, key, value);
+		case XUCKOO:
+			return xuckoo_hash_table_put(table->table, key, value);
+		case XUCKOON:
+			return xuckoon_hash_table_put(table->table, key, value);
+		case SWISS:
+			return swiss_hash_table_put(table->table, key, value);
+		case BCUCKOO:
+			return bcuckoo_hash_table_put(table->table, key, value);
+		case CCUCKOO:
+			return ccuckoo_hash_table_put(table->table, key, value);
+		case CLINEAR:
+			return clinear_hash_table_put(table->table, key, value);
+		case CXTNDBLN:
+			return cxtndbln_hash_table_put(table->table, key, value);
+		default:
+			return false;
+	}
+}
+
+// lookup the value 'key' maps to in 'table', storing it in '*value'
+// returns true if found, false if not
+static bool get_key(HashTable *table, int64 key, int64 *value) {
+	// forward the call onto the relevant get function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_get(table->table, key, value);
+		case XTNDBL1:
+			return xtndbl1_hash_table_get(table->table, key, value);
+		case CUCKOO:
+			return cuckoo_hash_table_get(table->table, key, value);
+		case XTNDBLN:
+			return xtndbln_hash_table_get(table->table, key, value);
+		case XUCKOO:
+			return xuckoo_hash_table_get(table->table, key, value);
+		case XUCKOON:
+			return xuckoon_hash_table_get(table->table, key, value);
+		case SWISS:
+			return swiss_hash_table_get(table->table, key, value);
+		case BCUCKOO:
+			return bcuckoo_hash_table_get(table->table, key, value);
+		case CCUCKOO:
+			return ccuckoo_hash_table_get(table->table, key, value);
+		case CLINEAR:
+			return clinear_hash_table_get(table->table, key, value);
+		case CXTNDBLN:
+			return cxtndbln_hash_table_get(table->table, key, value);
+		default:
+			return false;
+	}
+}
+
+// lookup the value 'key' maps to in 'table', inserting it with 'value' first
+// if it's not in there
+// returns true if 'key' was newly inserted, false if it was already in there
+static bool get_or_insert_key(HashTable *table, int64 key, int64 value,
+	int64 *result) {
+	// forward the call onto the relevant get or insert function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_get_or_insert(table->table, key, value,
+				result);
+		case XTNDBL1:
+			return xtndbl1_hash_table_get_or_insert(table->table, key, value,
+				result);
+		case CUCKOO:
+			return cuckoo_hash_table_get_or_insert(table->table, key, value,
+				result);
+		case XTNDBLN:
+			return xtndbln_hash_table_get_or_insert(table->table, key, value,
+				result);
+		case XUCKOO:
+			return xuckoo_hash_table_get_or_insert(table->table, key, value,
+				result);
+		case XUCKOON:
+			return xuckoon_hash_table_get_or_insert(table->table, key, value,
+				result);
+		case SWISS:
+			return swiss_hash_table_get_or_insert(table->table, key, value,
+				result);
+		case BCUCKOO:
+			return bcuckoo_hash_table_get_or_insert(table->table, key, value,
+				result);
+		case CCUCKOO:
+			return ccuckoo_hash_table_get_or_insert(table->table, key, value,
+				result);
+		case CLINEAR:
+			return clinear_hash_table_get_or_insert(table->table, key, value,
+				result);
+		case CXTNDBLN:
+			return cxtndbln_hash_table_get_or_insert(table->table, key, value,
+				result);
+		default:
+			return false;
+	}
+}
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+static bool delete_key(HashTable *table, int64 key) {
+	// forward the call onto the relevant delete function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_delete(table->table, key);
+		case XTNDBL1:
+			return xtndbl1_hash_table_delete(table->table, key);
+		case CUCKOO:
+			return cuckoo_hash_table_delete(table->table, key);
+		case XTNDBLN:
+			return xtndbln_hash_table_delete(table->table, key);
+		case XUCKOO:
+			return xuckoo_hash_table_delete(table->table, key);
+		case XUCKOON:
+			return xuckoon_hash_table_delete(table->table, key);
+		case SWISS:
+			return swiss_hash_table_delete(table->table, key);
+		case BCUCKOO:
+			return bcuckoo_hash_table_delete(table->table, key);
+		case CCUCKOO:
+			return ccuckoo_hash_table_delete(table->table, key);
+		case CLINEAR:
+			return clinear_hash_table_delete(table->table, key);
+		case CXTNDBLN:
+			return cxtndbln_hash_table_delete(table->table, key);
+		default:
+			return false;
+	}
+}
+
+/* * * *
+ * the operations themselves, through the table's lock: with concurrent reads
+ * turned on, lookups are repeated if they overlap a write, and writers take
+ * turns. with them off, the lock functions do nothing
+ */
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool hash_table_insert(HashTable *table, int64 key) {
+	assert(table != NULL);
+
+	write_begin(table->lock);
+	bool inserted = insert_key(table, key);
+	write_end(table->lock);
+	return inserted;
+}
+
+// insert each of the 'n' keys in 'keys' into 'table', if it's not in there
+// already, storing whether each one was inserted in 'inserted'
+// returns how many of the keys were inserted
+int hash_table_insert_batch(HashTable *table, int64 *keys, int n,
+	bool *inserted) {
+	assert(table != NULL);
+
+	write_begin(table->lock);
+	int count = insert_batch(table, keys, n, inserted);
+	write_end(table->lock);
+	return count;
+}
+
+// insert thread 'thread''s share of the keys a concurrent table is being
+// built from
+static void insert_slice(void *arg, int thread) {
+	Build *build = arg;
+	int first = (int)((int64)build->n * thread / build->nthreads);
+	int last = (int)((int64)build->n * (thread + 1) / build->nthreads);
+	int i;
+	for (i = first; i < last; i++) {
+		hash_table_insert(build->table, build->keys[i]);
+	}
+}
+
+// create a hash table of type 'type' with initial size 'size' holding the
+// 'n' keys in 'keys', using 'threads' threads to build it
+HashTable *hash_table_build_parallel(TableType type, int size, int64 *keys,
+	int n, int threads) {
+	assert(threads > 0);
+	HashTable *table;
+	Build build;
+
+	switch (type) {
+		// these are built a range of the table per thread
+		case LINEAR:
+			table = malloc(sizeof *table);
+			assert(table);
+			table->type = type;
+			table->lock = NULL;
+			table->table = linear_hash_table_build_parallel(size, keys, n,
+				threads);
+			break;
+		case XTNDBLN:
+			table = malloc(sizeof *table);
+			assert(table);
+			table->type = type;
+			table->lock = NULL;
+			table->table = xtndbln_hash_table_build_parallel(size, keys, n,
+				threads);
+			break;
+
+		// these can take inserts from every thread at once
+		case CCUCKOO:
+		case CLINEAR:
+		case CXTNDBLN:
+			table = new_hash_table(type, size);
+			build = (Build){ .table = table, .keys = keys, .n = n,
+				.nthreads = threads };
+			run_threads(threads, insert_slice, &build);
+			break;
+
+		// and the rest are built as one batch (growing at most once)
+		default:
+			table = new_hash_table(type, size);
+			if (table && n > 0) {
+				bool *inserted = malloc((sizeof *inserted) * n);
+				assert(inserted);
+				insert_batch(table, keys, n, inserted);
+				free(inserted);
+			}
+			break;
+	}
+
+	return table;
+}
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool hash_table_lookup(HashTable *table, int64 key) {
+	assert(table != NULL);
+
+	bool found;
+	unsigned start;
+	do {
+		start = read_begin(table->lock);
+		found = lookup_key(table, key);
+	} while (read_retry(table->lock, start));
+	return found;
+}
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int hash_table_lookup_batch(HashTable *table, int64 *keys, int n,
+	bool *results) {
+	assert(table != NULL);
+
+	int found = 0;
+	int i;
+	for (i = 0; i < n; i += READ_PIECE) {
+		int piece = n - i < READ_PIECE ? n - i : READ_PIECE;
+		int count;
+		unsigned start;
+		do {
+			start = read_begin(table->lock);
+			count = lookup_batch(table, keys + i, piece, results + i);
+		} while (read_retry(table->lock, start));
+		found += count;
+	}
+	return found;
+}
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool hash_table_put(HashTable *table, int64 key, int64 value) {
+	assert(table != NULL);
+
+	write_begin(table->lock);
+	bool inserted = put_key(table, key, value);
+	write_end(table->lock);
+	return inserted;
+}
+
+// lookup the value 'key' maps to in 'table', storing it in '*value'
+// returns true if found, false if not
+bool hash_table_get(HashTable *table, int64 key, int64 *value) {
+	assert(table != NULL);
+
+	// (read into a local, so '*value' never holds a value from a read that
+	// had to be repeated)
+	bool found;
+	int64 got = 0;
+	unsigned start;
+	do {
+		start = read_begin(table->lock);
+		found = get_key(table, key, &got);
+	} while (read_retry(table->lock, start));
+	if (found && value) {
+		*value = got;
+	}
+	return found;
+}
+
+// lookup the value 'key' maps to in 'table', inserting it with 'value' first
+// if it's not in there
+// returns true if 'key' was newly inserted, false if it was already in there
+bool hash_table_get_or_insert(HashTable *table, int64 key, int64 value,
+	int64 *result) {
+	assert(table != NULL);
+
+	write_begin(table->lock);
+	bool inserted = get_or_insert_key(table, key, value, result);
+	write_end(table->lock);
+	return inserted;
+}
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool hash_table_delete(HashTable *table, int64 key) {
+	assert(table != NULL);
+
+	write_begin(table->lock);
+	bool deleted = delete_key(table, key);
+	write_end(table->lock);
+	return deleted;
+}
+
+// let any number of threads look keys up in 'table' at once, without
+// locking, while one thread at a time changes it
+void hash_table_set_concurrent_reads(HashTable *table, bool concurrent) {
+	assert(table != NULL);
+
+	// (the concurrent tables need no lock, and taking one would only keep
+	// their writers from running at once)
+	if (table->type == CCUCKOO || table->type == CLINEAR
+			|| table->type == CXTNDBLN) {
+		return;
+	}
+
+	if (concurrent && !table->lock) {
+		table->lock = new_seqlock();
+	} else if (!concurrent && table->lock) {
+		free_seqlock(table->lock);
+		table->lock = NULL;
+	}
+}
+
 // print the contents of 'table' to stdout
 void hash_table_print(HashTable *table) {
 	assert(table != NULL);
 
+	// (as a writer, so that no other writer changes the table part way)
+	write_begin(table->lock);
+
 	// call the relevant print function
 	switch (table->type) {
 		case LINEAR:
@@ -198,15 +747,33 @@ void hash_table_print(HashTable *table) {
 		case XUCKOON:
 			xuckoon_hash_table_print(table->table);
 			break;
+		case SWISS:
+			swiss_hash_table_print(table->table);
+			break;
+		case BCUCKOO:
+			bcuckoo_hash_table_print(table->table);
+			break;
+		case CCUCKOO:
+			ccuckoo_hash_table_print(table->table);
+			break;
+		case CLINEAR:
+			clinear_hash_table_print(table->table);
+			break;
+		case CXTNDBLN:
+			cxtndbln_hash_table_print(table->table);
+			break;
 		default:
 			break;
 	}
+	write_end(table->lock);
 }
 
 // print some statistics about 'table' to stdout
 void hash_table_stats(HashTable *table) {
 	assert(table != NULL);
 
+	write_begin(table->lock);
+
 	// call the relevant print stats function
 	switch (table->type) {
 		case LINEAR:
@@ -227,7 +794,104 @@ void hash_table_stats(HashTable *table) {
 		case XUCKOON:
 			xuckoon_hash_table_stats(table->table);
 			break;
+		case SWISS:
+			swiss_hash_table_stats(table->table);
+			break;
+		case BCUCKOO:
+			bcuckoo_hash_table_stats(table->table);
+			break;
+		case CCUCKOO:
+			ccuckoo_hash_table_stats(table->table);
+			break;
+		case CLINEAR:
+			clinear_hash_table_stats(table->table);
+			break;
+		case CXTNDBLN:
+			cxtndbln_hash_table_stats(table->table);
+			break;
 		default:
 			break;
 	}
-}
\ No newline at end of file
+	write_end(table->lock);
+}
+
+// return how many keys 'table' has space for without growing
+int hash_table_capacity(HashTable *table) {
+	assert(table != NULL);
+
+	// forward the call onto the relevant capacity function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_capacity(table->table);
+		case XTNDBL1:
+			return xtndbl1_hash_table_capacity(table->table);
+		case CUCKOO:
+			return cuckoo_hash_table_capacity(table->table);
+		case XTNDBLN:
+			return xtndbln_hash_table_capacity(table->table);
+		case XUCKOO:
+			return xuckoo_hash_table_capacity(table->table);
+		case XUCKOON:
+			return xuckoon_hash_table_capacity(table->table);
+		case SWISS:
+			return swiss_hash_table_capacity(table->table);
+		case BCUCKOO:
+			return bcuckoo_hash_table_capacity(table->table);
+		case CCUCKOO:
+			return ccuckoo_hash_table_capacity(table->table);
+		case CLINEAR:
+			return clinear_hash_table_capacity(table->table);
+		case CXTNDBLN:
+			return cxtndbln_hash_table_capacity(table->table);
+		default:
+			return 0;
+	}
+}
+
+// set the load factor above which 'table' grows, if it supports this
+// returns true if 'table' supports this, false if not
+bool hash_table_set_max_load(HashTable *table, double max_load) {
+	assert(table != NULL);
+
+	// only some table types grow based on their load factor
+	switch (table->type) {
+		case LINEAR:
+			linear_hash_table_set_max_load(table->table, max_load);
+			return true;
+		case SWISS:
+			swiss_hash_table_set_max_load(table->table, max_load);
+			return true;
+		case BCUCKOO:
+			bcuckoo_hash_table_set_max_load(table->table, max_load);
+			return true;
+		case CLINEAR:
+			clinear_hash_table_set_max_load(table->table, max_load);
+			return true;
+		default:
+			return false;
+	}
+}
+
+// have lookups first try an array of shallow buckets, if 'table' supports
+// this
+// returns true if 'table' supports this, false if not
+bool hash_table_set_shallow_depth(HashTable *table, int depth) {
+	assert(table != NULL);
+
+	// only the plain extendible tables look keys up through one directory
+	bool supported = true;
+	write_begin(table->lock);
+	switch (table->type) {
+		case XTNDBL1:
+			xtndbl1_hash_table_set_shallow_depth(table->table, depth);
+			break;
+		case XTNDBLN:
+			xtndbln_hash_table_set_shallow_depth(table->table, depth);
+			break;
+		default:
+			supported = false;
+			break;
+	}
+	write_end(table->lock);
+	return supported;
+}
@@ -15,7 +15,8 @@
 // enumerated type containing constants for the various types of hash table
 // supported
 typedef enum type {
-	NOTYPE = -1, LINEAR, XTNDBL1, CUCKOO, XTNDBLN, XUCKOO, XUCKOON
+	NOTYPE = -1, LINEAR, XTNDBL1, CUCKOO, XTNDBLN, XUCKOO, XUCKOON, SWISS,
+	BCUCKOO, CCUCKOO, CLINEAR, CXTNDBLN
 } TableType;
 
 // converts from a string representation to a TableType constant:
@@ -25,8 +26,16 @@ typedef enum type {
 // "2" or "xtndbln"	->	XTNDBLN
 // "3" or "xuckoo"	->	XUCKOO
 // "4" or "xuckoon" ->  XUCKOON
+// "swiss"			->	SWISS
+// "bcuckoo"		->	BCUCKOO
+// "ccuckoo"		->	CCUCKOO
+// "clinear"		->	CLINEAR
+// "cxtndbln"		->	CXTNDBLN
 TableType strtotype(char *str);
 
+// converts from a TableType constant to its name (e.g. LINEAR -> "linear")
+char *typetostr(TableType type);
+
 typedef struct table HashTable;
 
 // initialise a hash table of type 'type' with initial size 'size',
@@ -40,14 +49,87 @@ void free_hash_table(HashTable *table);
 // returns true if insertion succeeds, false if it was already in there
 bool hash_table_insert(HashTable *table, int64 key);
 
+// insert each of the 'n' keys in 'keys' into 'table', if it's not in there
+// already, storing whether each one was inserted in 'inserted' (an array of
+// at least 'n' bools). for bulk loading: table types which support it grow
+// just once to fit the whole batch, and hash and prefetch keys in groups
+// returns how many of the keys were inserted
+int hash_table_insert_batch(HashTable *table, int64 *keys, int n,
+	bool *inserted);
+
+// create a hash table of type 'type' with initial size 'size' (as for
+// 'new_hash_table()') holding the 'n' keys in 'keys', using 'threads'
+// threads to build it. linear and xtndbln tables are built a range of the
+// table per thread, and the concurrent types take inserts from every thread
+// at once. other types are built on one thread, as one batch
+// returns its pointer, or NULL if there's no such table type
+HashTable *hash_table_build_parallel(TableType type, int size, int64 *keys,
+	int n, int threads);
+
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool hash_table_lookup(HashTable *table, int64 key);
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results' (an array of at least 'n' bools). faster than
+// calling 'hash_table_lookup()' once per key on large tables, because the
+// memory for a whole group of keys is requested before any of it is needed
+// returns how many of the keys were found
+int hash_table_lookup_batch(HashTable *table, int64 *keys, int n,
+	bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool hash_table_put(HashTable *table, int64 key, int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL). keys added with 'hash_table_insert()' map to 0
+// returns true if found, false if not
+bool hash_table_get(HashTable *table, int64 key, int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool hash_table_get_or_insert(HashTable *table, int64 key, int64 value,
+	int64 *result);
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool hash_table_delete(HashTable *table, int64 key);
+
 // print the contents of 'table' to stdout
 void hash_table_print(HashTable *table);
 
 // print some statistics about 'table' to stdout
 void hash_table_stats(HashTable *table);
 
+// return how many keys 'table' has space for without growing (so that the
+// load factor is the number of keys divided by this)
+int hash_table_capacity(HashTable *table);
+
+// turn concurrent reads of 'table' on or off (they're off to begin with).
+// while they're on, any number of threads may call 'hash_table_lookup()',
+// 'hash_table_lookup_batch()' and 'hash_table_get()' without any locking,
+// alongside one thread at a time calling the functions which change the
+// table (other writers wait their turn). a lookup that overlaps a write is
+// repeated, and readers wait only while the table is moving memory around
+// (e.g. as it grows). every call costs a few atomic operations. don't call
+// this while other threads are using 'table'
+// tables of type CCUCKOO, CLINEAR and CXTNDBLN don't need this: any number of
+// threads may call any of the functions above (besides 'new_hash_table()' and
+// 'free_hash_table()') on them at once, including several writers
+void hash_table_set_concurrent_reads(HashTable *table, bool concurrent);
+
+// set the load factor (between 0 and 1) above which 'table' grows, for table
+// types which grow based on load
+// returns true if 'table' supports this, false if not
+bool hash_table_set_max_load(HashTable *table, double max_load);
+
+// have lookups in 'table' first try an array, indexed by 'depth' hash value
+// bits, of the buckets using no more bits than that, skipping the directory
+// (0 to turn this off), for extendible table types
+// returns true if 'table' supports this, false if not
+bool hash_table_set_shallow_depth(HashTable *table, int depth);
+
 #endif
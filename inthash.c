@@ -5,6 +5,8 @@
  * by Matt Farrugia <matt.farrugia@unimelb.edu.au>
  */
 
+#include <string.h>
+
 #include "inthash.h"
 
 // constants for first hash function
@@ -17,6 +19,15 @@
 #define B2 306837493
 #define p2 2147483563
 
+// round 'n' up to the nearest power of two
+int next_power_of_two(int n) {
+	int power = 1;
+	while (power < n) {
+		power *= 2;
+	}
+	return power;
+}
+
 // first available hash function
 int h1(int64 k) {
 	return (A1 * k + B1) % p1;
@@ -26,3 +37,119 @@ int h1(int64 k) {
 int h2(int64 k) {
 	return (A2 * k + B2) % p2;
 }
+
+
+// constants for the 64-bit hash families: odd multipliers and seeds drawn
+// from the fractional parts of irrational numbers
+#define MULT1 0x9e3779b97f4a7c15ULL
+#define MULT2 0xc2b2ae3d27d4eb4fULL
+#define SEED1 0x243f6a8885a308d3ULL
+#define SEED2 0x13198a2e03707344ULL
+#define WYP0  0xa0761d6478bd642fULL
+#define WYP1  0xe7037ed1a0b428dbULL
+#define WYP2  0x8ebc6af09c88c6e3ULL
+#define WYP3  0x589965cc75374cc3ULL
+
+// the family used by h1_64() and h2_64()
+static HashFamily family = SPLITMIX;
+
+// multiply and xor-shift: one multiply, then fold the well-mixed high half
+// onto the poorly-mixed low half
+static int64 multshift(int64 k, int64 a) {
+	int64 x = k * a;
+	return x ^ (x >> 32);
+}
+
+// murmur3's 64-bit finaliser, applied to a seeded key (as in splitmix64)
+static int64 fmix64(int64 k, int64 seed) {
+	int64 x = k + seed;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+// wyhash's 'mum' mixing step: multiply two 64-bit numbers to 128 bits and
+// xor the halves together
+static int64 wymix(int64 a, int64 b) {
+	unsigned __int128 r = (unsigned __int128)a * b;
+	return (int64)r ^ (int64)(r >> 64);
+}
+
+// converts from a string representation to a HashFamily constant
+HashFamily strtofamily(char *str) {
+	if (strcmp("modprime", str) == 0) {
+		return MODPRIME;
+	}
+	if (strcmp("multshift", str) == 0) {
+		return MULTSHIFT;
+	}
+	if (strcmp("splitmix", str) == 0) {
+		return SPLITMIX;
+	}
+	if (strcmp("wyhash", str) == 0) {
+		return WYHASH;
+	}
+	return NOFAMILY;
+}
+
+// converts from a HashFamily constant to its name
+char *familytostr(HashFamily f) {
+	switch (f) {
+		case MODPRIME:
+			return "modprime";
+		case MULTSHIFT:
+			return "multshift";
+		case SPLITMIX:
+			return "splitmix";
+		case WYHASH:
+			return "wyhash";
+		default:
+			return "none";
+	}
+}
+
+// choose the family used by h1_64() and h2_64() from now on
+void set_hash_family(HashFamily f) {
+	family = f;
+}
+
+// the family currently in use
+HashFamily get_hash_family() {
+	return family;
+}
+
+// first available 64-bit hash function
+int64 h1_64(int64 k) {
+	switch (family) {
+		case MODPRIME:
+			return h1(k);
+		case MULTSHIFT:
+			return multshift(k, MULT1);
+		case WYHASH:
+			return wymix(k ^ WYP0, k ^ WYP1);
+		default:
+			return fmix64(k, SEED1);
+	}
+}
+
+// second available 64-bit hash function (independent of the first)
+int64 h2_64(int64 k) {
+	switch (family) {
+		case MODPRIME:
+			return h2(k);
+		case MULTSHIFT:
+			return multshift(k, MULT2);
+		case WYHASH:
+			return wymix(k ^ WYP2, k ^ WYP3);
+		default:
+			return fmix64(k, SEED2);
+	}
+}
+
+// map a 64-bit hash value onto an address in [0, size)
+int hash_to_range(int64 hash, int size) {
+	if (family == MODPRIME) {
+		return hash % size;
+	}
+	return ((unsigned __int128)hash * (int64)size) >> 64;
+}
@@ -16,9 +16,39 @@
 // would take up 2^27 * 8 bytes = 2^30 bytes = 1GB of memory
 #define MAX_TABLE_SIZE 134217728
 
+// how many keys the batched table operations hash at a time, prefetching the
+// memory they will probe, before going back to resolve each of them. enough
+// to keep several cache misses in flight at once
+#define BATCH_GROUP 16
+
+// hint to the processor that the memory at address 'p' will be read soon
+#if defined(__GNUC__)
+#define prefetch(p) __builtin_prefetch(p)
+#else
+#define prefetch(p) ((void)(p))
+#endif
+
+// CPU time spent inserting and deleting keys, for the statistics of the
+// tables which keep it. each timed operation makes two clock() calls (system
+// calls, costing far more than the operation itself on a cached table), so
+// the timing is compiled out unless built with -DTABLE_TIMING, leaving every
+// table type measured the same way by the benchmarks
+#ifdef TABLE_TIMING
+#include <time.h>
+#define timer_start() clock()
+#define timer_add(total, start) ((total) += clock() - (start))
+#else
+#define timer_start() 0
+#define timer_add(total, start) ((void)(start))
+#endif
+
 // alias for unsigned 64-bit integer type
 typedef uint64_t int64;
 
+// round 'n' up to the nearest power of two (for tables which index with a
+// mask rather than a modulo)
+int next_power_of_two(int n);
+
 
 // the following functions take a 64-bit integer key and return a 32-bit signed 
 // integer hash, calculated as ( A * key + B ) % p where p is a large prime.
@@ -36,4 +66,43 @@ int h1(int64 k);
 // second available hash function
 int h2(int64 k);
 
+
+// the following functions return a full 64-bit hash, computed by one of
+// several selectable families of hash function. tables can take the low bits
+// of these with a mask, or map them onto [0, size) with 'hash_to_range()',
+// instead of dividing. the MODPRIME family just returns h1() and h2() above,
+// so that table layouts from before these functions existed can be reproduced
+typedef enum hash_family {
+	NOFAMILY = -1,
+	MODPRIME,	// ( A * key + B ) % p, as h1() and h2()
+	MULTSHIFT,	// multiply by a large odd constant, then fold the high bits down
+	SPLITMIX,	// the splitmix64 / murmur3 fmix64 finaliser (the default)
+	WYHASH		// wyhash-style 64x64->128 bit multiply, folded to 64 bits
+} HashFamily;
+
+// converts from a string representation to a HashFamily constant:
+// "modprime", "multshift", "splitmix" or "wyhash"
+HashFamily strtofamily(char *str);
+
+// converts from a HashFamily constant to its name
+char *familytostr(HashFamily family);
+
+// choose the family used by h1_64() and h2_64() from now on. tables hash keys
+// whenever they are accessed, so change this before creating any tables
+void set_hash_family(HashFamily family);
+
+// the family currently in use
+HashFamily get_hash_family();
+
+// first available 64-bit hash function
+int64 h1_64(int64 k);
+
+// second available 64-bit hash function (independent of the first)
+int64 h2_64(int64 k);
+
+// map a 64-bit hash value onto an address in [0, size) using a multiply
+// instead of a division (Lemire's 'fastrange'). for the MODPRIME family,
+// whose hash values are only 31 bits, this falls back to hash % size
+int hash_to_range(int64 hash, int size);
+
 #endif
@@ -14,12 +14,17 @@
 
 #include "inthash.h"
 #include "hashtbl.h"
+#include "bench.h"
 
 // command line options
 #define DEFAULT_SIZE 4
 typedef struct options {
 	TableType type;
 	int initial_size;
+	char *benchfile;	// command file to benchmark, or NULL to interpret
+	HashFamily family;	// which hash functions the tables should use
+	double max_load;	// load factor to grow at, or 0 for the table default
+	int shallow;		// directory bits to try lookups with first, or 0
 } Options;
 Options get_options(int argc, char** argv);
 
@@ -28,38 +33,64 @@ Options get_options(int argc, char** argv);
 
 #define INSERT 'i'
 #define LOOKUP 'l'
+#define DELETE 'd'
+#define PUT    'u'
+#define GET    'g'
 #define PRINT  'p'
 #define STATS  's'
 #define HELP   'h'
 #define QUIT   'q'
 #define MAX_LINE_LEN 80
-int get_command(char *operation, int64 *key);
+int get_command(char *operation, int64 *key, int64 *value);
 
 
 // main program
 
 void run_interpreter(HashTable *table);
+int run_benchmark(HashTable *table, char *filename);
 
 int main(int argc, char **argv) {
 	
 	// get command line options (to determine table type, size, etc.)
 	Options options = get_options(argc, argv);
 
-	// create hashtable (of given type)
+	// linear tables index with a mask, so their size must be a power of two
+	if (options.type == LINEAR) {
+		options.initial_size = next_power_of_two(options.initial_size);
+	}
+
+	// create hashtable (of given type), hashing with the chosen functions
+	set_hash_family(options.family);
 	HashTable *table = new_hash_table(options.type, options.initial_size);
+	if (options.max_load > 0 && !hash_table_set_max_load(table,
+			options.max_load)) {
+		fprintf(stderr, "warning: -l has no effect on this table type\n");
+	}
+	if (options.shallow > 0 && !hash_table_set_shallow_depth(table,
+			options.shallow)) {
+		fprintf(stderr, "warning: -d has no effect on this table type\n");
+	}
 
-	// start the interpreter loop
-	run_interpreter(table);
+	// start the interpreter loop, or replay a command file silently
+	int status = EXIT_SUCCESS;
+	if (options.benchfile) {
+		status = run_benchmark(table, options.benchfile);
+	} else {
+		run_interpreter(table);
+	}
 
 	// done!
 	free_hash_table(table);
-	return 0;
+	return status;
 }
 
 // print out the valid operations
 void print_operations() {
 	printf(" %c number: insert 'number' into table\n",  INSERT);
 	printf(" %c number: lookup is 'number' in table\n", LOOKUP);
+	printf(" %c number: delete 'number' from table\n", DELETE);
+	printf(" %c number value: map 'number' to 'value' in table\n", PUT);
+	printf(" %c number: get the value 'number' maps to in table\n", GET);
 	printf(" %c: print table\n", PRINT);
 	printf(" %c: print stats\n", STATS);
 	printf(" %c: quit\n", QUIT);
@@ -72,13 +103,13 @@ void run_interpreter(HashTable *table) {
 	printf("enter a command (h for help):\n");
 	
 	char op;
-	int64 key;
+	int64 key, value;
 	
 	// then loop, getting and executing commands, until 'quit'
 	while (true) {
 
-		// read a command, storing results in op and key variables
-		int argc = get_command(&op, &key);
+		// read a command, storing results in op, key and value variables
+		int argc = get_command(&op, &key, &value);
 		if (argc < 1) {
 			continue; // no valid command entered, get another
 		}
@@ -115,6 +146,51 @@ void run_interpreter(HashTable *table) {
 				}
 				break;
 
+			case DELETE:
+				if (argc < 2) {
+					// delete commands must have an argument
+					printf("syntax: %c number\n", DELETE);
+
+				} else {
+					// perform the deletion
+					if (hash_table_delete(table, key)) {
+						printf("%llu deleted\n", key);
+					} else {
+						printf("%llu not in table\n", key);
+					}
+				}
+				break;
+
+			case PUT:
+				if (argc < 3) {
+					// put commands must have two arguments
+					printf("syntax: %c number value\n", PUT);
+
+				} else {
+					// perform the put
+					if (hash_table_put(table, key, value)) {
+						printf("%llu inserted -> %llu\n", key, value);
+					} else {
+						printf("%llu updated -> %llu\n", key, value);
+					}
+				}
+				break;
+
+			case GET:
+				if (argc < 2) {
+					// get commands must have an argument
+					printf("syntax: %c number\n", GET);
+
+				} else {
+					// perform the get
+					if (hash_table_get(table, key, &value)) {
+						printf("%llu -> %llu\n", key, value);
+					} else {
+						printf("%llu not found\n", key);
+					}
+				}
+				break;
+
 			case PRINT:
 				// perform the print table
 				hash_table_print(table);
@@ -143,20 +219,41 @@ void run_interpreter(HashTable *table) {
 	}
 }
 
+// load all commands from 'filename' up front, then run them against 'table'
+// without printing per-command results, and report timings instead
+int run_benchmark(HashTable *table, char *filename) {
+	Workload workload;
+	if (!load_workload(&workload, filename)) {
+		return EXIT_FAILURE;
+	}
+
+	BenchResult result = run_workload(table, &workload);
+	print_bench_result(&result);
+
+	free_workload(&workload);
+	return EXIT_SUCCESS;
+}
+
 // reads a line from stdin, parses it into an operation character and possibly
-// a long long uinteger argument. store results in *operation and *key, resp.
+// one or two long long uinteger arguments. store results in *operation, *key
+// and *value, resp.
 //
 // returns the number of tokens successfully read (e.g. 0 for none,
-// 1 for operation only, 2 for both operation and integer)
-int get_command(char *operation, int64 *key) {
+// 1 for operation only, 2 for operation and integer, 3 for operation and both
+// integers)
+int get_command(char *operation, int64 *key, int64 *value) {
 	
 	// read a line from stdin, up to MAX_LINE_LENGTH, into character buffer
 	char line[MAX_LINE_LEN];
-	fgets(line, MAX_LINE_LEN, stdin);
-	line[strlen(line)-1] = '\0'; // strip trailing newline
+	if (fgets(line, MAX_LINE_LEN, stdin) == NULL) {
+		// end of input (e.g. a piped command file without a 'q'): quit
+		*operation = QUIT;
+		return 1;
+	}
+	line[strcspn(line, "\n")] = '\0'; // strip trailing newline
 
-	// attempt to parse the line string into *operation and *key
-	int argc = sscanf(line, "%c %llu", operation, key);
+	// attempt to parse the line string into *operation, *key and *value
+	int argc = sscanf(line, "%c %llu %llu", operation, key, value);
 	// note: since llu is unsigned, a command like 'i -1' will overflow,
 	// resulting in *key = 18446744073709551615 (2^64-1). this is a feature.
 	
@@ -172,11 +269,13 @@ int get_command(char *operation, int64 *key) {
 Options get_options(int argc, char** argv) {
 	
 	// create the Options structure with defaults
-	Options options = { .type = NOTYPE, .initial_size = DEFAULT_SIZE };
+	Options options = { .type = NOTYPE, .initial_size = DEFAULT_SIZE,
+		.benchfile = NULL, .family = get_hash_family(),
+		.max_load = 0, .shallow = 0 };
 
 	// use C's built-in getopt function to scan inputs by flag
 	char option;
-	while ((option = getopt(argc, argv, "t:s:")) != EOF){
+	while ((option = getopt(argc, argv, "t:s:b:H:l:d:")) != EOF){
 		switch (option){
 			case 't': // set hash table type
 				options.type = strtotype(optarg);
@@ -184,6 +283,18 @@ Options get_options(int argc, char** argv) {
 			case 's': // set hash table size
 				options.initial_size = atoi(optarg);
 				break;
+			case 'b': // benchmark a command file ("-" for stdin)
+				options.benchfile = optarg;
+				break;
+			case 'H': // set hash function family
+				options.family = strtofamily(optarg);
+				break;
+			case 'l': // set maximum load factor
+				options.max_load = atof(optarg);
+				break;
+			case 'd': // set shallow directory depth for lookups
+				options.shallow = atoi(optarg);
+				break;
 			default:
 				break;
 		}
@@ -203,6 +314,11 @@ Options get_options(int argc, char** argv) {
 			" -t 2 or xtnbdln: n-key extendible hash table (part 2)\n");
 		fprintf(stderr, " -t 3 or xuckoo:  extendible cuckoo table (part 3)\n");
 		fprintf(stderr, " -t 4 or xuckoon: multi-key extendible cuckoo table (bonus part)\n");
+		fprintf(stderr, " -t swiss:   16-slot group probing with tag bytes\n");
+		fprintf(stderr, " -t bcuckoo: cuckoo hashing with 4-slot buckets\n");
+		fprintf(stderr, " -t ccuckoo: 4-slot bucket cuckoo hashing with locks, for threads\n");
+		fprintf(stderr, " -t clinear: lock-free linear probing, for threads\n");
+		fprintf(stderr, " -t cxtndbln: n-key extendible hashing with bucket locks, for threads\n");
 		valid = false;
 	}
 
@@ -213,6 +329,30 @@ Options get_options(int argc, char** argv) {
 		valid = false;
 	}
 
+	// validate maximum load factor (0 means not given)
+	if (options.max_load < 0 || options.max_load > 1) {
+		fprintf(stderr, "please specify a maximum load factor between 0 and 1 "
+			"using the -l flag\n");
+		valid = false;
+	}
+
+	// validate shallow directory depth (0 means not given)
+	if (options.shallow < 0 || options.shallow > 30) {
+		fprintf(stderr, "please specify a shallow directory depth between 0 "
+			"and 30 using the -d flag\n");
+		valid = false;
+	}
+
+	// validate hash function family
+	if (options.family == NOFAMILY) {
+		fprintf(stderr, "please specify a hash function family with -H:\n");
+		fprintf(stderr, " -H modprime:  (A * key + B) %% p, the original h1/h2\n");
+		fprintf(stderr, " -H multshift: multiply and xor-shift\n");
+		fprintf(stderr, " -H splitmix:  splitmix64 finaliser (default)\n");
+		fprintf(stderr, " -H wyhash:    wyhash-style 128-bit multiply\n");
+		valid = false;
+	}
+
 	// check overall validity before continuing
 	if(!valid){
 		exit(EXIT_FAILURE);
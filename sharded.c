@@ -0,0 +1,387 @@
+/* * * * * * * * *
+ * Sharded hash table: splits keys between several independent tables of any
+ * one type, each guarded by a lock of its own, so that many threads can use
+ * table types which aren't safe to share, without all of them waiting on
+ * one lock
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#define _POSIX_C_SOURCE 200112L // for posix_memalign
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "sharded.h"
+#include "tables/spinlock.h"
+
+#define CACHE_LINE 64
+
+// keys are routed to shards by the top bits of the key mixed with a seed of
+// its own (the next digits of pi after those inthash.c seeds its hash
+// functions with). routing by a mix no hash family shares keeps the keys of
+// one shard spread over every bit of the tables' hash values: routing by
+// the key times the golden ratio, as 'multshift' hashes, would give every
+// key in a shard the same top bits of h1_64()
+#define ROUTE_SEED 0xa4093822299f31d0ULL
+
+// one table, along with its lock, padded to a cache line so that threads
+// locking neighbouring shards don't fight over one line
+typedef struct shard {
+	HashTable *table;
+	SpinLock lock;		// held by any thread using the table
+	char padding[CACHE_LINE - sizeof (HashTable *) - sizeof (SpinLock)];
+} Shard;
+
+struct sharded_table {
+	Shard *shards;		// the tables (cache line aligned)
+	int nshards;		// how many (2^bits)
+	int bits;			// how many top bits of the mixed key pick the shard
+	TableType type;		// the type of every shard
+};
+
+// a batch of keys rearranged so that each shard's keys are next to each other
+typedef struct groups {
+	int64 *keys;		// the keys, grouped by shard
+	int *index;			// where each grouped key was in the original batch
+	bool *results;		// the result for each grouped key
+	int *start;			// where each shard's group begins ('nshards' + 1
+						// entries, the last being the batch size)
+} Groups;
+
+
+/* * * *
+ * helper functions
+ */
+
+// murmur3's 64-bit finaliser, applied to a seeded key (as in splitmix64)
+// the code was sourced from "inthash.c"
+static int64 fmix64(int64 k, int64 seed) {
+	int64 x = k + seed;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+// which shard of 'table' 'key' belongs in
+static int shard_of(ShardedHashTable *table, int64 key) {
+	if (table->bits == 0) {
+		return 0;
+	}
+	return fmix64(key, ROUTE_SEED) >> (64 - table->bits);
+}
+
+// group the 'n' keys in 'keys' by the shard of 'table' each belongs in,
+// keeping their order within each group
+static Groups group_keys(ShardedHashTable *table, int64 *keys, int n) {
+	Groups groups;
+	groups.keys = malloc((sizeof *groups.keys) * n);
+	assert(groups.keys);
+	groups.index = malloc((sizeof *groups.index) * n);
+	assert(groups.index);
+	groups.results = malloc((sizeof *groups.results) * n);
+	assert(groups.results);
+	groups.start = calloc(table->nshards + 1, sizeof *groups.start);
+	assert(groups.start);
+
+	// count each shard's keys, and from that where each group starts
+	int *shard = malloc((sizeof *shard) * n);
+	assert(shard);
+	int i, s;
+	for (i = 0; i < n; i++) {
+		shard[i] = shard_of(table, keys[i]);
+		groups.start[shard[i] + 1]++;
+	}
+	for (s = 0; s < table->nshards; s++) {
+		groups.start[s + 1] += groups.start[s];
+	}
+
+	// then deal the keys out (using each group's start as its next free
+	// place, and putting the starts back afterwards)
+	for (i = 0; i < n; i++) {
+		int place = groups.start[shard[i]]++;
+		groups.keys[place] = keys[i];
+		groups.index[place] = i;
+	}
+	for (s = table->nshards; s > 0; s--) {
+		groups.start[s] = groups.start[s - 1];
+	}
+	groups.start[0] = 0;
+
+	free(shard);
+	return groups;
+}
+
+// copy each grouped key's result back to its place in the original batch,
+// and free 'groups'
+static void ungroup_results(Groups *groups, int n, bool *results) {
+	int i;
+	for (i = 0; i < n; i++) {
+		results[groups->index[i]] = groups->results[i];
+	}
+	free(groups->keys);
+	free(groups->index);
+	free(groups->results);
+	free(groups->start);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a sharded table of 'nshards' tables (a power of two), each of
+// type 'type' and initial size 'size'
+ShardedHashTable *new_sharded_hash_table(TableType type, int size,
+	int nshards) {
+	assert(nshards > 0 && (nshards & (nshards - 1)) == 0);
+
+	ShardedHashTable *table = malloc(sizeof *table);
+	assert(table);
+	table->nshards = nshards;
+	table->bits = 0;
+	while ((1 << table->bits) < nshards) {
+		table->bits++;
+	}
+	table->type = type;
+
+	void *memory;
+	int error = posix_memalign(&memory, CACHE_LINE,
+		(sizeof (Shard)) * nshards);
+	assert(error == 0);
+	(void)error;
+	table->shards = memory;
+
+	int s;
+	for (s = 0; s < nshards; s++) {
+		spin_init(&table->shards[s].lock);
+		table->shards[s].table = new_hash_table(type, size);
+		assert(table->shards[s].table);
+	}
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_sharded_hash_table(ShardedHashTable *table) {
+	assert(table);
+
+	int s;
+	for (s = 0; s < table->nshards; s++) {
+		free_hash_table(table->shards[s].table);
+	}
+	free(table->shards);
+	free(table);
+}
+
+
+// return how many tables 'table' is split into
+int sharded_hash_table_nshards(ShardedHashTable *table) {
+	assert(table);
+	return table->nshards;
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool sharded_hash_table_insert(ShardedHashTable *table, int64 key) {
+	assert(table);
+
+	Shard *shard = &table->shards[shard_of(table, key)];
+	spin_lock(&shard->lock);
+	bool inserted = hash_table_insert(shard->table, key);
+	spin_unlock(&shard->lock);
+	return inserted;
+}
+
+
+// insert each of the 'n' keys in 'keys' into 'table', if it's not in there
+// already, storing whether each one was inserted in 'inserted'
+// returns how many of the keys were inserted
+int sharded_hash_table_insert_batch(ShardedHashTable *table, int64 *keys,
+	int n, bool *inserted) {
+	assert(table);
+	if (n == 0) {
+		return 0;
+	}
+
+	Groups groups = group_keys(table, keys, n);
+	int count = 0;
+	int s;
+	for (s = 0; s < table->nshards; s++) {
+		int start = groups.start[s];
+		Shard *shard = &table->shards[s];
+		spin_lock(&shard->lock);
+		count += hash_table_insert_batch(shard->table, groups.keys + start,
+			groups.start[s + 1] - start, groups.results + start);
+		spin_unlock(&shard->lock);
+	}
+	ungroup_results(&groups, n, inserted);
+	return count;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool sharded_hash_table_lookup(ShardedHashTable *table, int64 key) {
+	assert(table);
+
+	Shard *shard = &table->shards[shard_of(table, key)];
+	spin_lock(&shard->lock);
+	bool found = hash_table_lookup(shard->table, key);
+	spin_unlock(&shard->lock);
+	return found;
+}
+
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int sharded_hash_table_lookup_batch(ShardedHashTable *table, int64 *keys,
+	int n, bool *results) {
+	assert(table);
+	if (n == 0) {
+		return 0;
+	}
+
+	Groups groups = group_keys(table, keys, n);
+	int found = 0;
+	int s;
+	for (s = 0; s < table->nshards; s++) {
+		int start = groups.start[s];
+		Shard *shard = &table->shards[s];
+		spin_lock(&shard->lock);
+		found += hash_table_lookup_batch(shard->table, groups.keys + start,
+			groups.start[s + 1] - start, groups.results + start);
+		spin_unlock(&shard->lock);
+	}
+	ungroup_results(&groups, n, results);
+	return found;
+}
+
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool sharded_hash_table_put(ShardedHashTable *table, int64 key, int64 value) {
+	assert(table);
+
+	Shard *shard = &table->shards[shard_of(table, key)];
+	spin_lock(&shard->lock);
+	bool inserted = hash_table_put(shard->table, key, value);
+	spin_unlock(&shard->lock);
+	return inserted;
+}
+
+
+// lookup the value 'key' maps to in 'table', storing it in '*value'
+// returns true if found, false if not
+bool sharded_hash_table_get(ShardedHashTable *table, int64 key,
+	int64 *value) {
+	assert(table);
+
+	Shard *shard = &table->shards[shard_of(table, key)];
+	spin_lock(&shard->lock);
+	bool found = hash_table_get(shard->table, key, value);
+	spin_unlock(&shard->lock);
+	return found;
+}
+
+
+// lookup the value 'key' maps to in 'table', inserting it with 'value' first
+// if it's not in there
+// returns true if 'key' was newly inserted, false if it was already in there
+bool sharded_hash_table_get_or_insert(ShardedHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table);
+
+	Shard *shard = &table->shards[shard_of(table, key)];
+	spin_lock(&shard->lock);
+	bool inserted = hash_table_get_or_insert(shard->table, key, value, result);
+	spin_unlock(&shard->lock);
+	return inserted;
+}
+
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool sharded_hash_table_delete(ShardedHashTable *table, int64 key) {
+	assert(table);
+
+	Shard *shard = &table->shards[shard_of(table, key)];
+	spin_lock(&shard->lock);
+	bool deleted = hash_table_delete(shard->table, key);
+	spin_unlock(&shard->lock);
+	return deleted;
+}
+
+
+// print some statistics about each shard to stdout
+void sharded_hash_table_stats(ShardedHashTable *table) {
+	assert(table);
+
+	printf("--- %d shards of type %s ---\n", table->nshards,
+		typetostr(table->type));
+	int s;
+	for (s = 0; s < table->nshards; s++) {
+		Shard *shard = &table->shards[s];
+		printf("shard %d:\n", s);
+		spin_lock(&shard->lock);
+		hash_table_stats(shard->table);
+		spin_unlock(&shard->lock);
+	}
+}
+
+
+// return how many keys 'table' has space for without growing
+int sharded_hash_table_capacity(ShardedHashTable *table) {
+	assert(table);
+
+	int capacity = 0;
+	int s;
+	for (s = 0; s < table->nshards; s++) {
+		Shard *shard = &table->shards[s];
+		spin_lock(&shard->lock);
+		capacity += hash_table_capacity(shard->table);
+		spin_unlock(&shard->lock);
+	}
+	return capacity;
+}
+
+
+// set the load factor above which each shard grows
+// returns true if the shards' type supports this, false if not
+bool sharded_hash_table_set_max_load(ShardedHashTable *table,
+	double max_load) {
+	assert(table);
+
+	bool supported = true;
+	int s;
+	for (s = 0; s < table->nshards; s++) {
+		Shard *shard = &table->shards[s];
+		spin_lock(&shard->lock);
+		supported = hash_table_set_max_load(shard->table, max_load);
+		spin_unlock(&shard->lock);
+	}
+	return supported;
+}
+
+
+// have each shard first try an array of shallow buckets
+// returns true if the shards' type supports this, false if not
+bool sharded_hash_table_set_shallow_depth(ShardedHashTable *table,
+	int depth) {
+	assert(table);
+
+	bool supported = true;
+	int s;
+	for (s = 0; s < table->nshards; s++) {
+		Shard *shard = &table->shards[s];
+		spin_lock(&shard->lock);
+		supported = hash_table_set_shallow_depth(shard->table, depth);
+		spin_unlock(&shard->lock);
+	}
+	return supported;
+}
@@ -0,0 +1,77 @@
+/* * * * * * * * *
+ * Sharded hash table: splits keys between several independent tables of any
+ * one type, each guarded by a lock of its own, so that many threads can use
+ * table types which aren't safe to share, without all of them waiting on
+ * one lock
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef SHARDED_H
+#define SHARDED_H
+
+#include <stdbool.h>
+#include "inthash.h"
+#include "hashtbl.h"
+
+typedef struct sharded_table ShardedHashTable;
+
+// initialise a sharded table of 'nshards' tables (a power of two), each of
+// type 'type' and initial size 'size' (as for 'new_hash_table()')
+ShardedHashTable *new_sharded_hash_table(TableType type, int size,
+	int nshards);
+
+// free all memory associated with 'table' (once no other thread is using it)
+void free_sharded_hash_table(ShardedHashTable *table);
+
+// return how many tables 'table' is split into
+int sharded_hash_table_nshards(ShardedHashTable *table);
+
+// each of the functions below does the same as the 'hash_table_' function of
+// the same name, locking the shard (or, for batches, each shard in turn) that
+// the keys belong to. any number of threads may call them at once
+
+bool sharded_hash_table_insert(ShardedHashTable *table, int64 key);
+
+// the keys are first grouped by shard, so that each shard is locked once
+// and gets one batch
+int sharded_hash_table_insert_batch(ShardedHashTable *table, int64 *keys,
+	int n, bool *inserted);
+
+bool sharded_hash_table_lookup(ShardedHashTable *table, int64 key);
+
+// the keys are first grouped by shard, as for insert_batch above
+int sharded_hash_table_lookup_batch(ShardedHashTable *table, int64 *keys,
+	int n, bool *results);
+
+bool sharded_hash_table_put(ShardedHashTable *table, int64 key, int64 value);
+
+bool sharded_hash_table_get(ShardedHashTable *table, int64 key,
+	int64 *value);
+
+bool sharded_hash_table_get_or_insert(ShardedHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+bool sharded_hash_table_delete(ShardedHashTable *table, int64 key);
+
+// print some statistics about each shard to stdout
+void sharded_hash_table_stats(ShardedHashTable *table);
+
+// return how many keys 'table' has space for without growing (across all of
+// its shards)
+int sharded_hash_table_capacity(ShardedHashTable *table);
+
+// set the load factor above which each shard grows, if the shards' type
+// supports this
+// returns true if it does, false if not
+bool sharded_hash_table_set_max_load(ShardedHashTable *table,
+	double max_load);
+
+// have each shard first try an array of shallow buckets, if the shards' type
+// supports this
+// returns true if it does, false if not
+bool sharded_hash_table_set_shallow_depth(ShardedHashTable *table,
+	int depth);
+
+#endif
@@ -0,0 +1,554 @@
+/* * * * * * * * *
+ * Dynamic hash table using bucketized cuckoo hashing: each key can live in
+ * any of the slots of two buckets (chosen by two hash functions), and each
+ * bucket fills exactly one cache line
+ *
+ * a lookup reads at most two cache lines, comparing the key against all of a
+ * bucket's keys with a single vector compare. having several slots to choose
+ * from in each bucket lets the table fill to 90-95% before insertions start
+ * failing, compared to around 50% for one key per slot
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#define _POSIX_C_SOURCE 200112L // for posix_memalign
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "bcuckoo.h"
+#include "seqlock.h"
+
+// how many slots in a bucket. 4 keys and their 4 values fill a 64-byte line
+#define BUCKET_SLOTS 4
+#define CACHE_LINE 64
+
+// a free slot holds this key. since it can't mark a slot holding itself, the
+// key EMPTY is kept in a slot of its own, outside of the buckets
+#define EMPTY 0
+
+// grow the table once more than this fraction of its slots would be in use
+#define DEFAULT_MAX_LOAD 0.95
+
+// the most buckets an insertion may look at while searching for a path of
+// moves to make room for its key (enough for any path of up to 3 moves). if
+// it finds none, the table grows instead
+#define MAX_SEARCH 512
+
+// a bucket keeps its keys together so that they can be compared in one go,
+// followed by their values in the same order
+typedef struct bucket {
+	int64 keys[BUCKET_SLOTS];
+	int64 values[BUCKET_SLOTS];
+} Bucket;
+
+// a key and its value, as held outside of the buckets
+typedef struct slot {
+	int64 key;
+	int64 value;
+} Slot;
+
+// a step on a path of moves: a bucket, and the step before it, one of whose
+// keys would move into this bucket to make room
+typedef struct step {
+	int bucket;	// the bucket this step reaches
+	int slot;	// the slot in the previous step's bucket of the key to move
+	int parent;	// index of the step before this one, or -1 for the first
+} Step;
+
+// a bucketized cuckoo hash table is a single array of buckets (each key's two
+// buckets come from the same array), along with some usage statistics
+struct bcuckoo_table {
+	Bucket *buckets;	// array of buckets
+	int nbuckets;		// how many buckets (a power of two)
+	int load;			// number of keys in the buckets right now
+	double max_load;	// grow when load would exceed this fraction of slots
+	bool has_zero;		// is the key EMPTY in the table?
+	Slot zero;			// the slot holding the key EMPTY, if it's in the table
+	int moves;			// total keys moved to make room for other keys
+	int failed;			// insertions that found no path and grew the table
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// find the slots of 'bucket' holding 'key', as a mask with bit i for slot i
+static int match_key(Bucket *bucket, int64 key) {
+	int mask = 0;
+	int i;
+#if defined(__AVX2__)
+	// 4 keys per compare
+	__m256i k = _mm256_set1_epi64x(key);
+	for (i = 0; i < BUCKET_SLOTS; i += 4) {
+		__m256i keys = _mm256_loadu_si256((__m256i *)&bucket->keys[i]);
+		__m256i eq = _mm256_cmpeq_epi64(keys, k);
+		mask |= _mm256_movemask_pd(_mm256_castsi256_pd(eq)) << i;
+	}
+#elif defined(__SSE2__)
+	// 2 keys per compare. SSE2 can only compare 32-bit lanes, so a key matches
+	// where both of its halves do
+	__m128i k = _mm_set1_epi64x(key);
+	for (i = 0; i < BUCKET_SLOTS; i += 2) {
+		__m128i keys = _mm_loadu_si128((__m128i *)&bucket->keys[i]);
+		__m128i eq = _mm_cmpeq_epi32(keys, k);
+		eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+		mask |= _mm_movemask_pd(_mm_castsi128_pd(eq)) << i;
+	}
+#else
+	for (i = 0; i < BUCKET_SLOTS; i++) {
+		if (bucket->keys[i] == key) {
+			mask |= 1 << i;
+		}
+	}
+#endif
+	return mask;
+}
+
+// the slot of 'bucket' holding 'key', or -1 if it's not in there
+static int find_in_bucket(Bucket *bucket, int64 key) {
+	int mask = match_key(bucket, key);
+	int i;
+	for (i = 0; i < BUCKET_SLOTS; i++) {
+		if (mask & (1 << i)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// the two buckets 'key' can live in
+#define bucket1(table, key) ((int)(h1_64(key) & ((table)->nbuckets - 1)))
+#define bucket2(table, key) ((int)(h2_64(key) & ((table)->nbuckets - 1)))
+
+// set up the internals of a table struct with 'nbuckets' empty buckets
+static void initialise_table(BCuckooHashTable *table, int nbuckets) {
+	assert(nbuckets * BUCKET_SLOTS < MAX_TABLE_SIZE
+		&& "error: table has grown too large!");
+
+	// align the buckets to cache lines, so that each one is a single line
+	void *buckets;
+	int error = posix_memalign(&buckets, CACHE_LINE,
+		(sizeof *table->buckets) * nbuckets);
+	assert(error == 0);
+	(void)error;
+	table->buckets = buckets;
+
+	// zeroed memory is an array of free slots
+	memset(table->buckets, 0, (sizeof *table->buckets) * nbuckets);
+
+	table->nbuckets = nbuckets;
+	table->load = 0;
+}
+
+// is 'bucket' already on the path leading to 'path[i]'?
+static bool on_path(Step *path, int i, int bucket) {
+	for (; i >= 0; i = path[i].parent) {
+		if (path[i].bucket == bucket) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// add a step reaching 'bucket' to the end of 'path' (at 'path[*nsteps]')
+// returns a free slot in 'bucket', or -1 if it's full
+static int add_step(BCuckooHashTable *table, Step *path, int *nsteps,
+	int bucket, int slot, int parent) {
+	path[*nsteps] = (Step){bucket, slot, parent};
+	(*nsteps)++;
+	return find_in_bucket(&table->buckets[bucket], EMPTY);
+}
+
+// search breadth-first for the shortest path of moves that frees a slot in
+// one of 'key's buckets, without moving any keys yet. each key in a full
+// bucket on the path could move to its other bucket
+// returns the index of the step in 'path' reaching a bucket with a free
+// slot (storing the slot in '*spare'), or -1 if none is found within
+// MAX_SEARCH buckets
+static int plan_path(BCuckooHashTable *table, int64 key, Step *path,
+	int *spare) {
+	int nsteps = 0;
+	int b1 = bucket1(table, key);
+	int b2 = bucket2(table, key);
+	if ((*spare = add_step(table, path, &nsteps, b1, -1, -1)) >= 0) {
+		return nsteps - 1;
+	}
+	if (b2 != b1) {
+		if ((*spare = add_step(table, path, &nsteps, b2, -1, -1)) >= 0) {
+			return nsteps - 1;
+		}
+	}
+
+	int i, s;
+	for (i = 0; i < nsteps; i++) {
+		Bucket *bucket = &table->buckets[path[i].bucket];
+		for (s = 0; s < BUCKET_SLOTS && nsteps < MAX_SEARCH; s++) {
+			// where could the key in this slot move to? (never back onto the
+			// path, which would move keys that have already moved)
+			int64 other = bucket->keys[s];
+			int next = bucket1(table, other);
+			if (next == path[i].bucket) {
+				next = bucket2(table, other);
+			}
+			if (on_path(path, i, next)) {
+				continue;
+			}
+			if ((*spare = add_step(table, path, &nsteps, next, s, i)) >= 0) {
+				return nsteps - 1;
+			}
+		}
+	}
+	return -1;
+}
+
+// make room by moving a key from each bucket on the path ending at
+// 'path[end]' into the next one (starting with the slot 'spare' at the end),
+// then put 'key' in the slot this frees at the start of the path
+static void follow_path(BCuckooHashTable *table, Step *path, int end,
+	int spare, int64 key, int64 value) {
+	int i = end;
+	int s = spare;
+	for (; path[i].parent >= 0; i = path[i].parent) {
+		Bucket *to = &table->buckets[path[i].bucket];
+		Bucket *from = &table->buckets[path[path[i].parent].bucket];
+		to->keys[s] = from->keys[path[i].slot];
+		to->values[s] = from->values[path[i].slot];
+		s = path[i].slot;
+		table->moves++;
+	}
+	table->buckets[path[i].bucket].keys[s] = key;
+	table->buckets[path[i].bucket].values[s] = value;
+}
+
+// put 'key' (which must not be in the buckets already) into one of its
+// buckets, moving other keys along to make room if necessary
+// returns true on success, false (having moved nothing) if there's no room
+static bool place_key(BCuckooHashTable *table, int64 key, int64 value) {
+	Step path[MAX_SEARCH];
+	int spare;
+	int end = plan_path(table, key, path, &spare);
+	if (end < 0) {
+		return false;
+	}
+	follow_path(table, path, end, spare, key, value);
+	table->load++;
+	return true;
+}
+
+// replace the buckets with 'nbuckets' new ones and re-insert all keys,
+// doubling the number again if some key doesn't fit
+static void resize_table(BCuckooHashTable *table, int nbuckets) {
+	// no reader may be using the old buckets by the time they're freed
+	write_barrier();
+
+	Bucket *oldbuckets = table->buckets;
+	int oldnbuckets = table->nbuckets;
+
+	bool placed = false;
+	while (!placed) {
+		initialise_table(table, nbuckets);
+		placed = true;
+
+		int i, j;
+		for (i = 0; i < oldnbuckets && placed; i++) {
+			for (j = 0; j < BUCKET_SLOTS && placed; j++) {
+				if (oldbuckets[i].keys[j] != EMPTY) {
+					placed = place_key(table, oldbuckets[i].keys[j],
+						oldbuckets[i].values[j]);
+				}
+			}
+		}
+
+		// (the old buckets are untouched, so we can just start again)
+		if (!placed) {
+			free(table->buckets);
+			nbuckets *= 2;
+		}
+	}
+
+	free(oldbuckets);
+}
+
+// find the slot holding 'key' in 'table', setting '*bucket' and '*s' to its
+// bucket and position within that bucket
+// returns true if found, false if not
+static bool find_key(BCuckooHashTable *table, int64 key, Bucket **bucket,
+	int *s) {
+	*bucket = &table->buckets[bucket1(table, key)];
+	*s = find_in_bucket(*bucket, key);
+	if (*s < 0) {
+		*bucket = &table->buckets[bucket2(table, key)];
+		*s = find_in_bucket(*bucket, key);
+	}
+	return *s >= 0;
+}
+
+// the value stored for 'key' in 'table', or NULL if it's not in there
+static int64 *find_value(BCuckooHashTable *table, int64 key) {
+	// the key EMPTY has a slot of its own (and would match any free slot)
+	if (key == EMPTY) {
+		return table->has_zero ? &table->zero.value : NULL;
+	}
+
+	Bucket *bucket;
+	int s;
+	if (find_key(table, key, &bucket, &s)) {
+		return &bucket->values[s];
+	}
+	return NULL;
+}
+
+// insert 'key' (which must not be in 'table' already) with value 'value'
+static void insert_new(BCuckooHashTable *table, int64 key, int64 value) {
+	// the key EMPTY has a slot of its own
+	if (key == EMPTY) {
+		table->has_zero = true;
+		table->zero.key = EMPTY;
+		table->zero.value = value;
+		return;
+	}
+
+	// grow before the table gets too full for cuckoo eviction to cope
+	if (table->load + 1 > table->max_load * table->nbuckets * BUCKET_SLOTS) {
+		resize_table(table, table->nbuckets * 2);
+	}
+
+	// if there's no way to make room, grow the table and try again
+	while (!place_key(table, key, value)) {
+		table->failed++;
+		resize_table(table, table->nbuckets * 2);
+	}
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a bucketized cuckoo hash table with initial size 'size' slots
+BCuckooHashTable *new_bcuckoo_hash_table(int size) {
+	BCuckooHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	table->max_load = DEFAULT_MAX_LOAD;
+	table->has_zero = false;
+	table->moves = 0;
+	table->failed = 0;
+	initialise_table(table,
+		next_power_of_two((size + BUCKET_SLOTS - 1) / BUCKET_SLOTS));
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_bcuckoo_hash_table(BCuckooHashTable *table) {
+	assert(table != NULL);
+	free(table->buckets);
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool bcuckoo_hash_table_insert(BCuckooHashTable *table, int64 key) {
+	assert(table != NULL);
+
+	if (find_value(table, key)) {
+		return false;
+	}
+	insert_new(table, key, 0);
+	return true;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool bcuckoo_hash_table_lookup(BCuckooHashTable *table, int64 key) {
+	assert(table != NULL);
+	return find_value(table, key) != NULL;
+}
+
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int bcuckoo_hash_table_lookup_batch(BCuckooHashTable *table, int64 *keys,
+	int n, bool *results) {
+	assert(table != NULL);
+
+	int found = 0;
+	int i, j;
+	for (i = 0; i < n; i += BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// prefetch both buckets of every key in the group
+		for (j = 0; j < group; j++) {
+			prefetch(&table->buckets[bucket1(table, keys[i + j])]);
+			prefetch(&table->buckets[bucket2(table, keys[i + j])]);
+		}
+		for (j = 0; j < group; j++) {
+			results[i + j] = find_value(table, keys[i + j]) != NULL;
+			found += results[i + j];
+		}
+	}
+	return found;
+}
+
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool bcuckoo_hash_table_put(BCuckooHashTable *table, int64 key, int64 value) {
+	assert(table != NULL);
+
+	int64 *stored = find_value(table, key);
+	if (stored) {
+		*stored = value;
+		return false;
+	}
+	insert_new(table, key, value);
+	return true;
+}
+
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool bcuckoo_hash_table_get(BCuckooHashTable *table, int64 key, int64 *value) {
+	assert(table != NULL);
+
+	int64 *stored = find_value(table, key);
+	if (stored && value) {
+		*value = *stored;
+	}
+	return stored != NULL;
+}
+
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool bcuckoo_hash_table_get_or_insert(BCuckooHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table != NULL);
+
+	int64 *stored = find_value(table, key);
+	if (stored) {
+		value = *stored;
+	} else {
+		insert_new(table, key, value);
+	}
+	if (result) {
+		*result = value;
+	}
+	return stored == NULL;
+}
+
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool bcuckoo_hash_table_delete(BCuckooHashTable *table, int64 key) {
+	assert(table != NULL);
+
+	// the key EMPTY has a slot of its own
+	if (key == EMPTY) {
+		bool found = table->has_zero;
+		table->has_zero = false;
+		return found;
+	}
+
+	// no other key depends on this key's slot, so we can just free it
+	Bucket *bucket;
+	int s;
+	if (!find_key(table, key, &bucket, &s)) {
+		return false;
+	}
+	bucket->keys[s] = EMPTY;
+	table->load--;
+	return true;
+}
+
+
+// print the contents of 'table' to stdout
+void bcuckoo_hash_table_print(BCuckooHashTable *table) {
+	assert(table != NULL);
+
+	printf("--- table size: %d buckets of %d\n", table->nbuckets,
+		BUCKET_SLOTS);
+
+	// print header
+	printf("    bucket | keys\n");
+
+	// print each bucket's keys on a row
+	int i, j;
+	for (i = 0; i < table->nbuckets; i++) {
+		printf(" %9d |", i);
+		for (j = 0; j < BUCKET_SLOTS; j++) {
+			if (table->buckets[i].keys[j] != EMPTY) {
+				printf(" %llu", table->buckets[i].keys[j]);
+			} else {
+				printf(" -");
+			}
+		}
+		printf("\n");
+	}
+
+	// the key EMPTY lives outside of the buckets
+	if (table->has_zero) {
+		printf(" %9s | %llu\n", "-", table->zero.key);
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void bcuckoo_hash_table_stats(BCuckooHashTable *table) {
+	assert(table != NULL);
+	printf("--- table stats ---\n");
+
+	int size = table->nbuckets * BUCKET_SLOTS;
+	printf("current size: %d buckets of %d slots\n", table->nbuckets,
+		BUCKET_SLOTS);
+	printf("current load: %d items\n", table->load + table->has_zero);
+	printf(" load factor: %.3f%%\n", table->load * 100.0 / size);
+	printf("    max load: %.3f%%\n", table->max_load * 100.0);
+	printf("  keys moved: %d\n", table->moves);
+	printf("failed paths: %d\n", table->failed);
+#if defined(__AVX2__)
+	printf("bucket probe: avx2\n");
+#elif defined(__SSE2__)
+	printf("bucket probe: sse2\n");
+#else
+	printf("bucket probe: scalar\n");
+#endif
+	printf("--- end stats ---\n");
+}
+
+
+// return how many keys 'table' has space for without growing
+int bcuckoo_hash_table_capacity(BCuckooHashTable *table) {
+	assert(table != NULL);
+	return table->nbuckets * BUCKET_SLOTS;
+}
+
+
+// set the load factor (between 0 and 1) above which 'table' will grow
+void bcuckoo_hash_table_set_max_load(BCuckooHashTable *table,
+	double max_load) {
+	assert(table != NULL);
+	assert(max_load > 0 && max_load <= 1);
+	table->max_load = max_load;
+}
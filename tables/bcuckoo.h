@@ -0,0 +1,73 @@
+/* * * * * * * * *
+ * Dynamic hash table using bucketized cuckoo hashing: each key can live in
+ * any of the slots of two buckets (chosen by two hash functions), and each
+ * bucket fills exactly one cache line
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef BCUCKOO_H
+#define BCUCKOO_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+
+typedef struct bcuckoo_table BCuckooHashTable;
+
+// initialise a bucketized cuckoo hash table with initial size 'size' slots
+// (rounded up to a power of two number of buckets)
+BCuckooHashTable *new_bcuckoo_hash_table(int size);
+
+// free all memory associated with 'table'
+void free_bcuckoo_hash_table(BCuckooHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool bcuckoo_hash_table_insert(BCuckooHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool bcuckoo_hash_table_lookup(BCuckooHashTable *table, int64 key);
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'. keys are hashed in groups, and both of their
+// buckets are prefetched before any of them are probed
+// returns how many of the keys were found
+int bcuckoo_hash_table_lookup_batch(BCuckooHashTable *table, int64 *keys,
+	int n, bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool bcuckoo_hash_table_put(BCuckooHashTable *table, int64 key, int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool bcuckoo_hash_table_get(BCuckooHashTable *table, int64 key, int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool bcuckoo_hash_table_get_or_insert(BCuckooHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool bcuckoo_hash_table_delete(BCuckooHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout
+void bcuckoo_hash_table_print(BCuckooHashTable *table);
+
+// print some statistics about 'table' to stdout
+void bcuckoo_hash_table_stats(BCuckooHashTable *table);
+
+// return how many keys 'table' has space for without growing
+int bcuckoo_hash_table_capacity(BCuckooHashTable *table);
+
+// set the load factor (between 0 and 1) above which 'table' will grow
+void bcuckoo_hash_table_set_max_load(BCuckooHashTable *table,
+	double max_load);
+
+#endif
@@ -0,0 +1,792 @@
+/* * * * * * * * *
+ * Dynamic hash table using bucketized cuckoo hashing which any number of
+ * threads may insert into, look up and delete from at once: each bucket is
+ * guarded by one of a fixed set of locks, and an operation only ever holds
+ * the locks of the (at most two) buckets it's working on
+ *
+ * when both of a new key's buckets are full, the inserting thread searches
+ * for a path of moves that would free a slot while holding no locks at all
+ * (beyond a moment's lock to read each bucket it looks at), and then makes
+ * the moves one at a time from the far end of the path, locking just the two
+ * buckets involved in each move. if some other thread changed the path in
+ * the meantime, the insertion simply starts again. only when there is no
+ * path does the table grow, taking every lock and splitting the buckets
+ * across several threads
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#define _POSIX_C_SOURCE 200112L // for posix_memalign and sysconf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "ccuckoo.h"
+#include "spinlock.h"
+
+// how many slots in a bucket. 4 keys and their 4 values fill a 64-byte line
+#define BUCKET_SLOTS 4
+#define CACHE_LINE 64
+
+// a free slot holds this key. since it can't mark a slot holding itself, the
+// key EMPTY is kept in a slot of its own, outside of the buckets
+#define EMPTY 0
+
+// the most buckets an insertion may look at while searching for a path of
+// moves to make room for its key (enough for any path of up to 3 moves). if
+// it finds none, the table grows instead
+#define MAX_SEARCH 512
+
+// buckets are guarded by this many locks (a power of two), bucket 'b' by
+// lock 'b % LOCK_STRIPES'. there are enough that threads working on
+// different keys rarely want the same one, and the number never changes, so
+// threads waiting on a lock can keep waiting on it while the table grows
+#define LOCK_STRIPES 1024
+
+// growing the table only splits its buckets across several threads when
+// each thread would get at least RESIZE_SHARE buckets, and uses at most
+// RESIZE_THREADS threads (including the one that's growing the table)
+#define RESIZE_SHARE (1 << 14)
+#define RESIZE_THREADS 16
+
+// what add_step() and plan_path() return when they find no free slot, and
+// when the table grew while they were looking
+#define FULL -1
+#define STALE -2
+
+// a bucket keeps its keys together so that they can be compared in one go,
+// followed by their values in the same order
+typedef struct bucket {
+	int64 keys[BUCKET_SLOTS];
+	int64 values[BUCKET_SLOTS];
+} Bucket;
+
+// a key and its value, as held outside of the buckets
+typedef struct slot {
+	int64 key;
+	int64 value;
+} Slot;
+
+// a lock, padded out to a cache line so that threads taking neighbouring
+// locks don't slow each other down
+typedef struct stripe {
+	SpinLock lock;
+	char padding[CACHE_LINE - sizeof (SpinLock)];
+} Stripe;
+
+// a step on a path of moves: a bucket, and the step before it, one of whose
+// keys would move into this bucket to make room
+typedef struct step {
+	int bucket;		// the bucket this step reaches
+	int slot;		// the slot in the previous step's bucket of the key to move
+	int parent;		// index of the step before this one, or -1 for the first
+	int64 keys[BUCKET_SLOTS];	// the bucket's keys when the step was added
+} Step;
+
+// the old buckets one thread splits between the new buckets while the table
+// grows
+typedef struct share {
+	pthread_t thread;
+	CCuckooHashTable *table;
+	Bucket *newbuckets;	// the new array of buckets (twice as many)
+	int start;			// the first old bucket to split
+	int end;			// one past the last old bucket to split
+} Share;
+
+// a concurrent cuckoo hash table is a single array of buckets (each key's two
+// buckets come from the same array), along with the locks guarding them and
+// some usage statistics
+struct ccuckoo_table {
+	Stripe stripes[LOCK_STRIPES];	// the locks guarding the buckets
+	Bucket *buckets;	// array of buckets
+	int nbuckets;		// how many buckets (a power of two). both of these
+						// only change while every lock is held
+	SpinLock zero_lock;	// guards the two fields below
+	bool has_zero;		// is the key EMPTY in the table?
+	Slot zero;			// the slot holding the key EMPTY, if it's in the table
+	int ncpus;			// how many threads growing the table may use
+	int moves;			// total keys moved to make room for other keys
+	int failed;			// insertions that found no path and grew the table
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// find the slots of 'bucket' holding 'key', as a mask with bit i for slot i
+// the code was sourced from "bcuckoo.c"
+static int match_key(Bucket *bucket, int64 key) {
+	int mask = 0;
+	int i;
+#if defined(__AVX2__)
+	// 4 keys per compare
+	__m256i k = _mm256_set1_epi64x(key);
+	for (i = 0; i < BUCKET_SLOTS; i += 4) {
+		__m256i keys = _mm256_loadu_si256((__m256i *)&bucket->keys[i]);
+		__m256i eq = _mm256_cmpeq_epi64(keys, k);
+		mask |= _mm256_movemask_pd(_mm256_castsi256_pd(eq)) << i;
+	}
+#elif defined(__SSE2__)
+	// 2 keys per compare. SSE2 can only compare 32-bit lanes, so a key matches
+	// where both of its halves do
+	__m128i k = _mm_set1_epi64x(key);
+	for (i = 0; i < BUCKET_SLOTS; i += 2) {
+		__m128i keys = _mm_loadu_si128((__m128i *)&bucket->keys[i]);
+		__m128i eq = _mm_cmpeq_epi32(keys, k);
+		eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+		mask |= _mm_movemask_pd(_mm_castsi128_pd(eq)) << i;
+	}
+#else
+	for (i = 0; i < BUCKET_SLOTS; i++) {
+		if (bucket->keys[i] == key) {
+			mask |= 1 << i;
+		}
+	}
+#endif
+	return mask;
+}
+
+// the slot of 'bucket' holding 'key', or -1 if it's not in there
+// the code was sourced from "bcuckoo.c"
+static int find_in_bucket(Bucket *bucket, int64 key) {
+	int mask = match_key(bucket, key);
+	int i;
+	for (i = 0; i < BUCKET_SLOTS; i++) {
+		if (mask & (1 << i)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// the two buckets 'key' can live in, out of 'nbuckets'
+#define bucket1(key, nbuckets) ((int)(h1_64(key) & ((nbuckets) - 1)))
+#define bucket2(key, nbuckets) ((int)(h2_64(key) & ((nbuckets) - 1)))
+
+// the lock guarding bucket 'b'
+#define stripe_lock(table, b) (&(table)->stripes[(b) & (LOCK_STRIPES - 1)].lock)
+
+// the number of buckets, for a thread which doesn't (yet) hold any lock. it
+// may be out of date by the time the thread has locked a bucket
+static int current_nbuckets(CCuckooHashTable *table) {
+	return __atomic_load_n(&table->nbuckets, __ATOMIC_ACQUIRE);
+}
+
+// allocate an array of 'nbuckets' buckets, each aligned to a cache line so
+// that it is a single line. its contents are uninitialised
+static Bucket *new_buckets(int nbuckets) {
+	assert(nbuckets * BUCKET_SLOTS < MAX_TABLE_SIZE
+		&& "error: table has grown too large!");
+
+	void *buckets;
+	int error = posix_memalign(&buckets, CACHE_LINE,
+		(sizeof (Bucket)) * nbuckets);
+	assert(error == 0);
+	(void)error;
+	return buckets;
+}
+
+// take the locks guarding buckets 'b1' and 'b2', lowest lock first (so that
+// two threads locking overlapping pairs can't each wait for the other)
+static void lock_pair(CCuckooHashTable *table, int b1, int b2) {
+	SpinLock *first = stripe_lock(table, b1);
+	SpinLock *second = stripe_lock(table, b2);
+	if (first > second) {
+		SpinLock *swap = first;
+		first = second;
+		second = swap;
+	}
+	spin_lock(first);
+	if (second != first) {
+		spin_lock(second);
+	}
+}
+
+// release the locks taken by lock_pair()
+static void unlock_pair(CCuckooHashTable *table, int b1, int b2) {
+	SpinLock *first = stripe_lock(table, b1);
+	SpinLock *second = stripe_lock(table, b2);
+	spin_unlock(first);
+	if (second != first) {
+		spin_unlock(second);
+	}
+}
+
+// lock the two buckets 'key' can live in, storing them in '*b1' and '*b2'.
+// if the table grows before the locks are taken, its buckets are worked out
+// again, so that once this returns they stay put until unlock_pair()
+static void lock_key(CCuckooHashTable *table, int64 key, int *b1, int *b2) {
+	int64 hash1 = h1_64(key);
+	int64 hash2 = h2_64(key);
+	while (true) {
+		int nbuckets = current_nbuckets(table);
+		*b1 = (int)(hash1 & (nbuckets - 1));
+		*b2 = (int)(hash2 & (nbuckets - 1));
+		lock_pair(table, *b1, *b2);
+		if (table->nbuckets == nbuckets) {
+			return;
+		}
+		unlock_pair(table, *b1, *b2);
+	}
+}
+
+// take every lock in order (which keeps out all other threads)
+static void lock_all(CCuckooHashTable *table) {
+	int i;
+	for (i = 0; i < LOCK_STRIPES; i++) {
+		spin_lock(&table->stripes[i].lock);
+	}
+}
+
+// release every lock taken by lock_all()
+static void unlock_all(CCuckooHashTable *table) {
+	int i;
+	for (i = 0; i < LOCK_STRIPES; i++) {
+		spin_unlock(&table->stripes[i].lock);
+	}
+}
+
+// the slot holding 'key' in (locked) bucket 'b1' or 'b2', setting '*bucket'
+// to the bucket it's in, or -1 if it's in neither. (with 'key' EMPTY, this
+// finds a free slot)
+static int find_locked(CCuckooHashTable *table, int64 key, int b1, int b2,
+	Bucket **bucket) {
+	*bucket = &table->buckets[b1];
+	int s = find_in_bucket(*bucket, key);
+	if (s < 0) {
+		*bucket = &table->buckets[b2];
+		s = find_in_bucket(*bucket, key);
+	}
+	return s;
+}
+
+// is 'bucket' already on the path leading to 'path[i]'?
+// the code was sourced from "bcuckoo.c"
+static bool on_path(Step *path, int i, int bucket) {
+	for (; i >= 0; i = path[i].parent) {
+		if (path[i].bucket == bucket) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// add a step reaching 'bucket' to the end of 'path' (at 'path[*nsteps]'),
+// briefly locking the bucket to copy its keys
+// returns a free slot in 'bucket', FULL if it's full, or STALE if the table
+// no longer has 'nbuckets' buckets
+static int add_step(CCuckooHashTable *table, int nbuckets, Step *path,
+	int *nsteps, int bucket, int slot, int parent) {
+	Step *step = &path[*nsteps];
+	step->bucket = bucket;
+	step->slot = slot;
+	step->parent = parent;
+	(*nsteps)++;
+
+	SpinLock *lock = stripe_lock(table, bucket);
+	spin_lock(lock);
+	bool stale = table->nbuckets != nbuckets;
+	if (!stale) {
+		memcpy(step->keys, table->buckets[bucket].keys, sizeof step->keys);
+	}
+	spin_unlock(lock);
+	if (stale) {
+		return STALE;
+	}
+
+	int i;
+	for (i = 0; i < BUCKET_SLOTS; i++) {
+		if (step->keys[i] == EMPTY) {
+			return i;
+		}
+	}
+	return FULL;
+}
+
+// search breadth-first for the shortest path of moves that would free a slot
+// in one of 'key's buckets (as of when the table had 'nbuckets' buckets),
+// holding no lock for longer than it takes to read a bucket
+// returns the index of the step in 'path' reaching a bucket with a free slot
+// (storing the slot in '*spare'), FULL if none is found within MAX_SEARCH
+// buckets, or STALE if the table grew while searching
+static int plan_path(CCuckooHashTable *table, int nbuckets, int64 key,
+	Step *path, int *spare) {
+	int nsteps = 0;
+	int b1 = bucket1(key, nbuckets);
+	int b2 = bucket2(key, nbuckets);
+	*spare = add_step(table, nbuckets, path, &nsteps, b1, -1, -1);
+	if (*spare == FULL && b2 != b1) {
+		*spare = add_step(table, nbuckets, path, &nsteps, b2, -1, -1);
+	}
+
+	int i, s;
+	for (i = 0; i < nsteps && *spare == FULL; i++) {
+		for (s = 0; s < BUCKET_SLOTS && nsteps < MAX_SEARCH && *spare == FULL;
+				s++) {
+			// where could the key in this slot move to? (never back onto the
+			// path, which would move keys that have already moved)
+			int64 other = path[i].keys[s];
+			int next = bucket1(other, nbuckets);
+			if (next == path[i].bucket) {
+				next = bucket2(other, nbuckets);
+			}
+			if (on_path(path, i, next)) {
+				continue;
+			}
+			*spare = add_step(table, nbuckets, path, &nsteps, next, s, i);
+		}
+	}
+
+	if (*spare < 0) {
+		return *spare;
+	}
+	return nsteps - 1;
+}
+
+// make room by moving a key from each bucket on the path ending at
+// 'path[end]' into the next one (starting with the slot 'spare' at the end),
+// locking only the two buckets involved in each move. stops early if
+// another thread has changed a bucket on the path since it was planned
+static void follow_path(CCuckooHashTable *table, int nbuckets, Step *path,
+	int end, int spare) {
+	int i = end;
+	int s = spare;
+	for (; path[i].parent >= 0; i = path[i].parent) {
+		Step *from = &path[path[i].parent];
+		int64 key = from->keys[path[i].slot];
+
+		lock_pair(table, from->bucket, path[i].bucket);
+		bool unchanged = table->nbuckets == nbuckets
+			&& table->buckets[path[i].bucket].keys[s] == EMPTY
+			&& table->buckets[from->bucket].keys[path[i].slot] == key;
+		if (unchanged) {
+			Bucket *to = &table->buckets[path[i].bucket];
+			Bucket *at = &table->buckets[from->bucket];
+			to->keys[s] = key;
+			to->values[s] = at->values[path[i].slot];
+			at->keys[path[i].slot] = EMPTY;
+		}
+		unlock_pair(table, from->bucket, path[i].bucket);
+
+		if (!unchanged) {
+			return;
+		}
+		__atomic_add_fetch(&table->moves, 1, __ATOMIC_RELAXED);
+		s = path[i].slot;
+	}
+}
+
+// split each old bucket in 'share' between the two new buckets its keys can
+// now live in: the bucket at the same place, and the one 'nbuckets' above it
+static void *split_buckets(void *arg) {
+	Share *share = arg;
+	CCuckooHashTable *table = share->table;
+	int nbuckets = table->nbuckets;
+
+	int i, j;
+	for (i = share->start; i < share->end; i++) {
+		Bucket *old = &table->buckets[i];
+		Bucket *low = &share->newbuckets[i];
+		Bucket *high = &share->newbuckets[i + nbuckets];
+		memset(low, 0, sizeof *low);
+		memset(high, 0, sizeof *high);
+
+		// each key is in this bucket by one of its hash values, which with one
+		// more bit picks out one of the new buckets. no other old bucket's
+		// keys go into these two, so they always have room
+		int nlow = 0, nhigh = 0;
+		for (j = 0; j < BUCKET_SLOTS; j++) {
+			int64 key = old->keys[j];
+			if (key == EMPTY) {
+				continue;
+			}
+			int64 hash = h1_64(key);
+			if ((int)(hash & (nbuckets - 1)) != i) {
+				hash = h2_64(key);
+			}
+			if (hash & nbuckets) {
+				high->keys[nhigh] = key;
+				high->values[nhigh++] = old->values[j];
+			} else {
+				low->keys[nlow] = key;
+				low->values[nlow++] = old->values[j];
+			}
+		}
+	}
+	return NULL;
+}
+
+// how many threads to split 'nbuckets' buckets across when growing 'table'
+static int resize_threads(CCuckooHashTable *table, int nbuckets) {
+	int nthreads = nbuckets / RESIZE_SHARE;
+	if (nthreads > table->ncpus) {
+		nthreads = table->ncpus;
+	}
+	if (nthreads > RESIZE_THREADS) {
+		nthreads = RESIZE_THREADS;
+	}
+	return nthreads < 1 ? 1 : nthreads;
+}
+
+// double the number of buckets in 'table', unless another thread has already
+// grown it from 'nbuckets' buckets
+static void resize_table(CCuckooHashTable *table, int nbuckets) {
+	lock_all(table);
+	if (table->nbuckets != nbuckets) {
+		unlock_all(table);
+		return;
+	}
+
+	// doubling never needs any keys moved to make room, so the old buckets
+	// can be split in independent shares, one per thread (this one included)
+	Bucket *newbuckets = new_buckets(nbuckets * 2);
+	Share shares[RESIZE_THREADS];
+	int nthreads = resize_threads(table, nbuckets);
+	int t;
+	for (t = 0; t < nthreads; t++) {
+		shares[t] = (Share){ .table = table, .newbuckets = newbuckets,
+			.start = (int)((int64)nbuckets * t / nthreads),
+			.end = (int)((int64)nbuckets * (t + 1) / nthreads) };
+	}
+	for (t = 1; t < nthreads; t++) {
+		int error = pthread_create(&shares[t].thread, NULL, split_buckets,
+			&shares[t]);
+		assert(error == 0);
+		(void)error;
+	}
+	split_buckets(&shares[0]);
+	for (t = 1; t < nthreads; t++) {
+		pthread_join(shares[t].thread, NULL);
+	}
+
+	free(table->buckets);
+	table->buckets = newbuckets;
+	__atomic_store_n(&table->nbuckets, nbuckets * 2, __ATOMIC_RELEASE);
+	unlock_all(table);
+}
+
+// find 'key' in 'table', inserting it with value 'value' if it's not in
+// there. if it was in there, store the value it had in '*stored' (unless
+// 'stored' is NULL), and replace that value with 'value' if 'replace' is set
+// returns true if 'key' was newly inserted, false if it was already in there
+static bool insert_key(CCuckooHashTable *table, int64 key, int64 value,
+	bool replace, int64 *stored) {
+	// the key EMPTY has a slot of its own
+	if (key == EMPTY) {
+		spin_lock(&table->zero_lock);
+		bool found = table->has_zero;
+		if (found && stored) {
+			*stored = table->zero.value;
+		}
+		if (!found || replace) {
+			table->has_zero = true;
+			table->zero.key = EMPTY;
+			table->zero.value = value;
+		}
+		spin_unlock(&table->zero_lock);
+		return !found;
+	}
+
+	while (true) {
+		int b1, b2;
+		lock_key(table, key, &b1, &b2);
+
+		// is the key already in one of its buckets?
+		Bucket *bucket;
+		int s = find_locked(table, key, b1, b2, &bucket);
+		if (s >= 0) {
+			if (stored) {
+				*stored = bucket->values[s];
+			}
+			if (replace) {
+				bucket->values[s] = value;
+			}
+			unlock_pair(table, b1, b2);
+			return false;
+		}
+
+		// if not, is there a free slot in either of them?
+		s = find_locked(table, EMPTY, b1, b2, &bucket);
+		if (s >= 0) {
+			bucket->keys[s] = key;
+			bucket->values[s] = value;
+			unlock_pair(table, b1, b2);
+			return true;
+		}
+
+		// if not, let go of them and make room, then try again. if there's no
+		// way to make room, grow the table and try again
+		int nbuckets = table->nbuckets;
+		unlock_pair(table, b1, b2);
+
+		Step path[MAX_SEARCH];
+		int spare;
+		int end = plan_path(table, nbuckets, key, path, &spare);
+		if (end >= 0) {
+			follow_path(table, nbuckets, path, end, spare);
+		} else if (end == FULL) {
+			__atomic_add_fetch(&table->failed, 1, __ATOMIC_RELAXED);
+			resize_table(table, nbuckets);
+		}
+	}
+}
+
+// look 'key' up in 'table', storing its value in '*value' (unless 'value' is
+// NULL)
+// returns true if found, false if not
+static bool find_value(CCuckooHashTable *table, int64 key, int64 *value) {
+	// the key EMPTY has a slot of its own (and would match any free slot)
+	if (key == EMPTY) {
+		spin_lock(&table->zero_lock);
+		bool found = table->has_zero;
+		if (found && value) {
+			*value = table->zero.value;
+		}
+		spin_unlock(&table->zero_lock);
+		return found;
+	}
+
+	int b1, b2;
+	lock_key(table, key, &b1, &b2);
+	Bucket *bucket;
+	int s = find_locked(table, key, b1, b2, &bucket);
+	if (s >= 0 && value) {
+		*value = bucket->values[s];
+	}
+	unlock_pair(table, b1, b2);
+	return s >= 0;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a concurrent cuckoo hash table with initial size 'size' slots
+CCuckooHashTable *new_ccuckoo_hash_table(int size) {
+	// align the table to a cache line, so that each lock is on its own line
+	void *memory;
+	int error = posix_memalign(&memory, CACHE_LINE, sizeof (CCuckooHashTable));
+	assert(error == 0);
+	(void)error;
+	CCuckooHashTable *table = memory;
+
+	int i;
+	for (i = 0; i < LOCK_STRIPES; i++) {
+		spin_init(&table->stripes[i].lock);
+	}
+	spin_init(&table->zero_lock);
+	table->has_zero = false;
+	table->moves = 0;
+	table->failed = 0;
+
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	table->ncpus = ncpus > 0 ? (int)ncpus : 1;
+
+	// zeroed memory is an array of free slots
+	table->nbuckets = next_power_of_two((size + BUCKET_SLOTS - 1)
+		/ BUCKET_SLOTS);
+	table->buckets = new_buckets(table->nbuckets);
+	memset(table->buckets, 0, (sizeof *table->buckets) * table->nbuckets);
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_ccuckoo_hash_table(CCuckooHashTable *table) {
+	assert(table != NULL);
+	free(table->buckets);
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool ccuckoo_hash_table_insert(CCuckooHashTable *table, int64 key) {
+	assert(table != NULL);
+	return insert_key(table, key, 0, false, NULL);
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool ccuckoo_hash_table_lookup(CCuckooHashTable *table, int64 key) {
+	assert(table != NULL);
+	return find_value(table, key, NULL);
+}
+
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int ccuckoo_hash_table_lookup_batch(CCuckooHashTable *table, int64 *keys,
+	int n, bool *results) {
+	assert(table != NULL);
+
+	int found = 0;
+	int i, j;
+	for (i = 0; i < n; i += BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// prefetch both buckets of every key in the group. (the table may grow
+		// in the meantime, but prefetching a stale address does no harm)
+		int nbuckets = current_nbuckets(table);
+		Bucket *buckets = __atomic_load_n(&table->buckets, __ATOMIC_RELAXED);
+		for (j = 0; j < group; j++) {
+			prefetch(&buckets[bucket1(keys[i + j], nbuckets)]);
+			prefetch(&buckets[bucket2(keys[i + j], nbuckets)]);
+		}
+		for (j = 0; j < group; j++) {
+			results[i + j] = find_value(table, keys[i + j], NULL);
+			found += results[i + j];
+		}
+	}
+	return found;
+}
+
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool ccuckoo_hash_table_put(CCuckooHashTable *table, int64 key, int64 value) {
+	assert(table != NULL);
+	return insert_key(table, key, value, true, NULL);
+}
+
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool ccuckoo_hash_table_get(CCuckooHashTable *table, int64 key, int64 *value) {
+	assert(table != NULL);
+	return find_value(table, key, value);
+}
+
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool ccuckoo_hash_table_get_or_insert(CCuckooHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table != NULL);
+
+	int64 stored = value;
+	bool inserted = insert_key(table, key, value, false, &stored);
+	if (result) {
+		*result = stored;
+	}
+	return inserted;
+}
+
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool ccuckoo_hash_table_delete(CCuckooHashTable *table, int64 key) {
+	assert(table != NULL);
+
+	// the key EMPTY has a slot of its own
+	if (key == EMPTY) {
+		spin_lock(&table->zero_lock);
+		bool found = table->has_zero;
+		table->has_zero = false;
+		spin_unlock(&table->zero_lock);
+		return found;
+	}
+
+	// no other key depends on this key's slot, so we can just free it
+	int b1, b2;
+	lock_key(table, key, &b1, &b2);
+	Bucket *bucket;
+	int s = find_locked(table, key, b1, b2, &bucket);
+	if (s >= 0) {
+		bucket->keys[s] = EMPTY;
+	}
+	unlock_pair(table, b1, b2);
+	return s >= 0;
+}
+
+
+// print the contents of 'table' to stdout
+void ccuckoo_hash_table_print(CCuckooHashTable *table) {
+	assert(table != NULL);
+	lock_all(table);
+
+	printf("--- table size: %d buckets of %d\n", table->nbuckets,
+		BUCKET_SLOTS);
+
+	// print header
+	printf("    bucket | keys\n");
+
+	// print each bucket's keys on a row
+	int i, j;
+	for (i = 0; i < table->nbuckets; i++) {
+		printf(" %9d |", i);
+		for (j = 0; j < BUCKET_SLOTS; j++) {
+			if (table->buckets[i].keys[j] != EMPTY) {
+				printf(" %llu", table->buckets[i].keys[j]);
+			} else {
+				printf(" -");
+			}
+		}
+		printf("\n");
+	}
+
+	// the key EMPTY lives outside of the buckets
+	spin_lock(&table->zero_lock);
+	if (table->has_zero) {
+		printf(" %9s | %llu\n", "-", table->zero.key);
+	}
+	spin_unlock(&table->zero_lock);
+
+	printf("--- end table ---\n");
+	unlock_all(table);
+}
+
+
+// print some statistics about 'table' to stdout
+void ccuckoo_hash_table_stats(CCuckooHashTable *table) {
+	assert(table != NULL);
+	lock_all(table);
+	printf("--- table stats ---\n");
+
+	// (threads don't keep count of the keys, which would have them all
+	// updating the same counter, so count them up here)
+	int load = 0;
+	int i, j;
+	for (i = 0; i < table->nbuckets; i++) {
+		for (j = 0; j < BUCKET_SLOTS; j++) {
+			load += table->buckets[i].keys[j] != EMPTY;
+		}
+	}
+
+	int size = table->nbuckets * BUCKET_SLOTS;
+	printf("current size: %d buckets of %d slots\n", table->nbuckets,
+		BUCKET_SLOTS);
+	printf("current load: %d items\n", load + table->has_zero);
+	printf(" load factor: %.3f%%\n", load * 100.0 / size);
+	printf("  keys moved: %d\n", table->moves);
+	printf("failed paths: %d\n", table->failed);
+	printf("  lock count: %d\n", LOCK_STRIPES);
+	printf("--- end stats ---\n");
+	unlock_all(table);
+}
+
+
+// return how many keys 'table' has space for without growing
+int ccuckoo_hash_table_capacity(CCuckooHashTable *table) {
+	assert(table != NULL);
+	return current_nbuckets(table) * BUCKET_SLOTS;
+}
@@ -0,0 +1,70 @@
+/* * * * * * * * *
+ * Dynamic hash table using bucketized cuckoo hashing which any number of
+ * threads may insert into, look up and delete from at once: each bucket is
+ * guarded by one of a fixed set of locks, and an operation only ever holds
+ * the locks of the (at most two) buckets it's working on
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef CCUCKOO_H
+#define CCUCKOO_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+
+typedef struct ccuckoo_table CCuckooHashTable;
+
+// initialise a concurrent cuckoo hash table with initial size 'size' slots
+// (rounded up to a power of two number of buckets)
+CCuckooHashTable *new_ccuckoo_hash_table(int size);
+
+// free all memory associated with 'table' (once no other thread is using it)
+void free_ccuckoo_hash_table(CCuckooHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool ccuckoo_hash_table_insert(CCuckooHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool ccuckoo_hash_table_lookup(CCuckooHashTable *table, int64 key);
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'. keys are hashed in groups, and both of their
+// buckets are prefetched before any of them are probed
+// returns how many of the keys were found
+int ccuckoo_hash_table_lookup_batch(CCuckooHashTable *table, int64 *keys,
+	int n, bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool ccuckoo_hash_table_put(CCuckooHashTable *table, int64 key, int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool ccuckoo_hash_table_get(CCuckooHashTable *table, int64 key, int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool ccuckoo_hash_table_get_or_insert(CCuckooHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool ccuckoo_hash_table_delete(CCuckooHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout
+void ccuckoo_hash_table_print(CCuckooHashTable *table);
+
+// print some statistics about 'table' to stdout
+void ccuckoo_hash_table_stats(CCuckooHashTable *table);
+
+// return how many keys 'table' has space for without growing
+int ccuckoo_hash_table_capacity(CCuckooHashTable *table);
+
+#endif
@@ -0,0 +1,864 @@
+/* * * * * * * * *
+ * Dynamic hash table using linear probing which any number of threads may
+ * insert into, look up and delete from at once without taking any locks:
+ * threads claim slots with compare-and-swap, and help each other move keys
+ * across when the table grows (after Cliff Click's non-blocking hash table)
+ *
+ * each slot has a key, claimed once with a 64-bit compare-and-swap and never
+ * changed after that, and a value and state which always change together in
+ * one 128-bit compare-and-swap. the state says whether the key is in the
+ * table, and, once the array starts moving to a bigger one, freezes the slot
+ * so that no thread can change it any more. any thread wanting to change a
+ * frozen slot first copies it across (copying a slot twice does no harm),
+ * and then makes its change in the new array
+ *
+ * lookups of whether a key is there never wait on other threads (reading a
+ * key's value may have to read it again, if a writer changes it meanwhile).
+ * the only thing they write is a record belonging to their own thread (on a
+ * cache line of its own), saying which epoch it's in, so that an old array
+ * isn't freed while they might still be reading it
+ *
+ * deleted keys keep their slots (until the array is replaced), so that a
+ * key found in a slot is always found in that same slot
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#define _POSIX_C_SOURCE 200112L // for posix_memalign
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "clinear.h"
+#include "spinlock.h"
+
+#define CACHE_LINE 64
+
+// a free slot holds this key. since it can't mark a slot holding itself, the
+// key EMPTY is kept in a slot of its own, outside of the arrays
+#define EMPTY 0
+
+// grow the table once more than this fraction of an array's slots have been
+// claimed (deleted keys' slots included)
+#define DEFAULT_MAX_LOAD 0.75
+
+// threads spread counts across this many cache lines, so that they don't all
+// fight over one
+#define SHARDS 16
+
+// threads changing an array whose keys are moving copy this many slots
+// across each time
+#define COPY_CHUNK 1024
+
+// after claiming a slot, a thread adds up how many slots have been claimed
+// (to see if the array should grow) if it had to probe further than
+// LONG_PROBE slots, if the array is no bigger than SMALL_ARRAY slots, or
+// otherwise once every CHECK_EVERY claims
+#define LONG_PROBE 8
+#define SMALL_ARRAY 1024
+#define CHECK_EVERY 64
+
+// what find_slot() returns when the key isn't in an array, and when the
+// array is full without it
+#define NOT_THERE -1
+#define FULL -2
+
+// what update_pair() returns when the slot is frozen
+#define MOVED -1
+
+// the bits of a slot's state
+#define LIVE 1		// the slot's key is in the table, and maps to the value
+#define FROZEN 2	// the slot can't change any more, as its array is moving
+#define COPIED 4	// the slot's key (if live) is in the next array now
+#define VERSION 8	// added to the state each time the value or LIVE changes,
+					// so a state of less than VERSION has never been written
+
+// a slot's value along with its state, changed together in one go
+typedef struct pair {
+	int64 value;
+	int64 state;
+} __attribute__((aligned(16))) Pair;
+
+// a count spread across shards (see SHARDS), each on its own cache line
+typedef struct counter {
+	long count;
+	char padding[CACHE_LINE - sizeof (long)];
+} Counter;
+
+// each thread using a table has a record of its own, saying which epoch it
+// is part way through an operation in (see pin()). records are shared by all
+// tables, and once a thread exits, its record is free for another to take
+typedef struct record Record;
+struct record {
+	unsigned long pinned;	// the epoch the thread is pinned in, or 0
+	Record *next;			// the next record in the list of all of them
+	int taken;				// does a thread own this record?
+	char padding[CACHE_LINE - sizeof (unsigned long) - sizeof (Record *)
+		- sizeof (int)];
+};
+
+// one array of slots. the keys are kept apart from the values and states so
+// that probing past other keys reads as few cache lines as possible
+typedef struct array Array;
+struct array {
+	Counter used[SHARDS];	// slots claimed, by shard
+	int64 *keys;		// the key in each slot, or EMPTY if it's free
+	Pair *pairs;		// the value and state of each slot
+	int size;			// how many slots (a power of two)
+	Array *next;		// the array keys are moving to, or NULL
+	int copy_next;		// the first slot no thread has started copying yet
+	int copy_done;		// how many slots have been copied
+};
+
+// a lock-free linear probing table is a chain of arrays: normally just one,
+// but while the table grows, the older array's keys are on their way to the
+// next one. threads starting an operation begin at the oldest
+struct clinear_table {
+	Counter live[SHARDS];	// keys in the table, by shard
+	Array *current;		// the oldest array, where operations begin
+	Pair zero;			// the key EMPTY's value and state
+	SpinLock retiring;	// held while retiring old arrays
+	double max_load;	// grow once this fraction of an array's slots is used
+	int resizes;		// how many times the table has started to grow
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// the shard this thread counts in (-1 until it first needs one)
+static __thread int shard = -1;
+
+// how many threads have picked a shard so far
+static int nthreads = 0;
+
+// every thread's record (see pin()), the calling thread's, and a key whose
+// destructor frees the calling thread's record when it exits
+static Record *records = NULL;
+static __thread Record *record = NULL;
+static pthread_key_t record_key;
+static pthread_once_t record_key_once = PTHREAD_ONCE_INIT;
+
+// goes up each time an old array of any table is retired (starting from 1,
+// since a record pinned in epoch 0 would look unpinned)
+static unsigned long epoch = 1;
+
+// the shard the calling thread counts in
+static int my_shard(void) {
+	if (shard < 0) {
+		shard = __atomic_fetch_add(&nthreads, 1, __ATOMIC_RELAXED) % SHARDS;
+	}
+	return shard;
+}
+
+// add up a count spread across shards
+static long sum_counter(Counter *counter) {
+	long sum = 0;
+	int i;
+	for (i = 0; i < SHARDS; i++) {
+		sum += __atomic_load_n(&counter[i].count, __ATOMIC_RELAXED);
+	}
+	return sum;
+}
+
+// replace 'pair' with 'desired' if it is still 'expected', in one go
+// returns true if it was replaced
+#if defined(__x86_64__)
+__attribute__((target("cx16")))
+#endif
+static bool cas_pair(Pair *pair, Pair expected, Pair desired) {
+	unsigned __int128 old, new;
+	memcpy(&old, &expected, sizeof old);
+	memcpy(&new, &desired, sizeof new);
+	return __sync_bool_compare_and_swap((unsigned __int128 *)pair, old, new);
+}
+
+// read 'pair', returning a value and the state it had alongside that value
+static Pair read_pair(Pair *pair) {
+	Pair p;
+	int64 state;
+	do {
+		p.state = __atomic_load_n(&pair->state, __ATOMIC_ACQUIRE);
+		p.value = __atomic_load_n(&pair->value, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		state = __atomic_load_n(&pair->state, __ATOMIC_RELAXED);
+	} while (state != p.state);
+	return p;
+}
+
+// the array 'array''s keys are moving to, or NULL if they're not moving
+static Array *next_array(Array *array) {
+	return __atomic_load_n(&array->next, __ATOMIC_ACQUIRE);
+}
+
+// allocate a new array of 'size' free slots (a power of two)
+static Array *new_array(int size) {
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+
+	void *memory;
+	int error = posix_memalign(&memory, CACHE_LINE, sizeof (Array));
+	assert(error == 0);
+	Array *array = memory;
+	memset(array->used, 0, sizeof array->used);
+
+	// zeroed memory is an array of free slots, none of them ever written
+	array->keys = calloc(size, sizeof *array->keys);
+	assert(array->keys);
+	error = posix_memalign(&memory, CACHE_LINE, (sizeof (Pair)) * size);
+	assert(error == 0);
+	(void)error;
+	array->pairs = memory;
+	memset(array->pairs, 0, (sizeof (Pair)) * size);
+
+	array->size = size;
+	array->next = NULL;
+	array->copy_next = 0;
+	array->copy_done = 0;
+	return array;
+}
+
+// free all memory associated with 'array'
+static void free_array(Array *array) {
+	free(array->keys);
+	free(array->pairs);
+	free(array);
+}
+
+// give up the record of a thread which is exiting
+static void release_record(void *arg) {
+	Record *mine = arg;
+	__atomic_store_n(&mine->taken, false, __ATOMIC_RELEASE);
+}
+
+static void create_record_key(void) {
+	int error = pthread_key_create(&record_key, release_record);
+	assert(error == 0);
+	(void)error;
+}
+
+// the calling thread's record, taking a free one (or adding a new one to the
+// list) the first time
+static Record *my_record(void) {
+	if (record) {
+		return record;
+	}
+
+	Record *r;
+	for (r = __atomic_load_n(&records, __ATOMIC_ACQUIRE); r; r = r->next) {
+		int taken = false;
+		if (!__atomic_load_n(&r->taken, __ATOMIC_RELAXED)
+				&& __atomic_compare_exchange_n(&r->taken, &taken, true, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+	if (!r) {
+		void *memory;
+		int error = posix_memalign(&memory, CACHE_LINE, sizeof (Record));
+		assert(error == 0);
+		(void)error;
+		r = memory;
+		r->pinned = 0;
+		r->taken = true;
+		// (a failed compare-and-swap leaves the new head in 'r->next')
+		r->next = __atomic_load_n(&records, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&records, &r->next, r, true,
+				__ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+			continue;
+		}
+	}
+
+	pthread_once(&record_key_once, create_record_key);
+	pthread_setspecific(record_key, r);
+	record = r;
+	return r;
+}
+
+// note that the calling thread is starting an operation, so that no array it
+// might look at is freed until it's done. this only writes the thread's own
+// record, and never waits: if the epoch moves on between reading it and
+// recording it, a thread retiring an array just waits for this operation too
+static void pin(void) {
+	Record *mine = my_record();
+	__atomic_store_n(&mine->pinned, __atomic_load_n(&epoch, __ATOMIC_SEQ_CST),
+		__ATOMIC_SEQ_CST);
+}
+
+// note that the calling thread has finished the operation begun with pin()
+static void unpin(void) {
+	__atomic_store_n(&record->pinned, 0, __ATOMIC_RELEASE);
+}
+
+// free 'array', which no operation starting from now can reach, once every
+// operation which might still be looking at it has finished
+static void retire(Array *array) {
+	// operations starting from now are pinned in the new epoch (or a later
+	// one), so only threads pinned in an earlier one might still see 'array'.
+	// (a thread adding its record after this reads the list can only start
+	// its operation after 'array' was unlinked, so it needn't be checked)
+	unsigned long now = __atomic_add_fetch(&epoch, 1, __ATOMIC_SEQ_CST);
+	Record *r;
+	for (r = __atomic_load_n(&records, __ATOMIC_SEQ_CST); r; r = r->next) {
+		unsigned long pinned;
+		while ((pinned = __atomic_load_n(&r->pinned, __ATOMIC_SEQ_CST))
+				&& pinned < now) {
+			sched_yield();
+		}
+	}
+	free_array(array);
+}
+
+// replace the oldest array with the next one for as long as the oldest has
+// been copied in full, retiring it. (only call this while not pinned, since
+// it waits for pinned threads)
+static void promote(CLinearHashTable *table) {
+	spin_lock(&table->retiring);
+	Array *array = table->current;
+	while (next_array(array)
+			&& __atomic_load_n(&array->copy_done, __ATOMIC_ACQUIRE)
+			== array->size) {
+		__atomic_store_n(&table->current, next_array(array), __ATOMIC_SEQ_CST);
+		retire(array);
+		array = table->current;
+	}
+	spin_unlock(&table->retiring);
+}
+
+// begin moving the keys in 'array' to a new array, unless that's already
+// begun
+static void start_resize(CLinearHashTable *table, Array *array) {
+	if (next_array(array)) {
+		return;
+	}
+
+	// the keys there are now should take up no more than two thirds of the
+	// load the new array allows. (if most of the claimed slots are deleted
+	// keys, the new array may be the same size: the move just clears them out)
+	long live = sum_counter(table->live);
+	int size = array->size;
+	while (live > size * table->max_load * 2 / 3) {
+		size *= 2;
+	}
+
+	// several threads may get this far at once, but only one array wins
+	Array *next = new_array(size);
+	Array *expected = NULL;
+	if (__atomic_compare_exchange_n(&array->next, &expected, next, false,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		__atomic_add_fetch(&table->resizes, 1, __ATOMIC_RELAXED);
+	} else {
+		free_array(next);
+	}
+}
+
+// see whether more than the allowed fraction of 'array''s slots have been
+// claimed, and begin to grow if so
+static void check_load(CLinearHashTable *table, Array *array) {
+	if (sum_counter(array->used) > array->size * table->max_load) {
+		start_resize(table, array);
+	}
+}
+
+// find the slot of 'array' holding 'key', first claiming a free slot for it
+// if it's not in there and 'claim' is set
+// returns the index of the slot, NOT_THERE if 'key' isn't in 'array' (and
+// 'claim' isn't set), or FULL if every slot holds some other key
+static int find_slot(CLinearHashTable *table, Array *array, int64 key,
+	bool claim) {
+	int mask = array->size - 1;
+	int h = h1_64(key) & mask;
+	int probes;
+	for (probes = 0; probes < array->size; probes++, h = (h + 1) & mask) {
+		int64 found = __atomic_load_n(&array->keys[h], __ATOMIC_ACQUIRE);
+		if (found == EMPTY) {
+			if (!claim) {
+				return NOT_THERE;
+			}
+			if (__atomic_compare_exchange_n(&array->keys[h], &found, key,
+					false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				long used = __atomic_add_fetch(
+					&array->used[my_shard()].count, 1, __ATOMIC_RELAXED);
+				if (probes > LONG_PROBE || array->size <= SMALL_ARRAY
+						|| used % CHECK_EVERY == 0) {
+					check_load(table, array);
+				}
+				return h;
+			}
+			// (otherwise 'found' is now the key another thread claimed it for)
+		}
+		if (found == key) {
+			return h;
+		}
+	}
+	return FULL;
+}
+
+static void copy_slot(CLinearHashTable *table, Array *array, int i);
+
+// put 'key' with value 'value' into 'array' (or a later one), unless it's
+// already been put there. used to copy keys from the array before
+static void copy_key(CLinearHashTable *table, Array *array, int64 key,
+	int64 value) {
+	while (true) {
+		int i = find_slot(table, array, key, true);
+		if (i == FULL) {
+			start_resize(table, array);
+			array = next_array(array);
+			continue;
+		}
+
+		// no thread changes a key in this array until it has been copied
+		// here, so any write at all means it has been
+		Pair *pair = &array->pairs[i];
+		Pair p = read_pair(pair);
+		if (p.state >= VERSION) {
+			return;
+		}
+		if (p.state & FROZEN) {
+			// (this array is moving too, so the key belongs in the next one)
+			copy_slot(table, array, i);
+			array = next_array(array);
+			continue;
+		}
+		if (cas_pair(pair, p, (Pair){ value, VERSION | LIVE })) {
+			return;
+		}
+	}
+}
+
+// freeze slot 'i' of 'array', copy its key to the next array if it's in the
+// table, and mark it as copied. any number of threads may do this for the
+// same slot at once
+static void copy_slot(CLinearHashTable *table, Array *array, int i) {
+	Pair *pair = &array->pairs[i];
+	Pair p = read_pair(pair);
+	while (!(p.state & FROZEN)) {
+		Pair frozen = { p.value, p.state | FROZEN };
+		if (cas_pair(pair, p, frozen)) {
+			p = frozen;
+		} else {
+			p = read_pair(pair);
+		}
+	}
+	if (p.state & COPIED) {
+		return;
+	}
+
+	// frozen, the value can't change any more
+	if (p.state & LIVE) {
+		copy_key(table, next_array(array),
+			__atomic_load_n(&array->keys[i], __ATOMIC_RELAXED), p.value);
+	}
+	while (!(p.state & COPIED)) {
+		Pair copied = { p.value, p.state | COPIED };
+		if (!cas_pair(pair, p, copied)) {
+			p = read_pair(pair);
+		}
+		else {
+			p = copied;
+		}
+	}
+}
+
+// copy the next chunk of 'array''s slots (which are moving to the next
+// array) across, if there are any left to copy
+// returns true if this finished copying the whole array
+static bool help_copy(CLinearHashTable *table, Array *array) {
+	if (__atomic_load_n(&array->copy_next, __ATOMIC_RELAXED) >= array->size) {
+		return false;
+	}
+	int start = __atomic_fetch_add(&array->copy_next, COPY_CHUNK,
+		__ATOMIC_RELAXED);
+	if (start >= array->size) {
+		return false;
+	}
+	int end = start + COPY_CHUNK < array->size
+		? start + COPY_CHUNK : array->size;
+
+	int i;
+	for (i = start; i < end; i++) {
+		copy_slot(table, array, i);
+	}
+	return __atomic_add_fetch(&array->copy_done, end - start,
+		__ATOMIC_ACQ_REL) == array->size;
+}
+
+// the ways update_pair() can change a slot
+typedef enum update {
+	INSERT, PUT, GET_OR_INSERT, DELETE
+} Update;
+
+// make the change 'update' to the slot with value and state 'pair', using
+// 'value' as the new value (for all but DELETE). if the key was in the table
+// already, store its value in '*old' (unless 'old' is NULL)
+// returns MOVED if the slot is frozen, and otherwise true if the key was
+// newly inserted (or for DELETE, was removed), false if not
+static int update_pair(Pair *pair, Update update, int64 value, int64 *old) {
+	while (true) {
+		Pair p = read_pair(pair);
+		if (p.state & FROZEN) {
+			return MOVED;
+		}
+		bool live = p.state & LIVE;
+		if (live && old) {
+			*old = p.value;
+		}
+		if ((update == DELETE && !live)
+				|| ((update == INSERT || update == GET_OR_INSERT) && live)) {
+			return false;
+		}
+
+		Pair q = { value, (p.state + VERSION) | LIVE };
+		if (update == DELETE) {
+			q = (Pair){ p.value, (p.state + VERSION) & ~LIVE };
+		}
+		if (cas_pair(pair, p, q)) {
+			return update == DELETE || !live;
+		}
+	}
+}
+
+// make the change 'update' to 'key' in 'table' (see update_pair())
+// returns true if the key was newly inserted (or for DELETE, was removed),
+// false if not
+static bool update_key(CLinearHashTable *table, int64 key, Update update,
+	int64 value, int64 *old) {
+	int result;
+	Counter *live = &table->live[my_shard()];
+
+	// the key EMPTY has a slot of its own, which never moves
+	if (key == EMPTY) {
+		result = update_pair(&table->zero, update, value, old);
+		if (result) {
+			__atomic_add_fetch(&live->count, update == DELETE ? -1 : 1,
+				__ATOMIC_RELAXED);
+		}
+		return result;
+	}
+
+	pin();
+	bool finished = false;
+	Array *array = __atomic_load_n(&table->current, __ATOMIC_SEQ_CST);
+	while (true) {
+		// help along any move out of this array before changing it
+		Array *next = next_array(array);
+		if (next) {
+			finished |= help_copy(table, array);
+		}
+
+		// a key which isn't in an array with free slots left can't have made
+		// it into a later one either (see find_key())
+		int i = find_slot(table, array, key, update != DELETE);
+		if (i == NOT_THERE) {
+			result = false;
+			break;
+		}
+		if (i == FULL) {
+			if (update == DELETE && !next) {
+				result = false;
+				break;
+			}
+			start_resize(table, array);
+			array = next_array(array);
+			continue;
+		}
+
+		// if the slot has been frozen, make sure it's been copied before
+		// making the change in the next array
+		result = update_pair(&array->pairs[i], update, value, old);
+		if (result != MOVED) {
+			break;
+		}
+		copy_slot(table, array, i);
+		array = next_array(array);
+	}
+	unpin();
+
+	if (finished) {
+		promote(table);
+	}
+	if (result) {
+		__atomic_add_fetch(&live->count, update == DELETE ? -1 : 1,
+			__ATOMIC_RELAXED);
+	}
+	return result;
+}
+
+// look 'key' up in 'table', storing its value in '*value' unless 'value' is
+// NULL (in which case this never waits on other threads)
+// returns true if found, false if not
+static bool find_key(CLinearHashTable *table, int64 key, int64 *value) {
+	Pair p;
+
+	// the key EMPTY has a slot of its own
+	if (key == EMPTY) {
+		p = read_pair(&table->zero);
+		if ((p.state & LIVE) && value) {
+			*value = p.value;
+		}
+		return p.state & LIVE;
+	}
+
+	pin();
+	bool found = false;
+	Array *array = __atomic_load_n(&table->current, __ATOMIC_SEQ_CST);
+	while (array) {
+		// threads only put a key in a later array after finding its slot in
+		// this one frozen, or finding this one full. so reaching a free slot
+		// means the key isn't in the table
+		int i = find_slot(table, array, key, false);
+		if (i == NOT_THERE) {
+			break;
+		}
+		if (i == FULL) {
+			array = next_array(array);
+			continue;
+		}
+
+		// a copied slot's key is in the next array. (until it's copied, no
+		// thread can change it there, so the frozen state is up to date)
+		Pair *pair = &array->pairs[i];
+		if (value) {
+			p = read_pair(pair);
+		} else {
+			p.state = __atomic_load_n(&pair->state, __ATOMIC_ACQUIRE);
+		}
+		if (p.state & COPIED) {
+			array = next_array(array);
+			continue;
+		}
+		found = p.state & LIVE;
+		if (found && value) {
+			*value = p.value;
+		}
+		break;
+	}
+	unpin();
+	return found;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a lock-free linear probing hash table with initial size 'size'
+CLinearHashTable *new_clinear_hash_table(int size) {
+	// align the table to a cache line, so that each count is on its own line
+	void *memory;
+	int error = posix_memalign(&memory, CACHE_LINE, sizeof (CLinearHashTable));
+	assert(error == 0);
+	(void)error;
+	CLinearHashTable *table = memory;
+
+	memset(table->live, 0, sizeof table->live);
+	table->zero = (Pair){ 0, 0 };
+	spin_init(&table->retiring);
+	table->max_load = DEFAULT_MAX_LOAD;
+	table->resizes = 0;
+	table->current = new_array(next_power_of_two(size));
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_clinear_hash_table(CLinearHashTable *table) {
+	assert(table != NULL);
+
+	// (including any arrays keys were still moving to)
+	Array *array = table->current;
+	while (array) {
+		Array *next = array->next;
+		free_array(array);
+		array = next;
+	}
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool clinear_hash_table_insert(CLinearHashTable *table, int64 key) {
+	assert(table != NULL);
+	return update_key(table, key, INSERT, 0, NULL);
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool clinear_hash_table_lookup(CLinearHashTable *table, int64 key) {
+	assert(table != NULL);
+	return find_key(table, key, NULL);
+}
+
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int clinear_hash_table_lookup_batch(CLinearHashTable *table, int64 *keys,
+	int n, bool *results) {
+	assert(table != NULL);
+
+	int found = 0;
+	int i, j;
+	for (i = 0; i < n; i += BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// prefetch the first slot each key in the group will probe (in the
+		// current array, which may be retired before the lookups get there,
+		// but prefetching memory that's been freed does no harm)
+		pin();
+		Array *array = __atomic_load_n(&table->current, __ATOMIC_SEQ_CST);
+		int mask = array->size - 1;
+		for (j = 0; j < group; j++) {
+			prefetch(&array->keys[h1_64(keys[i + j]) & mask]);
+		}
+		unpin();
+
+		for (j = 0; j < group; j++) {
+			results[i + j] = find_key(table, keys[i + j], NULL);
+			found += results[i + j];
+		}
+	}
+	return found;
+}
+
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool clinear_hash_table_put(CLinearHashTable *table, int64 key, int64 value) {
+	assert(table != NULL);
+	return update_key(table, key, PUT, value, NULL);
+}
+
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool clinear_hash_table_get(CLinearHashTable *table, int64 key, int64 *value) {
+	assert(table != NULL);
+
+	// (find_key() only reads the value when asked for it)
+	int64 got;
+	bool found = find_key(table, key, &got);
+	if (found && value) {
+		*value = got;
+	}
+	return found;
+}
+
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool clinear_hash_table_get_or_insert(CLinearHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table != NULL);
+
+	int64 stored = value;
+	bool inserted = update_key(table, key, GET_OR_INSERT, value, &stored);
+	if (result) {
+		*result = inserted ? value : stored;
+	}
+	return inserted;
+}
+
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool clinear_hash_table_delete(CLinearHashTable *table, int64 key) {
+	assert(table != NULL);
+	return update_key(table, key, DELETE, 0, NULL);
+}
+
+
+// print the contents of 'table' to stdout
+void clinear_hash_table_print(CLinearHashTable *table) {
+	assert(table != NULL);
+
+	Array *array = table->current;
+	printf("--- table size: %d\n", array->size);
+
+	// print header
+	printf("   address | key\n");
+
+	// print the rows of each array, marking deleted keys (which still hold
+	// their slots) and keys which have moved on to the next array
+	while (array) {
+		int i;
+		for (i = 0; i < array->size; i++) {
+			printf(" %9d | ", i);
+			int64 state = array->pairs[i].state;
+			if (array->keys[i] == EMPTY) {
+				printf("-\n");
+			} else if (state & COPIED) {
+				printf("%llu (moved)\n", array->keys[i]);
+			} else if (state & LIVE) {
+				printf("%llu\n", array->keys[i]);
+			} else {
+				printf("%llu (deleted)\n", array->keys[i]);
+			}
+		}
+		array = array->next;
+		if (array) {
+			printf("--- next array size: %d\n", array->size);
+		}
+	}
+
+	// the key EMPTY lives outside of the arrays
+	if (table->zero.state & LIVE) {
+		printf(" %9s | %llu\n", "-", (int64)EMPTY);
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void clinear_hash_table_stats(CLinearHashTable *table) {
+	assert(table != NULL);
+	printf("--- table stats ---\n");
+
+	Array *array = table->current;
+	long live = sum_counter(table->live);
+	long used = sum_counter(array->used);
+	printf("current size: %d slots\n", array->size);
+	printf("current load: %ld items\n", live);
+	printf(" load factor: %.3f%%\n", live * 100.0 / array->size);
+	printf("  slots used: %ld (deleted keys included)\n", used);
+	printf("    max load: %.3f%%\n", table->max_load * 100.0);
+	printf("     resizes: %d\n", table->resizes);
+	if (array->next) {
+		printf("   migrating: %d of %d old slots left\n",
+			array->size - array->copy_done, array->size);
+	}
+	printf("--- end stats ---\n");
+}
+
+
+// return how many keys 'table' has space for without growing
+int clinear_hash_table_capacity(CLinearHashTable *table) {
+	assert(table != NULL);
+
+	pin();
+	int size = __atomic_load_n(&table->current, __ATOMIC_SEQ_CST)->size;
+	unpin();
+	return size;
+}
+
+
+// set the load factor (between 0 and 1) above which 'table' will grow
+void clinear_hash_table_set_max_load(CLinearHashTable *table,
+	double max_load) {
+	assert(table != NULL);
+	assert(max_load > 0 && max_load <= 1);
+	table->max_load = max_load;
+}
@@ -0,0 +1,75 @@
+/* * * * * * * * *
+ * Dynamic hash table using linear probing which any number of threads may
+ * insert into, look up and delete from at once without taking any locks:
+ * threads claim slots with compare-and-swap, and help each other move keys
+ * across when the table grows
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef CLINEAR_H
+#define CLINEAR_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+
+typedef struct clinear_table CLinearHashTable;
+
+// initialise a lock-free linear probing hash table with initial size 'size'
+// (rounded up to a power of two)
+CLinearHashTable *new_clinear_hash_table(int size);
+
+// free all memory associated with 'table' (once no other thread is using it)
+void free_clinear_hash_table(CLinearHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool clinear_hash_table_insert(CLinearHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'. never waits for other threads
+// returns true if found, false if not
+bool clinear_hash_table_lookup(CLinearHashTable *table, int64 key);
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'. keys are hashed in groups, and the slots they
+// will probe first are prefetched before any of them are probed
+// returns how many of the keys were found
+int clinear_hash_table_lookup_batch(CLinearHashTable *table, int64 *keys,
+	int n, bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool clinear_hash_table_put(CLinearHashTable *table, int64 key, int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool clinear_hash_table_get(CLinearHashTable *table, int64 key, int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool clinear_hash_table_get_or_insert(CLinearHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool clinear_hash_table_delete(CLinearHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout (while no other thread is
+// changing it)
+void clinear_hash_table_print(CLinearHashTable *table);
+
+// print some statistics about 'table' to stdout
+void clinear_hash_table_stats(CLinearHashTable *table);
+
+// return how many keys 'table' has space for without growing
+int clinear_hash_table_capacity(CLinearHashTable *table);
+
+// set the load factor (between 0 and 1) above which 'table' will grow
+void clinear_hash_table_set_max_load(CLinearHashTable *table,
+	double max_load);
+
+#endif
@@ -8,21 +8,55 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <time.h>
 
 #include "cuckoo.h"
+#include "seqlock.h"
+
+// a free slot holds this key. since it can't mark a slot holding itself, the
+// key EMPTY is kept in a slot of its own, outside of the inner tables
+#define EMPTY 0
+
+// the most keys a single insertion may move to make room for a new key. if
+// there's no path of moves this short, the key goes in the stash instead
+#define MAX_PATH 64
+
+// how many keys the stash can hold. the table only grows when a key finds no
+// room in the inner tables and the stash is full as well
+#define STASH_SIZE 4
+
+// when the table grows, its keys move across to the new inner tables a few
+// at a time: each insertion or deletion moves this many old positions (from
+// both inner tables)
+#define MIGRATE_POSITIONS 2
+
+// a slot holds a key and the value it maps to, side by side
+typedef struct slot {
+	int64 key;
+	int64 value;
+} Slot;
 
 // an inner table represents one of the two internal tables for a cuckoo
-// hash table. it stores two parallel arrays: 'slots' for storing keys and
-// 'inuse' for marking which entries are occupied
+// hash table. it stores an array of slots, each holding a key and its value,
+// where a slot is in use unless its key is EMPTY
 typedef struct inner_table {
-	int64 *slots;	// array of slots holding keys
-	bool  *inuse;	// is this slot in use or not?
+	Slot  *slots;	// array of slots holding keys and values
 } InnerTable;
 
+// a step on a path of moves: a slot in one of the inner tables, and the step
+// before it, whose key would move into this slot to make room
+typedef struct step {
+	int t;		// which inner table (1 or 2)
+	int pos;	// position of the slot in that table
+	int parent;	// index of the step before this one, or -1 for the first
+} Step;
+
 typedef struct stats {
 	int time;
+	int moves;	// total keys moved to make room for other keys
+	int failed;	// insertions that found no path or stash space, and grew
 } Stats;
 
 // a cuckoo hash table stores its keys in two inner tables
@@ -30,31 +64,41 @@ struct cuckoo_table {
 	InnerTable *table1; // first table
 	InnerTable *table2; // second table
 	int size;			// size of each table
-	int load;			// number of keys
+	int load;			// number of keys in the inner tables
+	bool has_zero;		// is the key EMPTY in the table?
+	Slot zero;			// the slot holding the key EMPTY, if it's in the table
+	Slot stash[STASH_SIZE];	// keys that found no room in the inner tables
+	int nstash;			// number of keys in the stash
+	InnerTable *old1;	// the previous first table, or NULL if not growing
+	InnerTable *old2;	// the previous second table
+	int oldsize;		// size of each previous table
+	int moved;			// how many positions of them have been moved so far
 	Stats stats;
 };
 
 /******************************* HELP FUNCTION *******************************/
 static void initialise_inner_table(InnerTable *table, int size);
 static void initialise_cuckoo_table(CuckooHashTable *table, int size);
+static void resize_table(CuckooHashTable *table, int size);
 static void double_table(CuckooHashTable *table);
+static void migrate(CuckooHashTable *table, int npositions);
 void free_inner_table(InnerTable *table);
-bool cuckoo_rehash_1(CuckooHashTable *table, int64 key, int64 record);
-bool cuckoo_rehash_2(CuckooHashTable *table, int64 key, int64 record);
+static Slot *slot_at(CuckooHashTable *table, int t, int pos);
+static int plan_path(CuckooHashTable *table, int64 key, Step *path);
+static void follow_path(CuckooHashTable *table, Step *path, int end,
+	int64 key, int64 value);
+static Slot *find_slot_at(CuckooHashTable *table, int64 key, int ht1, int ht2);
+static Slot *find_slot(CuckooHashTable *table, int64 key);
+static bool place_key(CuckooHashTable *table, int64 key, int64 value);
+static void insert_new(CuckooHashTable *table, int64 key, int64 value);
 /****************************************************************************/
 
 // initialise a inner table with 'size' slots
 static void initialise_inner_table(InnerTable *table, int size) {
 	assert(table);
-	table->slots = malloc((sizeof *table->slots) * size);
+	// zeroed memory is an array of free slots
+	table->slots = calloc(size, sizeof *table->slots);
 	assert(table->slots);
-	table->inuse = malloc((sizeof *table->inuse) * size);
-	assert(table->inuse);
-
-	int i;
-	for (i=0; i<size; i++) {
-		table->inuse[i] = false;
-	}
 }
 
 // initialise a cuckoo hash table with 'size' slots
@@ -63,9 +107,6 @@ static void initialise_cuckoo_table(CuckooHashTable *table, int size) {
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
 	table->size = size;
-	table->load = 0;
-
-	table->stats.time = 0;
 
 	table->table1 = malloc(sizeof *table->table1);
 	assert(table->table1);
@@ -76,36 +117,99 @@ static void initialise_cuckoo_table(CuckooHashTable *table, int size) {
 	initialise_inner_table(table->table2, size);
 }
 
-// double size of the cuckoo hash table
-static void double_table(CuckooHashTable *table) {
-	int oldsize = table->size;
-	int newsize = oldsize * 2;
+// resize the cuckoo hash table to 'newsize' slots per inner table. rather
+// than reinsert all the keys right away, they move across bit by bit as the
+// table is used
+static void resize_table(CuckooHashTable *table, int newsize) {
 	assert(newsize < MAX_TABLE_SIZE && "error: table has grown too large!");
 
-	int64 *oldslots1 = table->table1->slots;
-	int64 *oldslots2 = table->table2->slots;
-	bool *oldinuse1 = table->table1->inuse;
-	bool *oldinuse2 = table->table2->inuse;
+	// readers must not see the tables and their size half swapped (or follow
+	// the previous tables as they're freed)
+	write_barrier();
+
+	// if the table is growing again before all keys moved across last time,
+	// take the tables they're in out of the way (those keys can go straight
+	// into the new tables, which have more room than the current ones)
+	InnerTable *prev1 = table->old1;
+	InnerTable *prev2 = table->old2;
+	int prevsize = table->oldsize;
+	int prevmoved = table->moved;
+
+	table->old1 = table->table1;
+	table->old2 = table->table2;
+	table->oldsize = table->size;
+	table->moved = 0;
+	initialise_cuckoo_table(table, newsize);
 
-	free(table->table1);
-	free(table->table2);
+	// the stashed keys may well fit in the bigger tables
+	Slot oldstash[STASH_SIZE];
+	int oldnstash = table->nstash;
+	memcpy(oldstash, table->stash, sizeof oldstash);
+	table->nstash = 0;
+	int i;
+	for (i=0; i<oldnstash; i++) {
+		insert_new(table, oldstash[i].key, oldstash[i].value);
+	}
 
-	initialise_cuckoo_table(table, newsize);
-	// after initialise the cuckoo table with double size
-	// reinsert all the values in new cuckoo table
+	if (prev1) {
+		for (i=prevmoved; i<prevsize; i++) {
+			if (prev1->slots[i].key != EMPTY) {
+				table->load--;
+				insert_new(table, prev1->slots[i].key, prev1->slots[i].value);
+			}
+			if (prev2->slots[i].key != EMPTY) {
+				table->load--;
+				insert_new(table, prev2->slots[i].key, prev2->slots[i].value);
+			}
+		}
+		free_inner_table(prev1);
+		free_inner_table(prev2);
+	}
+}
+
+// move the keys at (up to) 'npositions' positions of the previous inner
+// tables across to the current ones
+static void migrate(CuckooHashTable *table, int npositions) {
 	int i;
-	for (i=0; i<oldsize; i++) {
-		if (oldinuse1[i]) {
-			cuckoo_hash_table_insert(table, oldslots1[i]);
+	for (i=0; i<npositions && table->old1; i++) {
+		// take the keys out of the previous tables before reinserting them,
+		// since that could grow the table again and replace them
+		int pos = table->moved++;
+		Slot slot1 = table->old1->slots[pos];
+		Slot slot2 = table->old2->slots[pos];
+		table->old1->slots[pos].key = EMPTY;
+		table->old2->slots[pos].key = EMPTY;
+		table->load -= (slot1.key != EMPTY) + (slot2.key != EMPTY);
+
+		// all done? then the previous tables are no longer needed
+		if (table->moved == table->oldsize) {
+			write_barrier();
+			free_inner_table(table->old1);
+			free_inner_table(table->old2);
+			table->old1 = table->old2 = NULL;
+		}
+
+		if (slot1.key != EMPTY) {
+			insert_new(table, slot1.key, slot1.value);
 		}
-		if (oldinuse2[i]) {
-			cuckoo_hash_table_insert(table, oldslots2[i]);
+		if (slot2.key != EMPTY) {
+			insert_new(table, slot2.key, slot2.value);
 		}
 	}
-	free(oldslots1);
-	free(oldslots2);
-	free(oldinuse1);
-	free(oldinuse2);
+}
+
+// resize the cuckoo hash table to 'newsize' slots per inner table and move
+// all the keys across right away
+static void rehash_table(CuckooHashTable *table, int newsize) {
+	resize_table(table, newsize);
+	while (table->old1) {
+		migrate(table, table->oldsize - table->moved);
+	}
+}
+
+// double size of the cuckoo hash table
+static void double_table(CuckooHashTable *table) {
+	resize_table(table, table->size * 2);
 }
 
 // initialise a cuckoo hash table
@@ -116,6 +220,13 @@ CuckooHashTable *new_cuckoo_hash_table(int size) {
 	assert(table);
 
 	initialise_cuckoo_table(table, size);
+	table->load = 0;
+	table->nstash = 0;
+	table->old1 = table->old2 = NULL;
+	table->has_zero = false;
+	table->stats.time = 0;
+	table->stats.moves = 0;
+	table->stats.failed = 0;
 	return table;
 }
 
@@ -125,7 +236,6 @@ CuckooHashTable *new_cuckoo_hash_table(int size) {
 void free_inner_table(InnerTable *table) {
 	assert(table);
 	free(table->slots);
-	free(table->inuse);
 	free(table);
 }
 
@@ -134,81 +244,223 @@ void free_cuckoo_hash_table(CuckooHashTable *table) {
 	assert(table);
 	free_inner_table(table->table1);
 	free_inner_table(table->table2);
+	if (table->old1) {
+		free_inner_table(table->old1);
+		free_inner_table(table->old2);
+	}
 	free(table);
 }
 
 /****************************************************************************/
 
-// rehash the key in table 1
-bool cuckoo_rehash_1(CuckooHashTable *table, int64 key, int64 record) {
+// the slot at position 'pos' of inner table 't'
+static Slot *slot_at(CuckooHashTable *table, int t, int pos) {
+	if (t == 1) {
+		return &table->table1->slots[pos];
+	}
+	return &table->table2->slots[pos];
+}
 
-	int ht1 = h1(key) % table->size;
-	int64 old_key;
+// search breadth-first for the shortest path of moves that frees one of the
+// two slots 'key' can go in, without moving any keys yet. every full slot
+// leads to just one other slot (where its key would move to), so this walks
+// the two chains starting from 'key's slots side by side
+// returns the index of the step in 'path' ending at a free slot, or -1 if
+// neither chain reaches one within MAX_PATH moves
+static int plan_path(CuckooHashTable *table, int64 key, Step *path) {
+	path[0] = (Step){1, hash_to_range(h1_64(key), table->size), -1};
+	path[1] = (Step){2, hash_to_range(h2_64(key), table->size), -1};
+	int nsteps = 2;
 
-	if (!table->table1->inuse[ht1]) {
-		// if not inuse
-		table->table1->slots[ht1] = key;
-		table->table1->inuse[ht1] = true;
-		return true;
-	} else {
-		// if already inuse
-		// replace the old key in ht1 position with the inserted key
-		old_key = table->table1->slots[ht1];
-		table->table1->slots[ht1] = key;
-		// rehash the old key in table 2
-		return cuckoo_rehash_2(table, old_key, record);
+	int i;
+	for (i = 0; i < nsteps; i++) {
+		Slot *slot = slot_at(table, path[i].t, path[i].pos);
+		if (slot->key == EMPTY) {
+			return i;
+		}
+
+		// the key in this slot would have to move to its other table
+		if (nsteps < 2 * (MAX_PATH + 1)) {
+			int t = 3 - path[i].t;
+			int64 hash = t == 1 ? h1_64(slot->key) : h2_64(slot->key);
+			path[nsteps++] = (Step){t, hash_to_range(hash, table->size), i};
+		}
 	}
+	return -1;
 }
 
-// rehahs the key in table 2
-bool cuckoo_rehash_2(CuckooHashTable *table, int64 key, int64 record) {
-	if (key == record) {
-		// infinite loop
-		// once the original key occurs in rehash function of table 2
-		return false;
+// make room by moving each key on the path ending at 'path[end]' one step
+// along (starting from the free end), then put 'key' in the slot this frees
+// at the start of the path
+static void follow_path(CuckooHashTable *table, Step *path, int end,
+	int64 key, int64 value) {
+	int i;
+	for (i = end; path[i].parent >= 0; i = path[i].parent) {
+		Step *prev = &path[path[i].parent];
+		*slot_at(table, path[i].t, path[i].pos) =
+			*slot_at(table, prev->t, prev->pos);
+		table->stats.moves++;
 	}
-	int ht2 = h2(key) % table->size;
-	int64 old_key;
+	Slot *slot = slot_at(table, path[i].t, path[i].pos);
+	slot->key = key;
+	slot->value = value;
+}
 
-	if (!table->table2->inuse[ht2]) {
-		// if not use
-		table->table2->slots[ht2] = key;
-		table->table2->inuse[ht2] = true;
+// put 'key' (which must not be in 'table' already, and isn't EMPTY) with
+// value 'value' into the inner tables, moving other keys along to make room,
+// or failing that into the stash. never grows the table
+// returns true on success, false (having moved nothing) if there's no room
+static bool place_key(CuckooHashTable *table, int64 key, int64 value) {
+	// find a way to make room before moving anything
+	Step path[2 * (MAX_PATH + 1)];
+	int end = plan_path(table, key, path);
+	if (end >= 0) {
+		follow_path(table, path, end, key, value);
+		table->load++;
 		return true;
-	} else {
-		// if already use
-		// replace the old key in ht2 position with the inserted key
-		old_key = table->table2->slots[ht2];
-		table->table2->slots[ht2] = key;
-		// rehash the old key in table 1
-		return cuckoo_rehash_1(table, old_key, record);
-	}	
+	}
+	if (table->nstash < STASH_SIZE) {
+		table->stash[table->nstash].key = key;
+		table->stash[table->nstash].value = value;
+		table->nstash++;
+		return true;
+	}
+	return false;
+}
+
+// insert 'key' (which must not be in 'table' already) with value 'value'
+static void insert_new(CuckooHashTable *table, int64 key, int64 value) {
+	// the key EMPTY has a slot of its own
+	if (key == EMPTY) {
+		table->has_zero = true;
+		table->zero.key = EMPTY;
+		table->zero.value = value;
+		return;
+	}
+
+	// if there's no room even in the stash, grow the table and try again
+	while (!place_key(table, key, value)) {
+		table->stats.failed++;
+		double_table(table);
+	}
+}
+
+// find the slot holding 'key' in 'table', given its positions 'ht1' and
+// 'ht2' in the two inner tables, or NULL if it's not in there
+static Slot *find_slot_at(CuckooHashTable *table, int64 key, int ht1, int ht2) {
+	// the key EMPTY has a slot of its own (and would match any free slot)
+	if (key == EMPTY) {
+		return table->has_zero ? &table->zero : NULL;
+	}
+
+	// key occurs only in the corresponding ht1 & ht2 position
+	if (table->table1->slots[ht1].key == key) {
+		return &table->table1->slots[ht1];
+	}
+	if (table->table2->slots[ht2].key == key) {
+		return &table->table2->slots[ht2];
+	}
+
+	// unless it's one of the few keys that found no room there
+	int i;
+	for (i = 0; i < table->nstash; i++) {
+		if (table->stash[i].key == key) {
+			return &table->stash[i];
+		}
+	}
+
+	// or one that hasn't moved across since the table grew
+	if (table->old1) {
+		int old1 = hash_to_range(h1_64(key), table->oldsize);
+		if (table->old1->slots[old1].key == key) {
+			return &table->old1->slots[old1];
+		}
+		int old2 = hash_to_range(h2_64(key), table->oldsize);
+		if (table->old2->slots[old2].key == key) {
+			return &table->old2->slots[old2];
+		}
+	}
+	return NULL;
+}
+
+// find the slot holding 'key' in 'table', or NULL if it's not in there
+static Slot *find_slot(CuckooHashTable *table, int64 key) {
+	int ht1 = hash_to_range(h1_64(key), table->size);
+	int ht2 = hash_to_range(h2_64(key), table->size);
+	return find_slot_at(table, key, ht1, ht2);
 }
 
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
 	assert(table);
-	int start_time = clock();
+	int start_time = timer_start();
 
-	if (cuckoo_hash_table_lookup(table, key)) {
-		// check if it is in table
-		table->stats.time += clock() - start_time;
-		return false;
+	// if the table is still growing, move a few more keys across first
+	migrate(table, MIGRATE_POSITIONS);
+
+	// check if it is in table
+	bool inserted = !find_slot(table, key);
+	if (inserted) {
+		insert_new(table, key, 0);
 	}
-	// after lookup, the key must be inserted
-	table->load++;
 
-	if (cuckoo_rehash_1(table, key, key)) {
-		// if rehash recursion is valid
-		table->stats.time += clock() - start_time;
-		return true; 
-	} else {
-		// infinite loop occurs
-		// double the table size
-		double_table(table);
-		return cuckoo_hash_table_insert(table, key);
+	timer_add(table->stats.time, start_time);
+	return inserted;
+}
+
+// insert each of the 'n' keys in 'keys' into 'table', if it's not in there
+// already, storing whether each one was inserted in 'inserted'
+// returns how many of the keys were inserted
+int cuckoo_hash_table_insert_batch(CuckooHashTable *table, int64 *keys, int n,
+	bool *inserted) {
+	assert(table);
+	int start_time = timer_start();
+
+	// grow (at most once, moving all the keys across right away) so that the
+	// whole batch fits with the two inner tables no more than half full
+	// between them. cycles can still force a doubling later on, but far less
+	// often than growing from a small table
+	int size = table->size;
+	while (table->load + n > size) {
+		size *= 2;
+	}
+	if (size != table->size) {
+		rehash_table(table, size);
+	}
+
+	int ht1[BATCH_GROUP], ht2[BATCH_GROUP];
+	int count = 0;
+	int i, j;
+	for (i = 0; i < n; i += BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// hash the whole group and prefetch both candidate positions of every
+		// key, as for 'cuckoo_hash_table_lookup_batch()'
+		size = table->size;
+		for (j = 0; j < group; j++) {
+			ht1[j] = hash_to_range(h1_64(keys[i + j]), size);
+			ht2[j] = hash_to_range(h2_64(keys[i + j]), size);
+			prefetch(&table->table1->slots[ht1[j]]);
+			prefetch(&table->table2->slots[ht2[j]]);
+		}
+		for (j = 0; j < group; j++) {
+			migrate(table, MIGRATE_POSITIONS);
+
+			// (an insertion may have doubled the table, moving every key)
+			Slot *slot = table->size == size
+				? find_slot_at(table, keys[i + j], ht1[j], ht2[j])
+				: find_slot(table, keys[i + j]);
+			inserted[i + j] = slot == NULL;
+			if (inserted[i + j]) {
+				insert_new(table, keys[i + j], 0);
+				count++;
+			}
+		}
 	}
+
+	timer_add(table->stats.time, start_time);
+	return count;
 }
 
 /****************************************************************************/
@@ -216,19 +468,152 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
 // returns true if found, false if not
 bool cuckoo_hash_table_lookup(CuckooHashTable *table, int64 key) {
 	assert(table);
-	int start_time = clock();
-	bool found = false;
+	return find_slot(table, key) != NULL;
+}
 
-	int ht1 = h1(key) % table->size;
-	int ht2 = h2(key) % table->size;
-	// key occurs only in the corresponding ht1 & ht2 position
-	if (table->table1->slots[ht1] == key || table->table2->slots[ht2] == key) {
-		found = true;
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int cuckoo_hash_table_lookup_batch(CuckooHashTable *table, int64 *keys, int n,
+	bool *results) {
+	assert(table);
+
+	int ht1[BATCH_GROUP], ht2[BATCH_GROUP];
+	int found = 0;
+	int i, j;
+	for (i = 0; i < n; i += BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// hash the whole group and prefetch both candidate positions of every
+		// key, so that the probes below don't wait on memory one at a time
+		for (j = 0; j < group; j++) {
+			ht1[j] = hash_to_range(h1_64(keys[i + j]), table->size);
+			ht2[j] = hash_to_range(h2_64(keys[i + j]), table->size);
+			prefetch(&table->table1->slots[ht1[j]]);
+			prefetch(&table->table2->slots[ht2[j]]);
+		}
+		for (j = 0; j < group; j++) {
+			results[i + j] = find_slot_at(table, keys[i + j], ht1[j], ht2[j])
+				!= NULL;
+			found += results[i + j];
+		}
 	}
-	table->stats.time += clock() - start_time;
 	return found;
 }
 
+/****************************************************************************/
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool cuckoo_hash_table_put(CuckooHashTable *table, int64 key, int64 value) {
+	assert(table);
+
+	// if the table is still growing, move a few more keys across first
+	migrate(table, MIGRATE_POSITIONS);
+
+	Slot *slot = find_slot(table, key);
+	if (slot) {
+		slot->value = value;
+		return false;
+	}
+	insert_new(table, key, value);
+	return true;
+}
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool cuckoo_hash_table_get(CuckooHashTable *table, int64 key, int64 *value) {
+	assert(table);
+
+	Slot *slot = find_slot(table, key);
+	if (slot && value) {
+		*value = slot->value;
+	}
+	return slot != NULL;
+}
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool cuckoo_hash_table_get_or_insert(CuckooHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table);
+
+	// if the table is still growing, move a few more keys across first
+	migrate(table, MIGRATE_POSITIONS);
+
+	Slot *slot = find_slot(table, key);
+	if (slot) {
+		value = slot->value;
+	} else {
+		insert_new(table, key, value);
+	}
+	if (result) {
+		*result = value;
+	}
+	return slot == NULL;
+}
+
+/****************************************************************************/
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool cuckoo_hash_table_delete(CuckooHashTable *table, int64 key) {
+	assert(table);
+
+	// if the table is still growing, move a few more keys across first
+	migrate(table, MIGRATE_POSITIONS);
+
+	// the key EMPTY has a slot of its own
+	if (key == EMPTY) {
+		bool found = table->has_zero;
+		table->has_zero = false;
+		return found;
+	}
+
+	// key occurs only in the corresponding ht1 & ht2 position, and no other
+	// key depends on its slot, so we can just free the slot
+	int ht1 = hash_to_range(h1_64(key), table->size);
+	if (table->table1->slots[ht1].key == key) {
+		table->table1->slots[ht1].key = EMPTY;
+		table->load--;
+		return true;
+	}
+	int ht2 = hash_to_range(h2_64(key), table->size);
+	if (table->table2->slots[ht2].key == key) {
+		table->table2->slots[ht2].key = EMPTY;
+		table->load--;
+		return true;
+	}
+
+	// it might not have moved across since the table grew
+	if (table->old1) {
+		int old1 = hash_to_range(h1_64(key), table->oldsize);
+		if (table->old1->slots[old1].key == key) {
+			table->old1->slots[old1].key = EMPTY;
+			table->load--;
+			return true;
+		}
+		int old2 = hash_to_range(h2_64(key), table->oldsize);
+		if (table->old2->slots[old2].key == key) {
+			table->old2->slots[old2].key = EMPTY;
+			table->load--;
+			return true;
+		}
+	}
+
+	// the stash isn't ordered, so its last key can fill the gap
+	int i;
+	for (i = 0; i < table->nstash; i++) {
+		if (table->stash[i].key == key) {
+			table->nstash--;
+			table->stash[i] = table->stash[table->nstash];
+			return true;
+		}
+	}
+	return false;
+}
+
 /****************************************************************************/
 // print the contents of 'table' to stdout
 void cuckoo_hash_table_print(CuckooHashTable *table) {
@@ -244,8 +629,8 @@ void cuckoo_hash_table_print(CuckooHashTable *table) {
 	for (i = 0; i < table->size; i++) {
 
 		// table 1 key
-		if (table->table1->inuse[i]) {
-			printf(" %20llu ", table->table1->slots[i]);
+		if (table->table1->slots[i].key != EMPTY) {
+			printf(" %20llu ", table->table1->slots[i].key);
 		} else {
 			printf(" %20s ", "-");
 		}
@@ -254,13 +639,31 @@ void cuckoo_hash_table_print(CuckooHashTable *table) {
 		printf("| %-9d %9d |", i, i);
 
 		// table 2 key
-		if (table->table2->inuse[i]) {
-			printf(" %llu\n", table->table2->slots[i]);
+		if (table->table2->slots[i].key != EMPTY) {
+			printf(" %llu\n", table->table2->slots[i].key);
 		} else {
 			printf(" %s\n",  "-");
 		}
 	}
 
+	// the key EMPTY and the stash live outside of the inner tables
+	if (table->has_zero) {
+		printf(" %20llu | (held separately)\n", table->zero.key);
+	}
+	for (i = 0; i < table->nstash; i++) {
+		printf(" %20llu | (stashed)\n", table->stash[i].key);
+	}
+
+	// as do keys which haven't moved across since the table grew
+	for (i = 0; table->old1 && i < table->oldsize; i++) {
+		if (table->old1->slots[i].key != EMPTY) {
+			printf(" %20llu | (not yet moved)\n", table->old1->slots[i].key);
+		}
+		if (table->old2->slots[i].key != EMPTY) {
+			printf(" %20llu | (not yet moved)\n", table->old2->slots[i].key);
+		}
+	}
+
 	// done!
 	printf("--- end table ---\n");
 }
@@ -271,9 +674,28 @@ void cuckoo_hash_table_stats(CuckooHashTable *table) {
 	assert(table);
 	printf("--- table stats ---\n");
 	printf("current size: %d * 2 slots\n", table->size);
-	printf("current load: %d items\n", table->load);
+	printf("current load: %d items\n",
+		table->load + table->nstash + table->has_zero);
 	printf(" load factor: %.3f%%\n", table->load * 100.0 / (table->size * 2));
+	printf("     stashed: %d of %d items\n", table->nstash, STASH_SIZE);
+	if (table->old1) {
+		printf("   migrating: %d of %d old positions left\n",
+			table->oldsize - table->moved, table->oldsize);
+	}
+	printf("  keys moved: %d\n", table->stats.moves);
+	printf("failed paths: %d\n", table->stats.failed);
+#ifdef TABLE_TIMING
 	float seconds = table->stats.time * 1.0 / CLOCKS_PER_SEC;
 	printf("    CPU time spent: %.6f sec\n", seconds);
+#else
+	printf("    CPU time spent: not timed (build with -DTABLE_TIMING)\n");
+#endif
 	printf("--- end stats ---\n");
 }
+
+/****************************************************************************/
+// return how many keys 'table' has space for without growing
+int cuckoo_hash_table_capacity(CuckooHashTable *table) {
+	assert(table);
+	return table->size * 2;
+}
@@ -24,14 +24,51 @@ void free_cuckoo_hash_table(CuckooHashTable *table);
 // returns true if insertion succeeds, false if it was already in there
 bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key);
 
+// insert each of the 'n' keys in 'keys' into 'table', if it's not in there
+// already, storing whether each one was inserted in 'inserted'. the table is
+// grown at most once, up front, to fit the whole batch
+// returns how many of the keys were inserted
+int cuckoo_hash_table_insert_batch(CuckooHashTable *table, int64 *keys, int n,
+	bool *inserted);
+
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool cuckoo_hash_table_lookup(CuckooHashTable *table, int64 key);
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'. keys are hashed in groups, and the memory they
+// will probe is prefetched before any of them are probed
+// returns how many of the keys were found
+int cuckoo_hash_table_lookup_batch(CuckooHashTable *table, int64 *keys, int n,
+	bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool cuckoo_hash_table_put(CuckooHashTable *table, int64 key, int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool cuckoo_hash_table_get(CuckooHashTable *table, int64 key, int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool cuckoo_hash_table_get_or_insert(CuckooHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool cuckoo_hash_table_delete(CuckooHashTable *table, int64 key);
+
 // print the contents of 'table' to stdout
 void cuckoo_hash_table_print(CuckooHashTable *table);
 
 // print some statistics about 'table' to stdout
 void cuckoo_hash_table_stats(CuckooHashTable *table);
 
+// return how many keys 'table' has space for without growing
+int cuckoo_hash_table_capacity(CuckooHashTable *table);
+
 #endif
@@ -0,0 +1,628 @@
+/* * * * * * * * *
+ * Dynamic hash table using extendible hashing with multiple keys per bucket,
+ * which any number of threads may insert into, look up and delete from at
+ * once: each bucket has a lock of its own, and the directory is replaced in
+ * one step whenever it doubles
+ *
+ * threads changing a bucket lock just that bucket, so changes to different
+ * buckets (splits included) happen in parallel. a split builds the new bucket
+ * before anyone can see it, then points the directory entries at it while
+ * the old bucket is marked as changing. doubling the directory copies it into
+ * a new one and swaps the table over to that, holding off splits only while
+ * it copies. lookups take no locks: they note a bucket's version, read it,
+ * and read again if the bucket changed (or turns out not to be the one for
+ * their key, having been split since the directory was read)
+ *
+ * buckets are never merged, and replaced directories are kept until the
+ * table is freed (a lookup may still be reading one), so nothing a thread
+ * might be looking at is ever freed
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#define _POSIX_C_SOURCE 200112L // for posix_memalign
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sched.h>
+
+#include "cxtndbln.h"
+#include "spinlock.h"
+
+#define CACHE_LINE 64
+
+// threads spread the count of keys across this many cache lines, so that
+// they don't all fight over one
+#define SHARDS 16
+
+// macro to calculate the rightmost n bits of a number x
+#define rightmostnbits(n, x) ((x) & ((1 << (n)) - 1))
+
+// an entry is a key stored in a bucket, along with the value it maps to
+typedef struct entry {
+	int64 key;
+	int64 value;
+} Entry;
+
+// a bucket stores an array of entries inline, along with the lock threads
+// changing it hold, and a version for lookups to check their reads against
+typedef struct cxtndbln_bucket {
+	SpinLock lock;		// held by any thread changing the bucket
+	unsigned version;	// goes up by one at the start and end of each change,
+						// so it's odd while a change is in progress
+	int id;				// the first address in the directory which points to
+						// this bucket (the bits its keys' hash values end in)
+	int depth;			// how many hash value bits are being used by this
+						// bucket
+	int nkeys;			// number of keys currently contained in this bucket
+	Entry entries[];	// the keys (and values) stored in this bucket
+} Bucket;
+
+// a directory is an array of 2^depth bucket pointers. it never grows in place:
+// doubling makes a new one
+typedef struct directory Directory;
+struct directory {
+	int depth;			// how many bits of the hash value to use
+	int size;			// how many entries (2^depth)
+	int writers;		// splits part way through changing entries
+	bool sealed;		// set when the directory is about to be replaced, so
+						// that splits wait for the new one
+	Directory *older;	// the directory this one replaced, if any
+	Bucket *buckets[];	// the bucket for each address
+};
+
+// a count spread across shards (see SHARDS), each on its own cache line
+// the code was sourced from "clinear.c"
+typedef struct counter {
+	long count;
+	char padding[CACHE_LINE - sizeof (long)];
+} Counter;
+
+// a concurrent extendible table is the current directory, plus what it needs
+// to keep track of the buckets the directory points to
+struct cxtndbln_table {
+	Counter nkeys[SHARDS];	// keys in the table, by shard
+	Directory *dir;			// the current directory
+	SpinLock doubling;		// held while replacing the directory
+	int bucketsize;			// maximum number of keys per bucket
+	int nbuckets;			// how many distinct buckets there are
+};
+
+// the ways update_key() can change a key
+typedef enum update {
+	INSERT, PUT, GET_OR_INSERT, DELETE
+} Update;
+
+
+/* * * *
+ * helper functions
+ */
+
+// the shard this thread counts in (-1 until it first needs one)
+static __thread int shard = -1;
+
+// how many threads have picked a shard so far
+static int nthreads = 0;
+
+// the shard the calling thread counts in
+// the code was sourced from "clinear.c"
+static int my_shard(void) {
+	if (shard < 0) {
+		shard = __atomic_fetch_add(&nthreads, 1, __ATOMIC_RELAXED) % SHARDS;
+	}
+	return shard;
+}
+
+// create a new, empty bucket with room for 'bucketsize' entries
+static Bucket *new_bucket(int bucketsize, int id, int depth) {
+	Bucket *bucket = malloc(sizeof *bucket + (sizeof (Entry)) * bucketsize);
+	assert(bucket);
+
+	spin_init(&bucket->lock);
+	bucket->version = 0;
+	bucket->id = id;
+	bucket->depth = depth;
+	bucket->nkeys = 0;
+
+	return bucket;
+}
+
+// create a new directory using 'depth' bits, its entries left for the caller
+// to fill in
+static Directory *new_directory(int depth) {
+	int size = 1 << depth;
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+
+	Directory *dir = malloc(sizeof *dir + (sizeof (Bucket *)) * size);
+	assert(dir);
+	dir->depth = depth;
+	dir->size = size;
+	dir->writers = 0;
+	dir->sealed = false;
+	dir->older = NULL;
+
+	return dir;
+}
+
+// the table's current directory
+static Directory *current_directory(CXtndblNHashTable *table) {
+	return __atomic_load_n(&table->dir, __ATOMIC_ACQUIRE);
+}
+
+// find the bucket that keys with hash value 'hash' belong in, going by the
+// current directory (the bucket may have split since, see covers())
+static Bucket *hash_bucket(CXtndblNHashTable *table, int64 hash) {
+	Directory *dir = current_directory(table);
+	return __atomic_load_n(&dir->buckets[rightmostnbits(dir->depth, hash)],
+		__ATOMIC_ACQUIRE);
+}
+
+// is 'bucket' (still) the bucket keys with hash value 'hash' belong in
+static bool covers(Bucket *bucket, int64 hash) {
+	int depth = __atomic_load_n(&bucket->depth, __ATOMIC_RELAXED);
+	return rightmostnbits(depth, hash) == (int64)bucket->id;
+}
+
+// find where 'key' is in 'bucket'
+// returns its index, or -1 if it's not in there
+static int find_in(Bucket *bucket, int64 key) {
+	int nkeys = __atomic_load_n(&bucket->nkeys, __ATOMIC_RELAXED);
+	int i;
+	for (i=0; i<nkeys; i++) {
+		if (__atomic_load_n(&bucket->entries[i].key, __ATOMIC_RELAXED) == key) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// begin changing 'bucket' (which the calling thread has locked), so that
+// lookups reading it meanwhile know to read it again
+static void begin_change(Bucket *bucket) {
+	__atomic_store_n(&bucket->version, bucket->version + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// finish a change begun with begin_change()
+static void end_change(Bucket *bucket) {
+	__atomic_store_n(&bucket->version, bucket->version + 1, __ATOMIC_RELEASE);
+}
+
+// store 'key' and 'value' as entry 'i' of 'bucket' (between begin_change()
+// and end_change())
+static void set_entry(Bucket *bucket, int i, int64 key, int64 value) {
+	__atomic_store_n(&bucket->entries[i].key, key, __ATOMIC_RELAXED);
+	__atomic_store_n(&bucket->entries[i].value, value, __ATOMIC_RELAXED);
+}
+
+// lock the bucket that keys with hash value 'hash' belong in, and return it
+static Bucket *lock_bucket(CXtndblNHashTable *table, int64 hash) {
+	while (true) {
+		Bucket *bucket = hash_bucket(table, hash);
+		spin_lock(&bucket->lock);
+
+		// (it may have split while we were waiting)
+		if (covers(bucket, hash)) {
+			return bucket;
+		}
+		spin_unlock(&bucket->lock);
+	}
+}
+
+// replace the table's directory with one of twice the size, unless another
+// thread already has since the directory used 'depth' bits
+static void double_directory(CXtndblNHashTable *table, int depth) {
+	spin_lock(&table->doubling);
+
+	Directory *dir = current_directory(table);
+	if (dir->depth == depth) {
+		// keep splits from changing the entries while they're copied. (the
+		// split counts itself in before checking 'sealed', and we set it
+		// before checking the count, so one of us always sees the other)
+		__atomic_store_n(&dir->sealed, true, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&dir->writers, __ATOMIC_SEQ_CST)) {
+			sched_yield();
+		}
+
+		// each new entry is a copy of the entry sharing its lower bits
+		Directory *bigger = new_directory(depth + 1);
+		int i;
+		for (i=0; i<dir->size; i++) {
+			Bucket *bucket = __atomic_load_n(&dir->buckets[i],
+				__ATOMIC_RELAXED);
+			bigger->buckets[i] = bucket;
+			bigger->buckets[i + dir->size] = bucket;
+		}
+		bigger->older = dir;
+		__atomic_store_n(&table->dir, bigger, __ATOMIC_RELEASE);
+	}
+
+	spin_unlock(&table->doubling);
+}
+
+// get the current directory for changing its entries, waiting out any
+// doubling in progress. pass it to leave_directory() afterwards
+static Directory *enter_directory(CXtndblNHashTable *table) {
+	while (true) {
+		Directory *dir = __atomic_load_n(&table->dir, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&dir->writers, 1, __ATOMIC_SEQ_CST);
+		if (!__atomic_load_n(&dir->sealed, __ATOMIC_SEQ_CST)) {
+			return dir;
+		}
+		__atomic_sub_fetch(&dir->writers, 1, __ATOMIC_RELEASE);
+		while (__atomic_load_n(&table->dir, __ATOMIC_ACQUIRE) == dir) {
+			sched_yield();
+		}
+	}
+}
+
+// finish changing the entries of 'dir'
+static void leave_directory(Directory *dir) {
+	__atomic_sub_fetch(&dir->writers, 1, __ATOMIC_RELEASE);
+}
+
+// split 'bucket' (which the calling thread has locked) in two, using one
+// more hash value bit, doubling the directory first if it has too few bits
+static void split_bucket(CXtndblNHashTable *table, Bucket *bucket) {
+	int depth = bucket->depth;
+	if (current_directory(table)->depth == depth) {
+		double_directory(table, depth);
+	}
+
+	// fill the new bucket with the keys that move to it, before any other
+	// thread can see it
+	int new_depth = depth + 1;
+	int new_id = 1 << depth | bucket->id;
+	Bucket *newbucket = new_bucket(table->bucketsize, new_id, new_depth);
+	__atomic_add_fetch(&table->nbuckets, 1, __ATOMIC_RELAXED);
+	int i;
+	for (i=0; i<bucket->nkeys; i++) {
+		Entry entry = bucket->entries[i];
+		if (rightmostnbits(new_depth, h1_64(entry.key)) == (int64)new_id) {
+			newbucket->entries[newbucket->nkeys++] = entry;
+		}
+	}
+
+	// then point the new bucket's directory entries at it. (the directory
+	// has at least 'new_depth' bits, since it only ever grows)
+	begin_change(bucket);
+	Directory *dir = enter_directory(table);
+	int maxprefix = 1 << (dir->depth - new_depth);
+	int prefix;
+	for (prefix=0; prefix<maxprefix; prefix++) {
+		__atomic_store_n(&dir->buckets[(prefix << new_depth) | new_id],
+			newbucket, __ATOMIC_RELEASE);
+	}
+	leave_directory(dir);
+
+	// and keep the rest of the keys here
+	__atomic_store_n(&bucket->depth, new_depth, __ATOMIC_RELAXED);
+	int nkeys = 0;
+	for (i=0; i<bucket->nkeys; i++) {
+		Entry entry = bucket->entries[i];
+		if (rightmostnbits(new_depth, h1_64(entry.key)) != (int64)new_id) {
+			set_entry(bucket, nkeys++, entry.key, entry.value);
+		}
+	}
+	__atomic_store_n(&bucket->nkeys, nkeys, __ATOMIC_RELAXED);
+	end_change(bucket);
+}
+
+// make the change 'update' to 'key' in 'table', using 'value' as the new
+// value (for all but DELETE). if the key was in the table already, store its
+// value in '*old' (unless 'old' is NULL)
+// returns true if the key was newly inserted (or for DELETE, was removed),
+// false if not
+static bool update_key(CXtndblNHashTable *table, int64 key, Update update,
+	int64 value, int64 *old) {
+	int64 hash = h1_64(key);
+	Counter *nkeys = &table->nkeys[my_shard()];
+
+	while (true) {
+		Bucket *bucket = lock_bucket(table, hash);
+
+		int i = find_in(bucket, key);
+		if (i >= 0) {
+			if (old) {
+				*old = bucket->entries[i].value;
+			}
+			if (update == PUT) {
+				begin_change(bucket);
+				set_entry(bucket, i, key, value);
+				end_change(bucket);
+			} else if (update == DELETE) {
+				// fill the gap with the bucket's last key
+				begin_change(bucket);
+				Entry last = bucket->entries[bucket->nkeys - 1];
+				set_entry(bucket, i, last.key, last.value);
+				__atomic_store_n(&bucket->nkeys, bucket->nkeys - 1,
+					__ATOMIC_RELAXED);
+				end_change(bucket);
+				__atomic_sub_fetch(&nkeys->count, 1, __ATOMIC_RELAXED);
+			}
+			spin_unlock(&bucket->lock);
+			return update == DELETE;
+		}
+		if (update == DELETE) {
+			spin_unlock(&bucket->lock);
+			return false;
+		}
+
+		// a full bucket is split, after which the key may belong in either
+		// half, so start again
+		if (bucket->nkeys >= table->bucketsize) {
+			split_bucket(table, bucket);
+			spin_unlock(&bucket->lock);
+			continue;
+		}
+
+		begin_change(bucket);
+		set_entry(bucket, bucket->nkeys, key, value);
+		__atomic_store_n(&bucket->nkeys, bucket->nkeys + 1, __ATOMIC_RELAXED);
+		end_change(bucket);
+		spin_unlock(&bucket->lock);
+		__atomic_add_fetch(&nkeys->count, 1, __ATOMIC_RELAXED);
+		return true;
+	}
+}
+
+// look 'key' up in 'table', storing its value in '*value' unless 'value' is
+// NULL
+// returns true if found, false if not
+static bool find_key(CXtndblNHashTable *table, int64 key, int64 *value) {
+	int64 hash = h1_64(key);
+
+	while (true) {
+		Bucket *bucket = hash_bucket(table, hash);
+		unsigned version = __atomic_load_n(&bucket->version, __ATOMIC_ACQUIRE);
+		if (version & 1) {
+			// wait for the change in progress to finish (the thread making it
+			// holds the lock until then)
+			spin_lock(&bucket->lock);
+			spin_unlock(&bucket->lock);
+			continue;
+		}
+
+		bool covered = covers(bucket, hash);
+		int i = covered ? find_in(bucket, key) : -1;
+		int64 got = 0;
+		if (i >= 0) {
+			got = __atomic_load_n(&bucket->entries[i].value, __ATOMIC_RELAXED);
+		}
+
+		// make sure everything was read before checking the version again.
+		// if the bucket has split since the directory was read, the
+		// directory now points elsewhere
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&bucket->version, __ATOMIC_RELAXED) != version
+				|| !covered) {
+			continue;
+		}
+		if (i >= 0 && value) {
+			*value = got;
+		}
+		return i >= 0;
+	}
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a concurrent extendible hash table with 'bucketsize' keys per
+// bucket
+CXtndblNHashTable *new_cxtndbln_hash_table(int bucketsize) {
+	// align the table to a cache line, so that each count is on its own line
+	void *memory;
+	int error = posix_memalign(&memory, CACHE_LINE,
+		sizeof (CXtndblNHashTable));
+	assert(error == 0);
+	(void)error;
+	CXtndblNHashTable *table = memory;
+
+	memset(table->nkeys, 0, sizeof table->nkeys);
+	table->dir = new_directory(0);
+	table->dir->buckets[0] = new_bucket(bucketsize, 0, 0);
+	spin_init(&table->doubling);
+	table->bucketsize = bucketsize;
+	table->nbuckets = 1;
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_cxtndbln_hash_table(CXtndblNHashTable *table) {
+	assert(table);
+
+	// each bucket is freed at the last address pointing to it (the one with
+	// every higher bit set), once no later address can need it
+	Directory *dir = table->dir;
+	int i;
+	for (i=0; i<dir->size; i++) {
+		Bucket *bucket = dir->buckets[i];
+		if (i == bucket->id + dir->size - (1 << bucket->depth)) {
+			free(bucket);
+		}
+	}
+
+	// along with every directory the table has had
+	while (dir) {
+		Directory *older = dir->older;
+		free(dir);
+		dir = older;
+	}
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool cxtndbln_hash_table_insert(CXtndblNHashTable *table, int64 key) {
+	assert(table);
+	return update_key(table, key, INSERT, 0, NULL);
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool cxtndbln_hash_table_lookup(CXtndblNHashTable *table, int64 key) {
+	assert(table);
+	return find_key(table, key, NULL);
+}
+
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int cxtndbln_hash_table_lookup_batch(CXtndblNHashTable *table, int64 *keys,
+	int n, bool *results) {
+	assert(table);
+
+	int found = 0;
+	int i, j;
+	for (i=0; i<n; i+=BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// prefetch each key's directory entry (directories are never freed
+		// while the table is in use, so this one is safe to read even if it's
+		// replaced in the meantime)
+		Directory *dir = current_directory(table);
+		for (j=0; j<group; j++) {
+			prefetch(&dir->buckets[rightmostnbits(dir->depth,
+				h1_64(keys[i+j]))]);
+		}
+		for (j=0; j<group; j++) {
+			results[i+j] = find_key(table, keys[i+j], NULL);
+			found += results[i+j];
+		}
+	}
+	return found;
+}
+
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool cxtndbln_hash_table_put(CXtndblNHashTable *table, int64 key,
+	int64 value) {
+	assert(table);
+	return update_key(table, key, PUT, value, NULL);
+}
+
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool cxtndbln_hash_table_get(CXtndblNHashTable *table, int64 key,
+	int64 *value) {
+	assert(table);
+	return find_key(table, key, value);
+}
+
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool cxtndbln_hash_table_get_or_insert(CXtndblNHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table);
+
+	int64 stored = value;
+	bool inserted = update_key(table, key, GET_OR_INSERT, value, &stored);
+	if (result) {
+		*result = stored;
+	}
+	return inserted;
+}
+
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool cxtndbln_hash_table_delete(CXtndblNHashTable *table, int64 key) {
+	assert(table);
+	return update_key(table, key, DELETE, 0, NULL);
+}
+
+
+// print the contents of 'table' to stdout
+void cxtndbln_hash_table_print(CXtndblNHashTable *table) {
+	assert(table);
+	Directory *dir = table->dir;
+	printf("--- table size: %d\n", dir->size);
+
+	// print header
+	printf("  table:               buckets:\n");
+	printf("  address | bucketid   bucketid [key]\n");
+
+	// print table and buckets
+	int i, j;
+	for (i = 0; i < dir->size; i++) {
+		// table entry
+		Bucket *bucket = dir->buckets[i];
+		printf("%9d | %-9d ", i, bucket->id);
+
+		// if this is the first address at which a bucket occurs, print it now
+		if (bucket->id == i) {
+			printf("%9d ", bucket->id);
+
+			// print the bucket's contents
+			printf("[");
+			for (j = 0; j < table->bucketsize; j++) {
+				if (j < bucket->nkeys) {
+					printf(" %llu", bucket->entries[j].key);
+				} else {
+					printf(" -");
+				}
+			}
+			printf(" ]");
+		}
+		// end the line
+		printf("\n");
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void cxtndbln_hash_table_stats(CXtndblNHashTable *table) {
+	assert(table);
+	Directory *dir = current_directory(table);
+
+	long nkeys = 0;
+	int i;
+	for (i = 0; i < SHARDS; i++) {
+		nkeys += __atomic_load_n(&table->nkeys[i].count, __ATOMIC_RELAXED);
+	}
+	int nbuckets = __atomic_load_n(&table->nbuckets, __ATOMIC_RELAXED);
+
+	// (replaced directories add up to less than the current one)
+	size_t older = 0;
+	Directory *d;
+	for (d = dir->older; d; d = d->older) {
+		older += (sizeof *d) + (sizeof (Bucket *)) * d->size;
+	}
+
+	printf("--- table stats ---\n");
+	printf("current table size: %d\n", dir->size);
+	printf("    number of keys: %ld\n", nkeys);
+	printf(" number of buckets: %d\n", nbuckets);
+	printf("     bucket memory: %zu bytes\n", nbuckets
+		* (sizeof (Bucket) + (sizeof (Entry)) * table->bucketsize));
+	printf("  directory memory: %zu bytes (+%zu in replaced directories)\n",
+		(sizeof (Bucket *)) * dir->size, older);
+	printf("--- end stats ---\n");
+}
+
+
+// return how many keys 'table' has space for without growing
+int cxtndbln_hash_table_capacity(CXtndblNHashTable *table) {
+	assert(table);
+	return __atomic_load_n(&table->nbuckets, __ATOMIC_RELAXED)
+		* table->bucketsize;
+}
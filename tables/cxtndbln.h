@@ -0,0 +1,75 @@
+/* * * * * * * * *
+ * Dynamic hash table using extendible hashing with multiple keys per bucket,
+ * which any number of threads may insert into, look up and delete from at
+ * once: each bucket has a lock of its own, and the directory is replaced in
+ * one step whenever it doubles
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef CXTNDBLN_H
+#define CXTNDBLN_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+
+typedef struct cxtndbln_table CXtndblNHashTable;
+
+// initialise a concurrent extendible hash table with 'bucketsize' keys per
+// bucket
+CXtndblNHashTable *new_cxtndbln_hash_table(int bucketsize);
+
+// free all memory associated with 'table' (once no other thread is using it)
+void free_cxtndbln_hash_table(CXtndblNHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool cxtndbln_hash_table_insert(CXtndblNHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'. takes no locks, but waits while
+// the key's bucket is being changed
+// returns true if found, false if not
+bool cxtndbln_hash_table_lookup(CXtndblNHashTable *table, int64 key);
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'. keys are hashed in groups, and the directory
+// entries they will read are prefetched before any of them are looked up
+// returns how many of the keys were found
+int cxtndbln_hash_table_lookup_batch(CXtndblNHashTable *table, int64 *keys,
+	int n, bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool cxtndbln_hash_table_put(CXtndblNHashTable *table, int64 key,
+	int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool cxtndbln_hash_table_get(CXtndblNHashTable *table, int64 key,
+	int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool cxtndbln_hash_table_get_or_insert(CXtndblNHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+// remove 'key' from 'table', if it's in there. (buckets are never merged, so
+// the table doesn't shrink)
+// returns true if it was removed, false if it wasn't in there
+bool cxtndbln_hash_table_delete(CXtndblNHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout (while no other thread is
+// changing it)
+void cxtndbln_hash_table_print(CXtndblNHashTable *table);
+
+// print some statistics about 'table' to stdout
+void cxtndbln_hash_table_stats(CXtndblNHashTable *table);
+
+// return how many keys 'table' has space for without growing
+int cxtndbln_hash_table_capacity(CXtndblNHashTable *table);
+
+#endif
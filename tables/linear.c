@@ -10,175 +10,559 @@
 #include <assert.h>
 
 #include "linear.h"
+#include "seqlock.h"
+#include "parallel.h"
 
 // how many cells to advance at a time while looking for a free slot
 #define STEP_SIZE 1
 
-// a hash table is an array of slots holding keys, along with a parallel array
-// of boolean markers recording which slots are in use (true) or free (false)
-// important because not-in-use slots might hold garbage data, as they may
-// not have been initialised
+// the table size is always a power of two, so addresses can be wrapped around
+// with a mask instead of a (slow) modulo
+#define wrap(table, h) ((h) & ((table)->size - 1))
+
+// deletion shifts later keys in a probe sequence back into the gap it leaves,
+// which relies on probe sequences visiting consecutive slots
+#if STEP_SIZE != 1
+#error "backward-shift deletion requires STEP_SIZE to be 1"
+#endif
+
+// grow the table once more than this fraction of its slots are in use, so that
+// probe sequences stay short (rather than waiting until the table is full)
+#define DEFAULT_MAX_LOAD 0.75
+
+// when the table grows, its keys move across to the new array a few at a
+// time: each insertion or deletion moves (at least) this many old slots
+#define MIGRATE_SLOTS 4
+
+// a parallel build splits the array into (a power of two) ranges, at least
+// this many per thread, so that threads which finish their ranges early can
+// take on more
+#define RANGES_PER_THREAD 8
+
+// a free slot holds this key. since it can't mark a slot holding itself, the
+// key EMPTY is kept in a slot of its own, outside of the array
+#define EMPTY 0
+
+// a slot holds a key and the value it maps to, side by side, so that finding
+// a key's value doesn't take another trip to memory
+typedef struct slot {
+	int64 key;
+	int64 value;
+} Slot;
+
+// a hash table is an array of slots holding keys. a slot is in use unless it
+// holds the sentinel key EMPTY, so checking whether a slot is free costs
+// nothing beyond reading its key
+//
+// while the table is growing, some keys are still in the previous (smaller)
+// array. they move across a whole cluster at a time, walking around the old
+// array from a slot which was free when growth began, so any key still in
+// there can be found by probing the old array as usual
 struct linear_table {
-	int64 *slots;	// array of slots holding keys
-	bool  *inuse;	// is this slot in use or not?
-	int size;		// the size of both of these arrays right now
-	int load;		// number of keys in the table right now
+	Slot  *slots;	// array of slots holding keys (and values)
+	int size;		// the size of this array (a power of two)
+	int load;		// number of keys in both arrays right now
+	Slot *oldslots;	// the previous array, or NULL if not growing
+	int oldsize;	// the size of the previous array
+	int begin;		// where in the previous array moving keys began
+	int moved;		// how many of its slots have been moved so far
+	bool has_zero;	// is the key EMPTY in the table?
+	Slot zero;		// the slot holding the key EMPTY, if it's in the table
+	double max_load;	// grow when load would exceed this fraction of size
 	int cols_1;	// number of collisions
 	int cols_2;
 	int prob;		// sum of checking
+	int max_prob;	// longest probe sequence of any insertion
 };
 
+// what each thread building part of a table keeps track of (see
+// linear_hash_table_build_parallel())
+typedef struct builder {
+	int load;			// how many keys the thread placed
+	int64 *overflow;	// keys the thread couldn't place within their range
+	int noverflow;
+	int capacity;		// how many keys 'overflow' has room for
+} Builder;
+
+// what the threads building a table between them share
+typedef struct build {
+	LinearHashTable *table;
+	Partition partition;	// the keys, grouped by range
+	int shift;				// a key's range is its first slot >> shift
+	int next;				// the next range no thread has claimed yet
+	Builder *builders;		// one per thread
+} Build;
+
 
 /* * * *
  * helper functions
  */
 
+static Slot *find_or_insert(LinearHashTable *table, int64 key, int64 value,
+	bool *inserted);
+static Slot *find_or_insert_from(LinearHashTable *table, int64 key,
+	int64 value, int h, bool *inserted);
+static Slot *find_old_slot(LinearHashTable *table, int64 key);
+
 // set up the internals of a linear hash table struct with new
 // arrays of size 'size'
 static void initialise_table(LinearHashTable *table, int size) {
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
-	table->slots = malloc((sizeof *table->slots) * size);
+	// zeroed memory is an array of free slots
+	table->slots = calloc(size, sizeof *table->slots);
 	assert(table->slots);
-	table->inuse = malloc((sizeof *table->inuse) * size);
-	assert(table->inuse);
-	int i;
-	for (i = 0; i < size; i++) {
-		table->inuse[i] = false;
-	}
 
 	table->size = size;
-	table->load = 0;
 	table->cols_2 = 0;
 }
 
 
-// double the size of the internal table arrays and re-hash all
-// keys in the old tables
-static void double_table(LinearHashTable *table) {
-	int64 *oldslots = table->slots;
-	bool  *oldinuse = table->inuse;
-	int oldsize = table->size;
+// put 'key' (which must not be in 'table' already) with value 'value' into
+// the first free slot of its probe sequence in the current array. used for
+// keys moving across from the previous array, which are known to be unique
+// and to fit, so there's no need to check for duplicates, count statistics
+// or consider growing
+static void place_key(LinearHashTable *table, int64 key, int64 value) {
+	int h = wrap(table, h1_64(key));
+	while (table->slots[h].key != EMPTY) {
+		h = wrap(table, h + STEP_SIZE);
+	}
+	table->slots[h].key = key;
+	table->slots[h].value = value;
+}
 
-	initialise_table(table, table->size * 2);
+// move (at least) 'nslots' slots' worth of keys from the previous array into
+// the current one, always finishing the cluster it's part way through
+static void migrate(LinearHashTable *table, int nslots) {
+	if (table->oldslots == NULL) {
+		return;
+	}
 
-	int i;
-	for (i = 0; i < oldsize; i++) {
-		if (oldinuse[i] == true) {
-			linear_hash_table_insert(table, oldslots[i]);
+	int moved;
+	for (moved = 0; table->moved < table->oldsize; moved++) {
+		Slot *slot = &table->oldslots[(table->begin + table->moved)
+			& (table->oldsize - 1)];
+		if (moved >= nslots && slot->key == EMPTY) {
+			break;
 		}
+		if (slot->key != EMPTY) {
+			place_key(table, slot->key, slot->value);
+			slot->key = EMPTY;
+		}
+		table->moved++;
 	}
 
-	free(oldslots);
-	free(oldinuse);
+	// all done? then the previous array is no longer needed
+	if (table->moved == table->oldsize) {
+		write_barrier();
+		free(table->oldslots);
+		table->oldslots = NULL;
+	}
 }
 
+// replace the internal table array with an array of size 'size' (a power of
+// two). rather than re-hash all keys in the old array right away, they move
+// across bit by bit as the table is used
+static void resize_table(LinearHashTable *table, int size) {
+	// (finishing off the last time the table grew, if it's still going)
+	migrate(table, table->oldsize);
+
+	// readers must not see the arrays and their sizes half swapped
+	write_barrier();
+	table->oldslots = table->slots;
+	table->oldsize = table->size;
+	table->moved = 0;
+
+	// start moving keys from a free slot, so that no cluster of keys is
+	// ever left half moved. there's always one unless the array is full, in
+	// which case it's all one big cluster and it all moves at once
+	table->begin = 0;
+	while (table->begin < table->oldsize
+		&& table->oldslots[table->begin].key != EMPTY) {
+		table->begin++;
+	}
+	table->begin &= table->oldsize - 1;
 
-/* * * *
- * all functions
- */
+	initialise_table(table, size);
+}
 
-// initialise a linear probing hash table with initial size 'size'
-LinearHashTable *new_linear_hash_table(int size) {
-	LinearHashTable *table = malloc(sizeof *table);
-	assert(table);
 
-	table->cols_1 = 0;
-	table->prob = 0;
-	// set up the internals of the table struct with arrays of size 'size'
-	initialise_table(table, size);
+// replace the internal table array with an array of size 'size' (a power of
+// two) and move all keys across right away, in one tight loop
+static void rehash_table(LinearHashTable *table, int size) {
+	resize_table(table, size);
+	migrate(table, table->oldsize);
+}
 
-	return table;
+
+// double the size of the internal table array, and begin moving the keys
+// in the old array across
+static void double_table(LinearHashTable *table) {
+	resize_table(table, table->size * 2);
 }
 
 
-// free all memory associated with 'table'
-void free_linear_hash_table(LinearHashTable *table) {
-	assert(table != NULL);
+// free the slot at address 'h' in the array 'slots' of size 'size' (a power of
+// two), keeping every other key reachable from its home address.
+// simply marking the slot as free would cut off any keys further along the
+// same probe sequence. instead, walk the rest of this run of used slots and
+// shift back into the gap every key which is allowed to sit there: those
+// whose home address is not cyclically between the gap and their slot
+// (in a completely full array the run is the whole array, so also stop
+// after one lap)
+static void shift_back(Slot *slots, int size, int h) {
+	int mask = size - 1;
+	int gap = h;
+	int next = (gap + 1) & mask;
+	int steps;
+	for (steps = 1; steps < size && slots[next].key != EMPTY; steps++) {
+		int home = h1_64(slots[next].key) & mask;
+		bool stays = (gap <= next)
+			? (gap < home && home <= next)
+			: (gap < home || home <= next);
+		if (!stays) {
+			slots[gap] = slots[next];
+			gap = next;
+		}
+		next = (next + 1) & mask;
+	}
 
-	// free the table's arrays
-	free(table->slots);
-	free(table->inuse);
+	// the last gap left behind is now genuinely free
+	slots[gap].key = EMPTY;
+}
 
-	// free the table struct itself
-	free(table);
+// find the slot holding 'key' in 'table', inserting 'key' with value 'value'
+// into a free slot if it's not in there already. sets '*inserted' to whether
+// it was inserted, and returns the key's slot
+static Slot *find_or_insert(LinearHashTable *table, int64 key, int64 value,
+	bool *inserted) {
+	return find_or_insert_from(table, key, value, wrap(table, h1_64(key)),
+		inserted);
 }
 
+// as 'find_or_insert()', starting from the key's initial address 'h'
+static Slot *find_or_insert_from(LinearHashTable *table, int64 key,
+	int64 value, int h, bool *inserted) {
 
-// insert 'key' into 'table', if it's not in there already
-// returns true if insertion succeeds, false if it was already in there
-bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
-	assert(table != NULL);
+	// if the table is still growing, move a few more keys across first
+	migrate(table, MIGRATE_SLOTS);
+
+	// the key EMPTY has a slot of its own
+	if (key == EMPTY) {
+		*inserted = !table->has_zero;
+		if (!table->has_zero) {
+			table->has_zero = true;
+			table->zero.key = EMPTY;
+			table->zero.value = value;
+		}
+		return &table->zero;
+	}
+
+	// it might not have moved across to the current array yet
+	if (table->oldslots) {
+		Slot *slot = find_old_slot(table, key);
+		if (slot) {
+			*inserted = false;
+			return slot;
+		}
+	}
 
 	// need to count our steps to make sure we recognise when the table is full
 	int steps = 0;
 
-	// calculate the initial address for this key
-	int h = h1(key) % table->size;
-	// printf("key: %d\n", h);
 	// calculate the collisions when h position is occupied
-	if (table->inuse[h]) {
+	if (table->slots[h].key != EMPTY) {
 		table->cols_1++;
 		table->cols_2++;
 	}
-	// step along the array until we find a free space (inuse[]==false),
+	// step along the array until we find a free space (key==EMPTY),
 	// or until we visit every cell
-	while (table->inuse[h] && steps < table->size) {
+	while (table->slots[h].key != EMPTY && steps < table->size) {
 		table->prob++;
-		if (table->slots[h] == key) {
+		if (table->slots[h].key == key) {
 			// this key already exists in the table! no need to insert
-			return false;
+			*inserted = false;
+			return &table->slots[h];
 		}
 		
 		// else, keep stepping through the table looking for a free slot
-		h = (h + STEP_SIZE) % table->size;
+		h = wrap(table, h + STEP_SIZE);
 		steps++;
 	}
 
+	if (steps > table->max_prob) {
+		table->max_prob = steps;
+	}
+
 	// if we used up all of our steps, then we're back where we started and the
-	// table is full
-	if (steps == table->size) {
+	// table is full. but rather than let it get that far, we also grow as soon
+	// as this key would take the table over its maximum load factor
+	if (steps == table->size || table->load + 1 > table->max_load * table->size) {
 		// let's make some more space and then try to insert this key again!
 		double_table(table);
-		return linear_hash_table_insert(table, key);
+		return find_or_insert(table, key, value, inserted);
 
 	} else {
 		// otherwise, we have found a free slot! insert this key right here
-		table->slots[h] = key;
-		table->inuse[h] = true;
+		table->slots[h].key = key;
+		table->slots[h].value = value;
 		table->load++;
-		return true;
+		*inserted = true;
+		return &table->slots[h];
 	}
 }
 
+// find the slot holding 'key' in 'table', starting from its initial address
+// 'h', or NULL if it's not in there
+static Slot *find_slot_from(LinearHashTable *table, int64 key, int h) {
 
-// lookup whether 'key' is inside 'table'
-// returns true if found, false if not
-bool linear_hash_table_lookup(LinearHashTable *table, int64 key) {
-	assert(table != NULL);
+	// the key EMPTY has a slot of its own
+	if (key == EMPTY) {
+		return table->has_zero ? &table->zero : NULL;
+	}
 
 	// need to count our steps to make sure we recognise when the table is full
 	int steps = 0;
 
-	// calculate the initial address for this key
-	int h = h1(key) % table->size;
-
-	// step along until we find a free space (inuse[]==false), or until we
+	// step along until we find a free space (key==EMPTY), or until we
 	// visit every cell
-	while (table->inuse[h] && steps < table->size) {
-		if (table->slots[h] == key) {
+	while (table->slots[h].key != EMPTY && steps < table->size) {
+		if (table->slots[h].key == key) {
 			// found the key!
-			return true;
+			return &table->slots[h];
 		}
 
 		// keep stepping
-		h = (h + STEP_SIZE) % table->size;
+		h = wrap(table, h + STEP_SIZE);
 		steps++;
 	}
 
 	// we have either searched the whole table or come back to where we started
-	// either way, the key is not in the hash table
-	return false;
+	// either way, the key is not in the current array. but it might not have
+	// moved across yet
+	if (table->oldslots) {
+		return find_old_slot(table, key);
+	}
+	return NULL;
+}
+
+// find the slot holding 'key' (which isn't EMPTY) in the previous array, or
+// NULL if it's not in there
+static Slot *find_old_slot(LinearHashTable *table, int64 key) {
+	int mask = table->oldsize - 1;
+	int h = h1_64(key) & mask;
+	int steps;
+	for (steps = 0; steps < table->oldsize
+			&& table->oldslots[h].key != EMPTY; steps++) {
+		if (table->oldslots[h].key == key) {
+			return &table->oldslots[h];
+		}
+		h = (h + STEP_SIZE) & mask;
+	}
+	return NULL;
+}
+
+// find the slot holding 'key' in 'table', or NULL if it's not in there
+static Slot *find_slot(LinearHashTable *table, int64 key) {
+	return find_slot_from(table, key, wrap(table, h1_64(key)));
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a linear probing hash table with initial size 'size'
+LinearHashTable *new_linear_hash_table(int size) {
+	LinearHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	table->cols_1 = 0;
+	table->prob = 0;
+	table->max_prob = 0;
+	table->max_load = DEFAULT_MAX_LOAD;
+	table->has_zero = false;
+	table->load = 0;
+	table->oldslots = NULL;
+	table->oldsize = 0;
+	// set up the internals of the table struct with arrays of size 'size'
+	// (rounded up, so that addresses can be masked)
+	initialise_table(table, next_power_of_two(size));
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_linear_hash_table(LinearHashTable *table) {
+	assert(table != NULL);
+
+	// free the table's arrays
+	free(table->slots);
+	free(table->oldslots);
+
+	// free the table struct itself
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
+	assert(table != NULL);
+
+	bool inserted;
+	find_or_insert(table, key, 0, &inserted);
+	return inserted;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool linear_hash_table_lookup(LinearHashTable *table, int64 key) {
+	assert(table != NULL);
+	return find_slot(table, key) != NULL;
+}
+
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int linear_hash_table_lookup_batch(LinearHashTable *table, int64 *keys, int n,
+	bool *results) {
+	assert(table != NULL);
+
+	int addresses[BATCH_GROUP];
+	int found = 0;
+	int i, j;
+	for (i = 0; i < n; i += BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// hash the whole group first, so that each key's first slot is already
+		// on its way into the cache by the time we come back to probe it
+		for (j = 0; j < group; j++) {
+			addresses[j] = wrap(table, h1_64(keys[i + j]));
+			prefetch(&table->slots[addresses[j]]);
+		}
+		for (j = 0; j < group; j++) {
+			results[i + j] = find_slot_from(table, keys[i + j], addresses[j])
+				!= NULL;
+			found += results[i + j];
+		}
+	}
+	return found;
+}
+
+
+// insert each of the 'n' keys in 'keys' into 'table', if it's not in there
+// already, storing whether each one was inserted in 'inserted'
+// returns how many of the keys were inserted
+int linear_hash_table_insert_batch(LinearHashTable *table, int64 *keys, int n,
+	bool *inserted) {
+	assert(table != NULL);
+
+	// grow (at most once) to fit the whole batch up front, rather than
+	// doubling again and again as the keys go in. the whole batch is going
+	// to wait for this anyway, so move all the keys across at once too
+	int size = table->size;
+	while (table->load + n > table->max_load * size) {
+		size *= 2;
+	}
+	if (size != table->size) {
+		rehash_table(table, size);
+	}
+
+	int addresses[BATCH_GROUP];
+	int count = 0;
+	int i, j;
+	for (i = 0; i < n; i += BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// hash the whole group first, prefetching each key's first slot
+		for (j = 0; j < group; j++) {
+			addresses[j] = wrap(table, h1_64(keys[i + j]));
+			prefetch(&table->slots[addresses[j]]);
+		}
+		for (j = 0; j < group; j++) {
+			find_or_insert_from(table, keys[i + j], 0, addresses[j],
+				&inserted[i + j]);
+			count += inserted[i + j];
+		}
+	}
+	return count;
+}
+
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool linear_hash_table_put(LinearHashTable *table, int64 key, int64 value) {
+	assert(table != NULL);
+
+	bool inserted;
+	Slot *slot = find_or_insert(table, key, value, &inserted);
+	slot->value = value;
+	return inserted;
+}
+
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool linear_hash_table_get(LinearHashTable *table, int64 key, int64 *value) {
+	assert(table != NULL);
+
+	Slot *slot = find_slot(table, key);
+	if (slot && value) {
+		*value = slot->value;
+	}
+	return slot != NULL;
+}
+
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool linear_hash_table_get_or_insert(LinearHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table != NULL);
+
+	bool inserted;
+	Slot *slot = find_or_insert(table, key, value, &inserted);
+	if (result) {
+		*result = slot->value;
+	}
+	return inserted;
+}
+
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool linear_hash_table_delete(LinearHashTable *table, int64 key) {
+	assert(table != NULL);
+
+	// if the table is still growing, move a few more keys across first
+	migrate(table, MIGRATE_SLOTS);
+
+	// find the key, exactly as for a lookup
+	Slot *slot = find_slot(table, key);
+	if (slot == NULL) {
+		return false;
+	}
+	if (slot == &table->zero) {
+		// the key EMPTY isn't part of any probe sequence
+		table->has_zero = false;
+		return true;
+	}
+	if (slot >= table->slots && slot < table->slots + table->size) {
+		shift_back(table->slots, table->size, slot - table->slots);
+	} else {
+		// (it hasn't moved across to the current array yet)
+		shift_back(table->oldslots, table->oldsize, slot - table->oldslots);
+	}
+	table->load--;
+	return true;
 }
 
 
@@ -199,13 +583,28 @@ void linear_hash_table_print(LinearHashTable *table) {
 		printf(" %9d | ", i);
 
 		// print the contents of the slot
-		if (table->inuse[i]) {
-			printf("%llu\n", table->slots[i]);
+		if (table->slots[i].key != EMPTY) {
+			printf("%llu\n", table->slots[i].key);
 		} else {
 			printf("-\n");
 		}
 	}
 
+	// keys which haven't moved across since the table grew
+	if (table->oldslots) {
+		for (i = 0; i < table->oldsize; i++) {
+			if (table->oldslots[i].key != EMPTY) {
+				printf(" %9s | %llu (not yet moved)\n", "-",
+					table->oldslots[i].key);
+			}
+		}
+	}
+
+	// the key EMPTY lives outside of the array
+	if (table->has_zero) {
+		printf(" %9s | %llu\n", "-", table->zero.key);
+	}
+
 	printf("--- end table ---\n");
 }
 
@@ -217,11 +616,141 @@ void linear_hash_table_stats(LinearHashTable *table) {
 	
 	// print some information about the table
 	printf("current size: %d slots\n", table->size);
-	printf("current load: %d items\n", table->load);
+	printf("current load: %d items\n", table->load + table->has_zero);
 	printf(" load factor: %.3f%%\n", table->load * 100.0 / table->size);
+	printf("    max load: %.3f%%\n", table->max_load * 100.0);
+	if (table->oldslots) {
+		printf("   migrating: %d of %d old slots left\n",
+			table->oldsize - table->moved, table->oldsize);
+	}
 	printf("   step size: %d slots\n", STEP_SIZE);
 	printf("collisions_1: %d\n", table->cols_1);
 	printf("collisions_2: %d\n", table->cols_2);
 	printf("   avg probe: %.3f%%\n", table->prob * 1.0 / table->load);
+	printf("   max probe: %d\n", table->max_prob);
 	printf("--- end stats ---\n");
 }
+
+// return how many keys 'table' has space for without growing
+int linear_hash_table_capacity(LinearHashTable *table) {
+	assert(table != NULL);
+	return table->size;
+}
+
+
+// which range of the table being built 'arg' key 'key' belongs in
+static int range_of(void *arg, int64 key) {
+	Build *build = arg;
+	return wrap(build->table, h1_64(key)) >> build->shift;
+}
+
+// note that 'builder' couldn't place 'key', leaving it for later
+static void defer_key(Builder *builder, int64 key) {
+	if (builder->noverflow == builder->capacity) {
+		builder->capacity = builder->capacity ? 2 * builder->capacity : 64;
+		builder->overflow = realloc(builder->overflow,
+			(sizeof *builder->overflow) * builder->capacity);
+		assert(builder->overflow);
+	}
+	builder->overflow[builder->noverflow++] = key;
+}
+
+// claim ranges of the table being built (as 'arg') one at a time and place
+// their keys. a key's probe sequence must stay within its range (since the
+// next range belongs to another thread), so any key which would run off the
+// end is left for later, as is the key EMPTY
+static void build_ranges(void *arg, int thread) {
+	Build *build = arg;
+	Builder *builder = &build->builders[thread];
+	Slot *slots = build->table->slots;
+	int load = 0;
+
+	int range;
+	while ((range = __atomic_fetch_add(&build->next, 1, __ATOMIC_RELAXED))
+			< build->partition.nparts) {
+		int end = (range + 1) << build->shift;
+		int i;
+		for (i = build->partition.start[range];
+				i < build->partition.start[range + 1]; i++) {
+			int64 key = build->partition.keys[i];
+			if (key == EMPTY) {
+				defer_key(builder, key);
+				continue;
+			}
+			int h = wrap(build->table, h1_64(key));
+			while (h < end && slots[h].key != EMPTY && slots[h].key != key) {
+				h++;
+			}
+			if (h == end) {
+				defer_key(builder, key);
+			} else if (slots[h].key == EMPTY) {
+				slots[h].key = key;
+				slots[h].value = 0;
+				load++;
+			}
+		}
+	}
+	builder->load = load;
+}
+
+// create a linear probing hash table holding the 'n' keys in 'keys', built
+// by 'nthreads' threads at once
+LinearHashTable *linear_hash_table_build_parallel(int size, int64 *keys, int n,
+	int nthreads) {
+	assert(nthreads > 0);
+	LinearHashTable *table = new_linear_hash_table(size);
+
+	// size the array for all of the keys up front, as for a batch
+	size = table->size;
+	while (n > table->max_load * size) {
+		size *= 2;
+	}
+	if (size != table->size) {
+		free(table->slots);
+		initialise_table(table, size);
+	}
+
+	// split it into ranges (as many as there are slots, at most), and group
+	// the keys by the range their first slot is in
+	int depth = 0, bits = 0;
+	while ((1 << depth) < table->size) {
+		depth++;
+	}
+	while (bits < depth && (1 << bits) < nthreads * RANGES_PER_THREAD) {
+		bits++;
+	}
+	Build build = { .table = table, .shift = depth - bits, .next = 0 };
+	build.partition = partition_keys(keys, n, 1 << bits, range_of, &build,
+		nthreads);
+	build.builders = calloc(nthreads, sizeof *build.builders);
+	assert(build.builders);
+
+	// fill in the ranges in parallel, and then place the keys which didn't
+	// fit within their ranges one at a time (rarely more than a few, since
+	// the table is at most 'max_load' full)
+	run_threads(nthreads, build_ranges, &build);
+	int t, i;
+	for (t = 0; t < nthreads; t++) {
+		table->load += build.builders[t].load;
+	}
+	for (t = 0; t < nthreads; t++) {
+		Builder *builder = &build.builders[t];
+		for (i = 0; i < builder->noverflow; i++) {
+			bool inserted;
+			find_or_insert(table, builder->overflow[i], 0, &inserted);
+		}
+		free(builder->overflow);
+	}
+
+	free(build.builders);
+	free_partition(&build.partition);
+	return table;
+}
+
+
+// set the load factor (between 0 and 1) above which 'table' will grow
+void linear_hash_table_set_max_load(LinearHashTable *table, double max_load) {
+	assert(table != NULL);
+	assert(max_load > 0 && max_load <= 1);
+	table->max_load = max_load;
+}
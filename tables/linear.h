@@ -20,13 +20,59 @@ void free_linear_hash_table(LinearHashTable *table);
 // returns true if insertion succeeds, false if it was already in there
 bool linear_hash_table_insert(LinearHashTable *table, int64 key);
 
+// insert each of the 'n' keys in 'keys' into 'table', if it's not in there
+// already, storing whether each one was inserted in 'inserted'. the table is
+// grown at most once, up front, to fit the whole batch
+// returns how many of the keys were inserted
+int linear_hash_table_insert_batch(LinearHashTable *table, int64 *keys, int n,
+	bool *inserted);
+
+// create a linear probing hash table (as with initial size 'size') holding
+// the 'n' keys in 'keys', built by 'nthreads' threads at once: the array is
+// sized for all of the keys up front and split into ranges, and each thread
+// fills in whole ranges with the keys whose first slot is in them
+LinearHashTable *linear_hash_table_build_parallel(int size, int64 *keys, int n,
+	int nthreads);
+
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool linear_hash_table_lookup(LinearHashTable *table, int64 key);
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'. keys are hashed in groups, and the memory they
+// will probe is prefetched before any of them are probed
+// returns how many of the keys were found
+int linear_hash_table_lookup_batch(LinearHashTable *table, int64 *keys, int n,
+	bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool linear_hash_table_put(LinearHashTable *table, int64 key, int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool linear_hash_table_get(LinearHashTable *table, int64 key, int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool linear_hash_table_get_or_insert(LinearHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool linear_hash_table_delete(LinearHashTable *table, int64 key);
+
 // print the contents of 'table' to stdout
 void linear_hash_table_print(LinearHashTable *table);
 
 // print some statistics about 'table' to stdout
 void linear_hash_table_stats(LinearHashTable *table);
 
+// return how many keys 'table' has space for without growing
+int linear_hash_table_capacity(LinearHashTable *table);
+
+// set the load factor (between 0 and 1) above which 'table' will grow
+void linear_hash_table_set_max_load(LinearHashTable *table, double max_load);
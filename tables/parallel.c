@@ -0,0 +1,154 @@
+/* * * * * * * * *
+ * Helpers for building a table on several threads at once: running a piece
+ * of work on each thread, and splitting an array of keys into groups (such
+ * as the range of the table each key lands in) for the threads to share out
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "parallel.h"
+
+// what each thread started by run_threads() needs to know
+typedef struct worker {
+	pthread_t thread;
+	void (*work)(void *arg, int thread);
+	void *arg;
+	int index;		// which thread this is
+} Worker;
+
+// what partition_keys() shares between its threads
+typedef struct partitioning {
+	int64 *keys;		// the keys to group
+	int n;
+	int nparts;
+	int nthreads;
+	int (*part_of)(void *arg, int64 key);
+	void *arg;
+	int *counts;		// how many of each thread's keys are in each group,
+						// then where in each group the thread's keys go
+	Partition *partition;
+} Partitioning;
+
+
+/* * * *
+ * helper functions
+ */
+
+// entry point of each thread started by run_threads()
+static void *run_worker(void *arg) {
+	Worker *worker = arg;
+	worker->work(worker->arg, worker->index);
+	return NULL;
+}
+
+// thread 'thread' of partition_keys()' share of the keys
+static void slice(Partitioning *p, int thread, int *first, int *last) {
+	*first = (int)((int64)p->n * thread / p->nthreads);
+	*last = (int)((int64)p->n * (thread + 1) / p->nthreads);
+}
+
+// count how many of thread 'thread''s keys belong in each group
+static void count_parts(void *arg, int thread) {
+	Partitioning *p = arg;
+	int *counts = p->counts + thread * p->nparts;
+	int first, last, i;
+	slice(p, thread, &first, &last);
+	for (i = first; i < last; i++) {
+		counts[p->part_of(p->arg, p->keys[i])]++;
+	}
+}
+
+// deal thread 'thread''s keys out into their groups, starting each group at
+// the place worked out for it
+static void deal_parts(void *arg, int thread) {
+	Partitioning *p = arg;
+	int *next = p->counts + thread * p->nparts;
+	int first, last, i;
+	slice(p, thread, &first, &last);
+	for (i = first; i < last; i++) {
+		int part = p->part_of(p->arg, p->keys[i]);
+		p->partition->keys[next[part]++] = p->keys[i];
+	}
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// run 'work(arg, thread)' on 'nthreads' threads at once, and wait for them
+void run_threads(int nthreads, void (*work)(void *arg, int thread),
+	void *arg) {
+	assert(nthreads > 0);
+
+	Worker *workers = malloc((sizeof *workers) * nthreads);
+	assert(workers);
+	int t;
+	for (t = 1; t < nthreads; t++) {
+		workers[t] = (Worker){ .work = work, .arg = arg, .index = t };
+		int error = pthread_create(&workers[t].thread, NULL, run_worker,
+			&workers[t]);
+		assert(!error);
+		(void)error;
+	}
+	work(arg, 0);
+	for (t = 1; t < nthreads; t++) {
+		pthread_join(workers[t].thread, NULL);
+	}
+	free(workers);
+}
+
+
+// group the 'n' keys in 'keys' into 'nparts' groups using 'nthreads' threads
+Partition partition_keys(int64 *keys, int n, int nparts,
+	int (*part_of)(void *arg, int64 key), void *arg, int nthreads) {
+	assert(nparts > 0 && nthreads > 0);
+
+	Partition partition;
+	partition.nparts = nparts;
+	partition.keys = malloc((sizeof *partition.keys) * (n + 1));
+	assert(partition.keys);
+	partition.start = malloc((sizeof *partition.start) * (nparts + 1));
+	assert(partition.start);
+
+	Partitioning p = { .keys = keys, .n = n, .nparts = nparts,
+		.nthreads = nthreads, .part_of = part_of, .arg = arg,
+		.partition = &partition };
+	p.counts = calloc((size_t)nthreads * nparts, sizeof *p.counts);
+	assert(p.counts);
+
+	// each thread counts its own share of the keys into each group...
+	run_threads(nthreads, count_parts, &p);
+
+	// ...from which each group's start follows, and within each group, where
+	// each thread's keys go (after the keys of the threads before it)
+	int place = 0;
+	int part, t;
+	for (part = 0; part < nparts; part++) {
+		partition.start[part] = place;
+		for (t = 0; t < nthreads; t++) {
+			int count = p.counts[t * nparts + part];
+			p.counts[t * nparts + part] = place;
+			place += count;
+		}
+	}
+	partition.start[nparts] = place;
+
+	// so that each thread can deal its keys out without waiting on the others
+	run_threads(nthreads, deal_parts, &p);
+
+	free(p.counts);
+	return partition;
+}
+
+
+// free the memory taken by 'partition'
+void free_partition(Partition *partition) {
+	free(partition->keys);
+	free(partition->start);
+}
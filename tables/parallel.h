@@ -0,0 +1,37 @@
+/* * * * * * * * *
+ * Helpers for building a table on several threads at once: running a piece
+ * of work on each thread, and splitting an array of keys into groups (such
+ * as the range of the table each key lands in) for the threads to share out
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "../inthash.h"
+
+// 'n' keys rearranged into 'nparts' groups, each group's keys side by side
+// (in the order they came in)
+typedef struct partition {
+	int64 *keys;	// the keys, grouped
+	int *start;		// where each group begins ('nparts' + 1 entries, the last
+					// being the number of keys)
+	int nparts;
+} Partition;
+
+// run 'work(arg, thread)' on 'nthreads' threads at once (the calling thread
+// being thread 0), and wait for them all to finish
+void run_threads(int nthreads, void (*work)(void *arg, int thread),
+	void *arg);
+
+// group the 'n' keys in 'keys' into 'nparts' groups, key 'k' going to group
+// 'part_of(arg, k)', using 'nthreads' threads
+Partition partition_keys(int64 *keys, int n, int nparts,
+	int (*part_of)(void *arg, int64 key), void *arg, int nthreads);
+
+// free the memory taken by 'partition'
+void free_partition(Partition *partition);
+
+#endif
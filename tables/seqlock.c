@@ -0,0 +1,250 @@
+/* * * * * * * * *
+ * Sequence lock letting any number of threads read a table without taking a
+ * lock while one thread at a time writes to it: readers note the sequence
+ * number before reading, and read again if a write happened in the meantime
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#define _POSIX_C_SOURCE 200112L // for posix_memalign
+
+#include <stdlib.h>
+#include <assert.h>
+#include <sched.h>
+
+#include "seqlock.h"
+
+#define CACHE_LINE 64
+
+// readers count themselves in one of this many counters (chosen per thread),
+// each on its own cache line, so that they don't all fight over one line
+#define READER_SLOTS 16
+
+// a reader which has had to repeat this many reads in a row (or has waited
+// long enough to give up the CPU) asks the writer to hold off (a writer
+// working flat out would otherwise leave readers no gap in which to read)
+#define STARVING_RETRIES 4
+
+// after spinning this many times waiting for another thread, give up the
+// CPU instead (the thread being waited for may need it to finish)
+#define SPINS_BEFORE_YIELD 64
+
+// tell the CPU we're spinning, where there's a way to
+#if defined(__x86_64__) || defined(__i386__)
+#define pause() __builtin_ia32_pause()
+#else
+#define pause() ((void)0)
+#endif
+
+// how many times in a row this thread has spun
+static __thread int spins = 0;
+
+// a count of the readers part-way through a read, padded to a cache line
+typedef struct reader_slot {
+	int count;
+	char padding[CACHE_LINE - sizeof (int)];
+} ReaderSlot;
+
+struct seqlock {
+	ReaderSlot readers[READER_SLOTS];	// readers part-way through a read
+	unsigned sequence;	// goes up by one at the start and end of each write,
+						// so it's odd while a write is in progress
+	bool blocked;		// is the writer keeping readers out (see
+						// write_barrier())
+	int starving;		// how many readers are asking the writer to wait
+};
+
+// which reader slot this thread counts itself in (-1 until it first reads)
+static __thread int reader_slot = -1;
+
+// how many times in a row this thread has had to repeat a read
+static __thread int retries = 0;
+
+// is this thread counted among the lock's starving readers
+static __thread bool starving = false;
+
+// the lock this thread is currently writing under, if any
+static __thread SeqLock *writing = NULL;
+
+// how many threads have picked a reader slot so far
+static int nthreads = 0;
+
+
+// wait a moment before checking again on another thread: briefly at first,
+// then by letting other threads run
+static void spin(void) {
+	if (++spins < SPINS_BEFORE_YIELD) {
+		pause();
+	} else {
+		sched_yield();
+	}
+}
+
+
+// create a new sequence lock, with no read or write in progress
+SeqLock *new_seqlock(void) {
+	void *memory;
+	int error = posix_memalign(&memory, CACHE_LINE, sizeof (SeqLock));
+	assert(!error);
+	SeqLock *lock = memory;
+
+	int i;
+	for (i = 0; i < READER_SLOTS; i++) {
+		lock->readers[i].count = 0;
+	}
+	lock->sequence = 0;
+	lock->blocked = false;
+	lock->starving = 0;
+
+	return lock;
+}
+
+
+// free all memory associated with 'lock'
+void free_seqlock(SeqLock *lock) {
+	assert(lock);
+	free(lock);
+}
+
+
+// count this thread among the readers asking the writer on 'lock' to hold off
+static void starve(SeqLock *lock) {
+	if (!starving) {
+		starving = true;
+		__atomic_add_fetch(&lock->starving, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+
+// begin reading the structure protected by 'lock', returning the sequence
+// number to pass to read_retry() afterwards
+unsigned read_begin(SeqLock *lock) {
+	if (!lock) {
+		return 0;
+	}
+	if (reader_slot < 0) {
+		reader_slot = __atomic_fetch_add(&nthreads, 1, __ATOMIC_RELAXED)
+			% READER_SLOTS;
+	}
+	int *count = &lock->readers[reader_slot].count;
+
+	while (true) {
+		// wait for a write in progress to finish, since this read would only
+		// have to be repeated anyway
+		unsigned start = __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE);
+		if (start & 1) {
+			spin();
+			if (spins >= SPINS_BEFORE_YIELD) {
+				starve(lock);
+			}
+			continue;
+		}
+
+		// count ourselves in, unless the writer is keeping readers out. (the
+		// writer sets 'blocked' before checking the counts, and we check it
+		// after counting ourselves, so one of us always sees the other)
+		__atomic_add_fetch(count, 1, __ATOMIC_SEQ_CST);
+		if (!__atomic_load_n(&lock->blocked, __ATOMIC_SEQ_CST)) {
+			spins = 0;
+			return start;
+		}
+		__atomic_sub_fetch(count, 1, __ATOMIC_RELEASE);
+		while (__atomic_load_n(&lock->blocked, __ATOMIC_ACQUIRE)) {
+			spin();
+		}
+	}
+	spins = 0;
+}
+
+
+// finish a read begun with read_begin() (which returned 'start')
+// returns true if a write overlapped the read, so that it must be repeated
+bool read_retry(SeqLock *lock, unsigned start) {
+	if (!lock) {
+		return false;
+	}
+
+	// make sure everything the read looked at was read before checking
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	unsigned end = __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&lock->readers[reader_slot].count, 1,
+		__ATOMIC_RELEASE);
+
+	// keep track of how long we've been trying, and once it's been too long,
+	// have the writer wait for us (until we succeed)
+	if (end != start) {
+		if (++retries >= STARVING_RETRIES) {
+			starve(lock);
+		}
+		return true;
+	}
+	if (starving) {
+		starving = false;
+		__atomic_sub_fetch(&lock->starving, 1, __ATOMIC_RELEASE);
+	}
+	retries = 0;
+	return false;
+}
+
+
+// begin writing to the structure protected by 'lock', waiting for any other
+// writer to finish first
+void write_begin(SeqLock *lock) {
+	if (!lock) {
+		return;
+	}
+
+	// claim the lock by making the sequence number odd, once no reader is
+	// starving
+	unsigned sequence = __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED);
+	while ((sequence & 1) || __atomic_load_n(&lock->starving, __ATOMIC_SEQ_CST)
+			|| !__atomic_compare_exchange_n(&lock->sequence, &sequence,
+			sequence + 1, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+		spin();
+		sequence = __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED);
+	}
+
+	// and make sure readers see that before any of the writes that follow
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	writing = lock;
+	spins = 0;
+}
+
+
+// finish a write begun with write_begin()
+void write_end(SeqLock *lock) {
+	if (!lock) {
+		return;
+	}
+	assert(writing == lock);
+	writing = NULL;
+
+	// let any readers waiting on the barrier back in, then publish that and
+	// the writes along with the new (even) sequence number. this must come
+	// first: once the sequence is even, the next writer may set the barrier
+	// again, and clearing it after that would let readers in under its write
+	if (__atomic_load_n(&lock->blocked, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&lock->blocked, false, __ATOMIC_RELAXED);
+	}
+	__atomic_add_fetch(&lock->sequence, 1, __ATOMIC_RELEASE);
+}
+
+
+// wait until no reader is part-way through a read of the structure the
+// calling thread is writing to, and keep new readers out until the write ends
+void write_barrier(void) {
+	SeqLock *lock = writing;
+	if (!lock || __atomic_load_n(&lock->blocked, __ATOMIC_RELAXED)) {
+		return;
+	}
+
+	__atomic_store_n(&lock->blocked, true, __ATOMIC_SEQ_CST);
+	int i;
+	for (i = 0; i < READER_SLOTS; i++) {
+		while (__atomic_load_n(&lock->readers[i].count, __ATOMIC_SEQ_CST)) {
+			spin();
+		}
+	}
+	spins = 0;
+}
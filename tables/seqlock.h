@@ -0,0 +1,51 @@
+/* * * * * * * * *
+ * Sequence lock letting any number of threads read a table without taking a
+ * lock while one thread at a time writes to it: readers note the sequence
+ * number before reading, and read again if a write happened in the meantime
+ *
+ * a reader can't be allowed to follow pointers into memory that a writer is
+ * freeing or moving, so table code calls write_barrier() just before doing
+ * that: it waits for readers part-way through a read to finish, and keeps
+ * new readers waiting until the write is over
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdbool.h>
+
+typedef struct seqlock SeqLock;
+
+// create a new sequence lock, with no read or write in progress
+SeqLock *new_seqlock(void);
+
+// free all memory associated with 'lock'
+void free_seqlock(SeqLock *lock);
+
+// begin reading the structure protected by 'lock', returning the sequence
+// number to pass to read_retry() afterwards. does nothing (and returns 0)
+// if 'lock' is NULL
+unsigned read_begin(SeqLock *lock);
+
+// finish a read begun with read_begin() (which returned 'start')
+// returns true if a write overlapped the read, so that it must be repeated
+bool read_retry(SeqLock *lock, unsigned start);
+
+// begin writing to the structure protected by 'lock', waiting for any other
+// writer to finish first. does nothing if 'lock' is NULL
+void write_begin(SeqLock *lock);
+
+// finish a write begun with write_begin()
+void write_end(SeqLock *lock);
+
+// wait until no reader is part-way through a read of the structure the
+// calling thread is writing to, and keep new readers out until the write
+// ends. call before freeing or moving memory readers might be using (or
+// changing the size of an array they index). does nothing outside of
+// write_begin() and write_end()
+void write_barrier(void);
+
+#endif
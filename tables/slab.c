@@ -0,0 +1,105 @@
+/* * * * * * * * *
+ * Slab allocator for fixed-size items (such as hash table buckets): items are
+ * carved out of a few large chunks of memory rather than allocated one by one,
+ * so they sit close together, cost no per-item allocator overhead, and can all
+ * be freed at once
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "slab.h"
+#include "seqlock.h"
+
+// items are aligned to (and padded to a multiple of) this many bytes, which
+// is enough for any of the types stored in them
+#define ALIGNMENT 16
+
+// round 'n' up to a multiple of ALIGNMENT
+#define align(n) (((n) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)
+
+// how many items chunk 'c' holds (see slab.h)
+#define chunk_items(c) ((c) == 0 ? 1u << FIRST_CHUNK_BITS \
+	: 1u << (FIRST_CHUNK_BITS + (c) - 1))
+
+
+// create a slab handing out items of 'itemsize' bytes each
+Slab *new_slab(size_t itemsize) {
+	Slab *slab = malloc(sizeof *slab);
+	assert(slab);
+
+	// freed items have to be able to hold the index of the next freed item
+	if (itemsize < sizeof (uint32_t)) {
+		itemsize = sizeof (uint32_t);
+	}
+	slab->itemsize = align(itemsize);
+	slab->nchunks = 0;
+	slab->nitems = 0;
+	slab->capacity = 0;
+	slab->freed = SLAB_NONE;
+	slab->bytes = 0;
+
+	return slab;
+}
+
+
+// free 'slab', along with every item allocated from it
+void free_slab(Slab *slab) {
+	assert(slab);
+
+	int c;
+	for (c = 0; c < slab->nchunks; c++) {
+		free(slab->chunks[c]);
+	}
+	free(slab);
+}
+
+
+// allocate an item from 'slab', returning its index. its contents are
+// uninitialised
+uint32_t slab_alloc(Slab *slab) {
+	assert(slab);
+
+	// reuse a freed item if there are any. each freed item holds the index
+	// of the item freed before it
+	if (slab->freed != SLAB_NONE) {
+		uint32_t index = slab->freed;
+		slab->freed = *(uint32_t *)slab_item(slab, index);
+		return index;
+	}
+
+	// otherwise carve a new one from the end of the last chunk, first
+	// allocating a new chunk if the last one is used up
+	if (slab->nitems == slab->capacity) {
+		// (readers translating indices mustn't see the new chunk half added)
+		write_barrier();
+		assert(slab->nchunks < MAX_CHUNKS && "error: slab has grown too large!");
+		size_t bytes = slab->itemsize * chunk_items(slab->nchunks);
+		slab->chunks[slab->nchunks] = malloc(bytes);
+		assert(slab->chunks[slab->nchunks]);
+		slab->capacity += chunk_items(slab->nchunks);
+		slab->nchunks++;
+		slab->bytes += bytes;
+	}
+	return slab->nitems++;
+}
+
+
+// give item 'index' (allocated from 'slab') back to be reused by a later
+// allocation
+void slab_free(Slab *slab, uint32_t index) {
+	assert(slab && index < slab->nitems);
+
+	*(uint32_t *)slab_item(slab, index) = slab->freed;
+	slab->freed = index;
+}
+
+
+// return how many bytes 'slab' has taken from the system allocator
+size_t slab_bytes(Slab *slab) {
+	assert(slab);
+	return slab->bytes;
+}
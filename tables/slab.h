@@ -0,0 +1,74 @@
+/* * * * * * * * *
+ * Slab allocator for fixed-size items (such as hash table buckets): items are
+ * carved out of a few large chunks of memory rather than allocated one by one,
+ * so they sit close together, cost no per-item allocator overhead, and can all
+ * be freed at once
+ *
+ * items are named by 32-bit indices rather than pointers, so that structures
+ * referring to many items (like an extendible hash table's directory) can
+ * store half as many bytes per reference
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the first chunk holds 2^FIRST_CHUNK_BITS items, the second as many again,
+// and each chunk after that twice as many as the one before, so that chunk
+// 'c' (for c > 0) starts at index 2^(FIRST_CHUNK_BITS + c - 1)
+#define FIRST_CHUNK_BITS 4
+#define MAX_CHUNKS (32 - FIRST_CHUNK_BITS + 1)
+
+// the slab structure is visible here (rather than only inside slab.c) so that
+// slab_item() can be inlined into table lookups; use the functions below
+// rather than its fields
+typedef struct slab {
+	size_t itemsize;			// bytes per item (rounded up to the alignment)
+	char *chunks[MAX_CHUNKS];	// the chunks allocated so far
+	int nchunks;				// how many chunks have been allocated
+	uint32_t nitems;			// how many items have been carved out so far
+	uint32_t capacity;			// how many items the chunks have room for
+	uint32_t freed;				// index of the most recently freed item, or
+								// SLAB_NONE if there are none to reuse
+	size_t bytes;				// total bytes taken from the system allocator
+} Slab;
+
+// an index which no item has (like a NULL pointer)
+#define SLAB_NONE UINT32_MAX
+
+// create a slab handing out items of 'itemsize' bytes each
+Slab *new_slab(size_t itemsize);
+
+// free 'slab', along with every item allocated from it
+void free_slab(Slab *slab);
+
+// allocate an item from 'slab', returning its index. its contents are
+// uninitialised
+uint32_t slab_alloc(Slab *slab);
+
+// give item 'index' (allocated from 'slab') back to be reused by a later
+// allocation
+void slab_free(Slab *slab, uint32_t index);
+
+// return how many bytes 'slab' has taken from the system allocator
+size_t slab_bytes(Slab *slab);
+
+// return the address of item 'index' in 'slab'. addresses stay valid until
+// the item is freed
+static inline void *slab_item(Slab *slab, uint32_t index) {
+	uint32_t above = index >> FIRST_CHUNK_BITS;
+	if (above == 0) {
+		return slab->chunks[0] + index * slab->itemsize;
+	}
+	// the highest set bit of the index says which chunk it's in
+	int chunk = 32 - __builtin_clz(above);
+	uint32_t first = 1u << (FIRST_CHUNK_BITS + chunk - 1);
+	return slab->chunks[chunk] + (index - first) * slab->itemsize;
+}
+
+#endif
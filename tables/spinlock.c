@@ -0,0 +1,35 @@
+/* * * * * * * * *
+ * Spin lock for guarding small pieces of a structure shared between threads,
+ * where each thread holds the lock for only a few instructions at a time
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#include <sched.h>
+
+#include "spinlock.h"
+
+// after spinning this many times waiting for the lock, give up the CPU
+// instead (the holder may need it to finish)
+#define SPINS_BEFORE_YIELD 64
+
+// tell the CPU we're spinning, where there's a way to
+#if defined(__x86_64__) || defined(__i386__)
+#define pause() __builtin_ia32_pause()
+#else
+#define pause() ((void)0)
+#endif
+
+
+// wait for 'lock' to be released and then take it (used by spin_lock())
+void spin_lock_wait(SpinLock *lock) {
+	int spins = 0;
+	while (!spin_trylock(lock)) {
+		if (++spins < SPINS_BEFORE_YIELD) {
+			pause();
+		} else {
+			sched_yield();
+		}
+	}
+}
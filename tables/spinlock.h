@@ -0,0 +1,49 @@
+/* * * * * * * * *
+ * Spin lock for guarding small pieces of a structure shared between threads,
+ * where each thread holds the lock for only a few instructions at a time
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdbool.h>
+
+// the lock is a single int (0 when free), so that it can sit in the same
+// cache line as the data it guards
+typedef struct spinlock {
+	int locked;
+} SpinLock;
+
+// wait for 'lock' to be released and then take it (used by spin_lock())
+void spin_lock_wait(SpinLock *lock);
+
+// set up 'lock' as free
+static inline void spin_init(SpinLock *lock) {
+	lock->locked = 0;
+}
+
+// take 'lock' if it's free
+// returns true if it was taken, false if another thread holds it
+static inline bool spin_trylock(SpinLock *lock) {
+	// (read before writing, so that waiting threads don't keep taking the
+	// line away from the holder)
+	return !__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)
+		&& !__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+// take 'lock', waiting for it if another thread holds it
+static inline void spin_lock(SpinLock *lock) {
+	if (!spin_trylock(lock)) {
+		spin_lock_wait(lock);
+	}
+}
+
+// release 'lock' (which the calling thread holds)
+static inline void spin_unlock(SpinLock *lock) {
+	__atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+#endif
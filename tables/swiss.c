@@ -0,0 +1,481 @@
+/* * * * * * * * *
+ * Dynamic hash table using open addressing over groups of 16 slots, with a
+ * byte of metadata per slot so that a whole group can be searched at once
+ * (in the style of Google's "Swiss tables")
+ *
+ * every slot has a control byte, which is either EMPTY, DELETED, or (for a
+ * slot in use) 7 bits of its key's hash value, called its tag. a lookup
+ * compares the key's tag against all 16 control bytes of a group in one go,
+ * and only compares keys in the slots whose tags match --- usually just the
+ * right one, if any. groups are probed one after another until a group with
+ * an EMPTY slot shows that the key can't be any further along
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "swiss.h"
+#include "seqlock.h"
+
+// how many slots in a group (the width of one SSE2 register, in bytes)
+#define GROUP_SIZE 16
+
+// control byte values. a slot in use has its key's tag (0 to 127) instead,
+// so that the free values are exactly the ones with their top bit set
+#define CTRL_EMPTY   ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+
+// grow the table once more than this fraction of its slots would be in use.
+// probing a whole group at a time keeps lookups fast at much higher loads
+// than linear probing can manage
+#define DEFAULT_MAX_LOAD 0.875
+
+// a mask with one bit for each slot of a group, bit i for slot i
+typedef unsigned int Mask;
+
+// index of the lowest set bit of a (nonzero) mask
+#if defined(__GNUC__)
+#define lowest_bit(m) __builtin_ctz(m)
+#else
+static int lowest_bit(Mask m) {
+	int i = 0;
+	while (!(m & 1)) {
+		m >>= 1;
+		i++;
+	}
+	return i;
+}
+#endif
+
+// a slot holds a key and the value it maps to, side by side
+typedef struct slot {
+	int64 key;
+	int64 value;
+} Slot;
+
+// a swiss table is an array of slots split into groups, along with an array
+// of control bytes (one per slot) saying which slots are free and holding a
+// little of the hash value of the key in each slot that isn't
+struct swiss_table {
+	int8_t *ctrl;		// array of control bytes, one per slot
+	Slot   *slots;		// array of slots holding keys (and values)
+	int ngroups;		// how many groups of slots (a power of two)
+	int size;			// how many slots (ngroups * GROUP_SIZE)
+	int load;			// number of keys in the table right now
+	int ndeleted;		// number of slots marked DELETED
+	double max_load;	// grow when load would exceed this fraction of size
+	int probes;			// total groups visited by insertions
+	int max_probe;		// most groups visited by any insertion
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// find the slots in the group starting at 'ctrl' whose control byte is 'byte'
+static Mask match_byte(const int8_t *ctrl, int8_t byte) {
+#ifdef __SSE2__
+	__m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(byte)));
+#else
+	Mask mask = 0;
+	int i;
+	for (i = 0; i < GROUP_SIZE; i++) {
+		if (ctrl[i] == byte) {
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+// find the free (EMPTY or DELETED) slots in the group starting at 'ctrl'
+static Mask match_free(const int8_t *ctrl) {
+#ifdef __SSE2__
+	// the free control bytes are the ones with their top bit set, which is
+	// exactly what movemask collects
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+	Mask mask = 0;
+	int i;
+	for (i = 0; i < GROUP_SIZE; i++) {
+		if (ctrl[i] < 0) {
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+// a key's tag is the low 7 bits of its hash value, and the rest of the hash
+// value chooses the first group to probe
+#define tag(hash) ((int8_t)((hash) & 0x7f))
+#define first_group(table, hash) \
+	((int)(((hash) >> 7) & ((table)->ngroups - 1)))
+
+// the group after group 'g' on the 'i'th step of a probe sequence. the steps
+// grow by one each time, which visits every group when there are a power of
+// two of them
+#define next_group(table, g, i) (((g) + (i) + 1) & ((table)->ngroups - 1))
+
+// set up the internals of a swiss table struct with 'ngroups' empty groups
+static void initialise_table(SwissHashTable *table, int ngroups) {
+	int size = ngroups * GROUP_SIZE;
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+
+	table->ctrl = malloc((sizeof *table->ctrl) * size);
+	assert(table->ctrl);
+	memset(table->ctrl, CTRL_EMPTY, (sizeof *table->ctrl) * size);
+	table->slots = malloc((sizeof *table->slots) * size);
+	assert(table->slots);
+
+	table->ngroups = ngroups;
+	table->size = size;
+	table->load = 0;
+	table->ndeleted = 0;
+	table->probes = 0;
+}
+
+// put 'key' into the first free slot along its probe sequence, without
+// checking whether it's already there or whether the table needs to grow
+// returns the slot it was put in
+static Slot *place_key(SwissHashTable *table, int64 key, int64 value,
+	int64 hash) {
+	int g = first_group(table, hash);
+	int i;
+	for (i = 0; i < table->ngroups; i++) {
+		int8_t *ctrl = &table->ctrl[g * GROUP_SIZE];
+		Mask spare = match_free(ctrl);
+		if (spare) {
+			int s = lowest_bit(spare);
+			if (ctrl[s] == CTRL_DELETED) {
+				table->ndeleted--;
+			}
+			ctrl[s] = tag(hash);
+
+			Slot *slot = &table->slots[g * GROUP_SIZE + s];
+			slot->key = key;
+			slot->value = value;
+			table->load++;
+
+			table->probes += i + 1;
+			if (i + 1 > table->max_probe) {
+				table->max_probe = i + 1;
+			}
+			return slot;
+		}
+		g = next_group(table, g, i);
+	}
+
+	// we only place keys once we know there's room, so we can't get here
+	assert(false && "error: no free slot in swiss table!");
+	return NULL;
+}
+
+// replace the internal arrays with 'ngroups' groups and re-hash all keys in
+// the old arrays (which also clears out any DELETED slots)
+static void resize_table(SwissHashTable *table, int ngroups) {
+	// no reader may be using the old arrays by the time they're freed
+	write_barrier();
+
+	int8_t *oldctrl = table->ctrl;
+	Slot *oldslots = table->slots;
+	int oldsize = table->size;
+
+	initialise_table(table, ngroups);
+
+	int i;
+	for (i = 0; i < oldsize; i++) {
+		if (oldctrl[i] >= 0) {
+			place_key(table, oldslots[i].key, oldslots[i].value,
+				h1_64(oldslots[i].key));
+		}
+	}
+
+	free(oldctrl);
+	free(oldslots);
+}
+
+// find the slot holding 'key' (whose hash value is 'hash') in 'table', or
+// NULL if it's not in there
+static Slot *find_slot(SwissHashTable *table, int64 key, int64 hash) {
+	int8_t t = tag(hash);
+	int g = first_group(table, hash);
+	int i;
+	for (i = 0; i < table->ngroups; i++) {
+		int8_t *ctrl = &table->ctrl[g * GROUP_SIZE];
+
+		// check the slots whose tags match
+		Mask match = match_byte(ctrl, t);
+		while (match) {
+			Slot *slot = &table->slots[g * GROUP_SIZE + lowest_bit(match)];
+			if (slot->key == key) {
+				return slot;
+			}
+			match &= match - 1;
+		}
+
+		// if this group has an EMPTY slot, the key would have gone there
+		// rather than any further along
+		if (match_byte(ctrl, CTRL_EMPTY)) {
+			return NULL;
+		}
+		g = next_group(table, g, i);
+	}
+	return NULL;
+}
+
+// insert 'key' (which must not be in 'table' already, and whose hash value
+// is 'hash') with value 'value', growing the table first if necessary
+static Slot *insert_new(SwissHashTable *table, int64 key, int64 value,
+	int64 hash) {
+
+	// DELETED slots lengthen probe sequences just like keys do, so count them
+	// towards the load too. if it's mostly DELETED slots taking the table over
+	// its maximum load, clearing them out is enough
+	if (table->load + table->ndeleted + 1 > table->max_load * table->size) {
+		if (table->load + 1 > table->max_load * table->size / 2) {
+			resize_table(table, table->ngroups * 2);
+		} else {
+			resize_table(table, table->ngroups);
+		}
+	}
+	return place_key(table, key, value, hash);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a swiss hash table with initial size 'size' (rounded up to a
+// power of two number of groups)
+SwissHashTable *new_swiss_hash_table(int size) {
+	SwissHashTable *table = malloc(sizeof *table);
+	assert(table);
+
+	table->max_load = DEFAULT_MAX_LOAD;
+	table->max_probe = 0;
+	initialise_table(table,
+		next_power_of_two((size + GROUP_SIZE - 1) / GROUP_SIZE));
+
+	return table;
+}
+
+
+// free all memory associated with 'table'
+void free_swiss_hash_table(SwissHashTable *table) {
+	assert(table != NULL);
+
+	free(table->ctrl);
+	free(table->slots);
+	free(table);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool swiss_hash_table_insert(SwissHashTable *table, int64 key) {
+	assert(table != NULL);
+
+	int64 hash = h1_64(key);
+	if (find_slot(table, key, hash)) {
+		return false;
+	}
+	insert_new(table, key, 0, hash);
+	return true;
+}
+
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool swiss_hash_table_lookup(SwissHashTable *table, int64 key) {
+	assert(table != NULL);
+	return find_slot(table, key, h1_64(key)) != NULL;
+}
+
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int swiss_hash_table_lookup_batch(SwissHashTable *table, int64 *keys, int n,
+	bool *results) {
+	assert(table != NULL);
+
+	int64 hashes[BATCH_GROUP];
+	int found = 0;
+	int i, j;
+	for (i = 0; i < n; i += BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// hash the whole group first, prefetching each key's first group of
+		// control bytes and slots
+		for (j = 0; j < group; j++) {
+			hashes[j] = h1_64(keys[i + j]);
+			int g = first_group(table, hashes[j]);
+			prefetch(&table->ctrl[g * GROUP_SIZE]);
+			prefetch(&table->slots[g * GROUP_SIZE]);
+		}
+		for (j = 0; j < group; j++) {
+			results[i + j] = find_slot(table, keys[i + j], hashes[j]) != NULL;
+			found += results[i + j];
+		}
+	}
+	return found;
+}
+
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool swiss_hash_table_put(SwissHashTable *table, int64 key, int64 value) {
+	assert(table != NULL);
+
+	int64 hash = h1_64(key);
+	Slot *slot = find_slot(table, key, hash);
+	if (slot) {
+		slot->value = value;
+		return false;
+	}
+	insert_new(table, key, value, hash);
+	return true;
+}
+
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool swiss_hash_table_get(SwissHashTable *table, int64 key, int64 *value) {
+	assert(table != NULL);
+
+	Slot *slot = find_slot(table, key, h1_64(key));
+	if (slot && value) {
+		*value = slot->value;
+	}
+	return slot != NULL;
+}
+
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool swiss_hash_table_get_or_insert(SwissHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table != NULL);
+
+	int64 hash = h1_64(key);
+	Slot *slot = find_slot(table, key, hash);
+	bool inserted = slot == NULL;
+	if (inserted) {
+		slot = insert_new(table, key, value, hash);
+	}
+	if (result) {
+		*result = slot->value;
+	}
+	return inserted;
+}
+
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool swiss_hash_table_delete(SwissHashTable *table, int64 key) {
+	assert(table != NULL);
+
+	Slot *slot = find_slot(table, key, h1_64(key));
+	if (slot == NULL) {
+		return false;
+	}
+
+	// a probe sequence only moves past a group once it is completely full,
+	// and a full group never gets an EMPTY slot back. so if this group still
+	// has an EMPTY slot, no key's probe sequence has gone past it, and this
+	// slot can be made EMPTY too. otherwise, it has to be marked DELETED so
+	// that lookups keep going past it
+	int s = slot - table->slots;
+	int8_t *group = &table->ctrl[s - s % GROUP_SIZE];
+	if (match_byte(group, CTRL_EMPTY)) {
+		table->ctrl[s] = CTRL_EMPTY;
+	} else {
+		table->ctrl[s] = CTRL_DELETED;
+		table->ndeleted++;
+	}
+	table->load--;
+	return true;
+}
+
+
+// print the contents of 'table' to stdout
+void swiss_hash_table_print(SwissHashTable *table) {
+	assert(table != NULL);
+
+	printf("--- table size: %d\n", table->size);
+
+	// print header
+	printf("   address |  tag | key\n");
+
+	// print the rows of the hash table, a group at a time
+	int i;
+	for (i = 0; i < table->size; i++) {
+		if (i % GROUP_SIZE == 0) {
+			printf("   group %d\n", i / GROUP_SIZE);
+		}
+		printf(" %9d | ", i);
+		if (table->ctrl[i] >= 0) {
+			printf("%4d | %llu\n", table->ctrl[i], table->slots[i].key);
+		} else if (table->ctrl[i] == CTRL_DELETED) {
+			printf("%4s | deleted\n", "-");
+		} else {
+			printf("%4s | -\n", "-");
+		}
+	}
+
+	printf("--- end table ---\n");
+}
+
+
+// print some statistics about 'table' to stdout
+void swiss_hash_table_stats(SwissHashTable *table) {
+	assert(table != NULL);
+	printf("--- table stats ---\n");
+
+	printf("current size: %d slots (%d groups of %d)\n", table->size,
+		table->ngroups, GROUP_SIZE);
+	printf("current load: %d items\n", table->load);
+	printf("     deleted: %d slots\n", table->ndeleted);
+	printf(" load factor: %.3f%%\n", table->load * 100.0 / table->size);
+	printf("    max load: %.3f%%\n", table->max_load * 100.0);
+	printf("   avg probe: %.3f groups\n",
+		table->load ? table->probes * 1.0 / table->load : 0.0);
+	printf("   max probe: %d groups\n", table->max_probe);
+#ifdef __SSE2__
+	printf("  group scan: sse2\n");
+#else
+	printf("  group scan: scalar\n");
+#endif
+	printf("--- end stats ---\n");
+}
+
+
+// return how many keys 'table' has space for without growing
+int swiss_hash_table_capacity(SwissHashTable *table) {
+	assert(table != NULL);
+	return table->size;
+}
+
+
+// set the load factor (between 0 and 1) above which 'table' will grow
+void swiss_hash_table_set_max_load(SwissHashTable *table, double max_load) {
+	assert(table != NULL);
+	assert(max_load > 0 && max_load <= 1);
+	table->max_load = max_load;
+}
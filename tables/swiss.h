@@ -0,0 +1,71 @@
+/* * * * * * * * *
+ * Dynamic hash table using open addressing over groups of 16 slots, with a
+ * byte of metadata per slot so that a whole group can be searched at once
+ * (in the style of Google's "Swiss tables")
+ *
+ * created for COMP20007 Design of Algorithms - Assignment 2, 2017
+ * by Wenqing Xue <wenqingx@student.unimelb.edu.au>
+ */
+
+#ifndef SWISS_H
+#define SWISS_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+
+typedef struct swiss_table SwissHashTable;
+
+// initialise a swiss hash table with room for at least 'size' keys
+SwissHashTable *new_swiss_hash_table(int size);
+
+// free all memory associated with 'table'
+void free_swiss_hash_table(SwissHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool swiss_hash_table_insert(SwissHashTable *table, int64 key);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool swiss_hash_table_lookup(SwissHashTable *table, int64 key);
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'. keys are hashed in groups, and the memory they
+// will probe is prefetched before any of them are probed
+// returns how many of the keys were found
+int swiss_hash_table_lookup_batch(SwissHashTable *table, int64 *keys, int n,
+	bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool swiss_hash_table_put(SwissHashTable *table, int64 key, int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool swiss_hash_table_get(SwissHashTable *table, int64 key, int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool swiss_hash_table_get_or_insert(SwissHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool swiss_hash_table_delete(SwissHashTable *table, int64 key);
+
+// print the contents of 'table' to stdout
+void swiss_hash_table_print(SwissHashTable *table);
+
+// print some statistics about 'table' to stdout
+void swiss_hash_table_stats(SwissHashTable *table);
+
+// return how many keys 'table' has space for without growing
+int swiss_hash_table_capacity(SwissHashTable *table);
+
+// set the load factor (between 0 and 1) above which 'table' will grow
+void swiss_hash_table_set_max_load(SwissHashTable *table, double max_load);
+
+#endif
@@ -8,14 +8,24 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <time.h>
 
 #include "xtndbl1.h"
+#include "slab.h"
+#include "seqlock.h"
 
 // macro to calculate the rightmost n bits of a number x
 #define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
 
+// macro to find the bucket that table address 'address' refers to
+#define bucket_at(table, address) \
+	((Bucket *)slab_item((table)->slab, (table)->buckets[address]))
+
+// an entry of the shallow array whose bucket uses more bits than it has
+#define DEEP UINT32_MAX
+
 // a bucket stores a single key (full=true) or is empty (full=false)
 // it also knows how many bits are shared between possible keys, and the first 
 // table address that references it
@@ -25,23 +35,33 @@ typedef struct bucket {
 	int depth;	// how many hash value bits are being used by this bucket
 	bool full;	// does this bucket contain a key
 	int64 key;	// the key stored in this bucket
+	int64 value;// the value that key maps to
 } Bucket;
 
 // helper structure to store statistics gathered
 typedef struct stats {
 	int nbuckets;	// how many distinct buckets does the table point to
 	int nkeys;		// how many keys are being stored in the table
-	int time;		// how much CPU time has been used to insert/lookup keys
+	int time;		// how much CPU time has been used to insert/delete keys
 					// in this table
 } Stats;
 
-// a hash table is an array of slots pointing to buckets holding up to 1 key,
+// a hash table is an array of slots referring to buckets holding up to 1 key,
 // along with some usage statistics and information about the number of hash
-// value bits to use for addressing
+// value bits to use for addressing. the slots hold 32-bit bucket indices into
+// the table's slab rather than pointers, halving the size of the array
 struct xtndbl1_table {
-	Bucket **buckets;	// array of pointers to buckets
-	int size;			// how many entries in the table of pointers (2^depth)
+	uint32_t *buckets;	// array of bucket indices (into 'slab')
+	int size;			// how many entries in the table of indices (2^depth)
 	int depth;			// how many bits of the hash value to use (log2(size))
+	int shallow;		// lookups first try the shallow array below, if this
+						// is fewer than 'depth' (0 = off)
+	uint32_t *shallow_buckets;	// 2^shallow entries: the bucket every
+						// address ending in an entry's bits refers to, if
+						// it uses no more than 'shallow' bits, or else DEEP
+	int nmaxdepth;		// how many buckets use all 'depth' bits (when none do,
+						// the table of pointers can be halved)
+	Slab *slab;			// where the buckets are allocated from
 	Stats stats;		// collection of statistics about this hash table
 };
 
@@ -49,46 +69,93 @@ struct xtndbl1_table {
  * helper functions
  */
 
-// create a new bucket first referenced from 'first_address', based on 'depth'
-// bits of its keys' hash values
-static Bucket *new_bucket(int first_address, int depth) {
-	Bucket *bucket = malloc(sizeof *bucket);
-	assert(bucket);
+// create a new bucket (from 'slab') first referenced from 'first_address',
+// based on 'depth' bits of its keys' hash values
+// returns the new bucket's index in 'slab'
+static uint32_t new_bucket(Slab *slab, int first_address, int depth) {
+	uint32_t index = slab_alloc(slab);
+	Bucket *bucket = slab_item(slab, index);
 
 	bucket->id = first_address;
 	bucket->depth = depth;
 	bucket->full = false;
 
-	return bucket;
+	return index;
 }
 
-// double the table of bucket pointers, duplicating the bucket pointers in the
-// first half into the new second half of the table
+// double the table of bucket indices, duplicating the indices in the first
+// half into the new second half of the table
 static void double_table(Xtndbl1HashTable *table) {
 	int size = table->size * 2;
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
-	// get a new array of twice as many bucket pointers, and copy pointers down
+	// get a new array of twice as many bucket indices, and copy the first
+	// half down in one go (once no reader is using the old array)
+	write_barrier();
 	table->buckets = realloc(table->buckets, (sizeof *table->buckets) * size);
 	assert(table->buckets);
-	int i;
-	for (i = 0; i < table->size; i++) {
-		table->buckets[table->size + i] = table->buckets[i];
-	}
+	memcpy(table->buckets + table->size, table->buckets,
+		(sizeof *table->buckets) * table->size);
 
 	// finally, increase the table size and the depth we are using to hash keys
 	table->size = size;
 	table->depth++;
+
+	// no bucket uses all of the new depth's bits yet
+	table->nmaxdepth = 0;
+}
+
+// halve the table of bucket indices. only valid when no bucket uses all of
+// the table's bits, so that the second half is a copy of the first half
+static void halve_table(Xtndbl1HashTable *table) {
+	write_barrier();
+	table->size /= 2;
+	table->depth--;
+	table->buckets = realloc(table->buckets, (sizeof *table->buckets)
+		* table->size);
+	assert(table->buckets);
+
+	// count the buckets which use all of the (now fewer) bits
+	table->nmaxdepth = 0;
+	int i;
+	for (i = 0; i < table->size; i++) {
+		if (bucket_at(table, i)->id == i
+				&& bucket_at(table, i)->depth == table->depth) {
+			table->nmaxdepth++;
+		}
+	}
 }
 
 // reinsert a key into the hash table after splitting a bucket --- we can assume
 // that there will definitely be space for this key because it was already
 // inside the hash table previously
 // use 'xtndbl1_hash_table_insert()' instead for inserting new keys
-static void reinsert_key(Xtndbl1HashTable *table, int64 key) {
-	int address = rightmostnbits(table->depth, h1(key));
-	table->buckets[address]->key = key;
-	table->buckets[address]->full = true;
+static void reinsert_key(Xtndbl1HashTable *table, int64 key, int64 value) {
+	int address = rightmostnbits(table->depth, h1_64(key));
+	bucket_at(table, address)->key = key;
+	bucket_at(table, address)->value = value;
+	bucket_at(table, address)->full = true;
+}
+
+// record in the shallow array of 'table' (if any) where the bucket at index
+// 'index' of the slab is found, after its depth has changed
+static void note_shallow(Xtndbl1HashTable *table, uint32_t index) {
+	if (!table->shallow) {
+		return;
+	}
+	Bucket *bucket = slab_item(table->slab, index);
+	if (bucket->depth > table->shallow) {
+		// too deep: lookups ending in the shallow bits its id ends in must
+		// use the full table
+		table->shallow_buckets[rightmostnbits(table->shallow, bucket->id)]
+			= DEEP;
+		return;
+	}
+	// every address ending in its (depth bits of) id refers to it
+	int a;
+	for (a = bucket->id; a < 1 << table->shallow; a += 1 << bucket->depth) {
+		table->shallow_buckets[a] = index;
+	}
 }
 
 // split the bucket in 'table' at address 'address', growing table if necessary
@@ -96,7 +163,7 @@ static void split_bucket(Xtndbl1HashTable *table, int address) {
 	
 	// FIRST,
 	// do we need to grow the table?
-	if (table->buckets[address]->depth == table->depth) {
+	if (bucket_at(table, address)->depth == table->depth) {
 		// yep, this bucket is down to its last pointer
 		double_table(table);
 	}
@@ -105,7 +172,7 @@ static void split_bucket(Xtndbl1HashTable *table, int address) {
 
 	// SECOND,
 	// create a new bucket and update both buckets' depth
-	Bucket *bucket = table->buckets[address];
+	Bucket *bucket = bucket_at(table, address);
 	int depth = bucket->depth;
 	int first_address = bucket->id;
 
@@ -114,8 +181,12 @@ static void split_bucket(Xtndbl1HashTable *table, int address) {
 
 	// new bucket's first address will be a 1 bit plus the old first address
 	int new_first_address = 1 << depth | first_address;
-	Bucket *newbucket = new_bucket(new_first_address, new_depth);
+	uint32_t newbucket = new_bucket(table->slab, new_first_address, new_depth);
 	table->stats.nbuckets++;
+	if (new_depth == table->depth) {
+		// both halves of the split bucket now use all of the table's bits
+		table->nmaxdepth += 2;
+	}
 	
 	// THIRD,
 	// redirect every second address pointing to this bucket to the new bucket
@@ -137,18 +208,73 @@ static void split_bucket(Xtndbl1HashTable *table, int address) {
 		// construct address by joining this prefix and the suffix
 		int a = (prefix << new_depth) | suffix;
 
-		// redirect this table entry to point at the new bucket
+		// redirect this table entry to refer to the new bucket
 		table->buckets[a] = newbucket;
 	}
+	note_shallow(table, table->buckets[first_address]);
+	note_shallow(table, newbucket);
 
 	// FINALLY,
 	// filter the key from the old bucket into its rightful place in the new 
 	// table (which may be the old bucket, or may be the new bucket)
 
 	// remove and reinsert the key
-	int64 key = bucket->key;
 	bucket->full = false;
-	reinsert_key(table, key);
+	reinsert_key(table, bucket->key, bucket->value);
+}
+
+// merge the bucket at address 'address' with its 'buddy' (the bucket it was
+// split from or split off) for as long as their keys fit into one bucket,
+// and then halve the table for as long as no bucket needs all of its bits
+// (this is the reverse of 'split_bucket()' and 'double_table()')
+static void merge_buckets(Xtndbl1HashTable *table, int address) {
+	Bucket *bucket = bucket_at(table, address);
+
+	while (bucket->depth > 0) {
+		// the buddy's first address differs from this bucket's only in the
+		// highest of the bits they use. we can only merge if the buddy hasn't
+		// been split further, and if there's only one key between them
+		int depth = bucket->depth;
+		Bucket *buddy = bucket_at(table, bucket->id ^ (1 << (depth - 1)));
+		if (buddy->depth != depth || (bucket->full && buddy->full)) {
+			break;
+		}
+
+		// keep the bucket with the lower first address, and move the buddy's
+		// key (if any) into it
+		if (buddy->id < bucket->id) {
+			Bucket *tmp = bucket;
+			bucket = buddy;
+			buddy = tmp;
+		}
+		if (buddy->full) {
+			bucket->key = buddy->key;
+			bucket->value = buddy->value;
+			bucket->full = true;
+		}
+
+		// redirect every address referring to the buddy (these are all of the
+		// addresses ending in the buddy's first address) to the kept bucket
+		uint32_t kept = table->buckets[bucket->id];
+		uint32_t freed = table->buckets[buddy->id];
+		int maxprefix = 1 << (table->depth - depth);
+		int prefix;
+		for (prefix = 0; prefix < maxprefix; prefix++) {
+			table->buckets[(prefix << depth) | buddy->id] = kept;
+		}
+
+		if (depth == table->depth) {
+			table->nmaxdepth -= 2;
+		}
+		bucket->depth = depth - 1;
+		note_shallow(table, kept);
+		slab_free(table->slab, freed);
+		table->stats.nbuckets--;
+	}
+
+	while (table->depth > 0 && table->nmaxdepth == 0) {
+		halve_table(table);
+	}
 }
 
 
@@ -164,8 +290,12 @@ Xtndbl1HashTable *new_xtndbl1_hash_table() {
 	table->size = 1;
 	table->buckets = malloc(sizeof *table->buckets);
 	assert(table->buckets);
-	table->buckets[0] = new_bucket(0, 0);
+	table->slab = new_slab(sizeof (Bucket));
+	table->buckets[0] = new_bucket(table->slab, 0, 0);
 	table->depth = 0;
+	table->shallow = 0;
+	table->shallow_buckets = NULL;
+	table->nmaxdepth = 1;
 
 	table->stats.nbuckets = 1;
 	table->stats.nkeys = 0;
@@ -179,42 +309,55 @@ Xtndbl1HashTable *new_xtndbl1_hash_table() {
 void free_xtndbl1_hash_table(Xtndbl1HashTable *table) {
 	assert(table);
 
-	// loop backwards through the array of pointers, freeing buckets only as we
-	// reach their first reference
-	// (if we loop through forwards, we wouldn't know which reference was last)
-	int i;
-	for (i = table->size-1; i >= 0; i--) {
-		if (table->buckets[i]->id == i) {
-			free(table->buckets[i]);
-		}
-	}
+	// the buckets all came from the slab, so they can be freed in one go
+	free_slab(table->slab);
 
-	// free the array of bucket pointers
+	// free the array of bucket indices
 	free(table->buckets);
+	free(table->shallow_buckets);
 	
 	// free the table struct itself
 	free(table);
 }
 
 
-// insert 'key' into 'table', if it's not in there already
-// returns true if insertion succeeds, false if it was already in there
-bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key) {
-	assert(table);
-	int start_time = clock(); // start timing
+// find the bucket that keys with hash value 'hash' belong in. if shallow
+// lookups are on, first try the shallow array, which holds the bucket itself
+// whenever it uses few enough bits (and is small enough to stay cached), so
+// that the table isn't read at all
+static Bucket *hash_bucket(Xtndbl1HashTable *table, int64 hash) {
+	if (table->shallow && table->shallow < table->depth) {
+		uint32_t index =
+			table->shallow_buckets[rightmostnbits(table->shallow, hash)];
+		if (index != DEEP) {
+			return slab_item(table->slab, index);
+		}
+	}
+	return bucket_at(table, rightmostnbits(table->depth, hash));
+}
+
+// find the bucket holding 'key' in 'table', or NULL if it's not in there
+// (lookups may run on several threads at once, so this writes nothing to the
+// table, not even the timing statistics)
+static Bucket *find_bucket(Xtndbl1HashTable *table, int64 key) {
+	// look for the key in its bucket (unless it's empty)
+	Bucket *bucket = hash_bucket(table, h1_64(key));
+	if (!bucket->full || bucket->key != key) {
+		bucket = NULL;
+	}
+	return bucket;
+}
+
+// insert 'key' (which must not be in 'table' already) with value 'value'
+static void insert_new(Xtndbl1HashTable *table, int64 key, int64 value) {
+	int start_time = timer_start(); // start timing
 	
 	// calculate table address
-	int hash = h1(key);
+	int64 hash = h1_64(key);
 	int address = rightmostnbits(table->depth, hash);
-	
-	// is this key already there?
-	if (table->buckets[address]->full && table->buckets[address]->key == key) {
-		table->stats.time += clock() - start_time; // add time elapsed
-		return false;
-	}
 
-	// if not, make space in the table until our target bucket has space
-	while (table->buckets[address]->full) {
+	// make space in the table until our target bucket has space
+	while (bucket_at(table, address)->full) {
 		split_bucket(table, address);
 
 		// and recalculate address because we might now need more bits
@@ -222,14 +365,28 @@ bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key) {
 	}
 
 	// there's now space! we can insert this key
-	table->buckets[address]->key = key;
-	table->buckets[address]->full = true;
+	bucket_at(table, address)->key = key;
+	bucket_at(table, address)->value = value;
+	bucket_at(table, address)->full = true;
 	table->stats.nkeys++;
 
-	printf("address: %d\n", address);
-	printf("depth:   %d\n", table->depth);
-	// add time elapsed to total CPU time before returning
-	table->stats.time += clock() - start_time;
+	// add time elapsed to total CPU time
+	timer_add(table->stats.time, start_time);
+}
+
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key) {
+	assert(table);
+
+	// is this key already there?
+	if (find_bucket(table, key)) {
+		return false;
+	}
+
+	// if not, insert it
+	insert_new(table, key, 0);
 	return true;
 }
 
@@ -238,20 +395,117 @@ bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key) {
 // returns true if found, false if not
 bool xtndbl1_hash_table_lookup(Xtndbl1HashTable *table, int64 key) {
 	assert(table);
-	int start_time = clock(); // start timing
+	return find_bucket(table, key) != NULL;
+}
+
+
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int xtndbl1_hash_table_lookup_batch(Xtndbl1HashTable *table, int64 *keys,
+	int n, bool *results) {
+	assert(table);
+
+	uint32_t *entries[BATCH_GROUP];
+	Bucket *buckets[BATCH_GROUP];
+	int found = 0;
+	int i, j;
+	for (i = 0; i < n; i += BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// reaching a bucket takes two dependent loads (table entry, then the
+		// bucket it refers to), so prefetch the whole group a level at a time
+		for (j = 0; j < group; j++) {
+			int address = rightmostnbits(table->depth, h1_64(keys[i + j]));
+			entries[j] = &table->buckets[address];
+			prefetch(entries[j]);
+		}
+		for (j = 0; j < group; j++) {
+			buckets[j] = slab_item(table->slab, *entries[j]);
+			prefetch(buckets[j]);
+		}
+
+		// now look for each key in its bucket
+		for (j = 0; j < group; j++) {
+			results[i + j] = buckets[j]->full && buckets[j]->key == keys[i + j];
+			found += results[i + j];
+		}
+	}
+	return found;
+}
+
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xtndbl1_hash_table_put(Xtndbl1HashTable *table, int64 key, int64 value) {
+	assert(table);
+
+	Bucket *bucket = find_bucket(table, key);
+	if (bucket) {
+		bucket->value = value;
+		return false;
+	}
+	insert_new(table, key, value);
+	return true;
+}
+
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool xtndbl1_hash_table_get(Xtndbl1HashTable *table, int64 key, int64 *value) {
+	assert(table);
+
+	Bucket *bucket = find_bucket(table, key);
+	if (bucket && value) {
+		*value = bucket->value;
+	}
+	return bucket != NULL;
+}
+
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool xtndbl1_hash_table_get_or_insert(Xtndbl1HashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table);
+
+	Bucket *bucket = find_bucket(table, key);
+	if (bucket) {
+		value = bucket->value;
+	} else {
+		insert_new(table, key, value);
+	}
+	if (result) {
+		*result = value;
+	}
+	return bucket == NULL;
+}
+
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool xtndbl1_hash_table_delete(Xtndbl1HashTable *table, int64 key) {
+	assert(table);
+	int start_time = timer_start(); // start timing
 
 	// calculate table address for this key
-	int address = rightmostnbits(table->depth, h1(key));
-	
-	// look for the key in that bucket (unless it's empty)
+	int address = rightmostnbits(table->depth, h1_64(key));
+
+	// is the key there?
 	bool found = false;
-	if (table->buckets[address]->full) {
-		// found it?
-		found = table->buckets[address]->key == key;
+	if (bucket_at(table, address)->full && bucket_at(table, address)->key == key) {
+		// remove it, and then merge now-empty buckets back together
+		bucket_at(table, address)->full = false;
+		table->stats.nkeys--;
+		merge_buckets(table, address);
+		found = true;
 	}
 
 	// add time elapsed to total CPU time before returning result
-	table->stats.time += clock() - start_time;
+	timer_add(table->stats.time, start_time);
 	return found;
 }
 
@@ -269,13 +523,13 @@ void xtndbl1_hash_table_print(Xtndbl1HashTable *table) {
 	int i;
 	for (i = 0; i < table->size; i++) {
 		// table entry
-		printf("%9d | %-9d ", i, table->buckets[i]->id);
+		printf("%9d | %-9d ", i, bucket_at(table, i)->id);
 
 		// if this is the first address at which a bucket occurs, print it
-		if (table->buckets[i]->id == i) {
-			printf("%9d ", table->buckets[i]->id);
-			if (table->buckets[i]->full) {
-				printf("[%llu]", table->buckets[i]->key);
+		if (bucket_at(table, i)->id == i) {
+			printf("%9d ", bucket_at(table, i)->id);
+			if (bucket_at(table, i)->full) {
+				printf("[%llu]", bucket_at(table, i)->key);
 			} else {
 				printf("[ ]");
 			}
@@ -299,10 +553,50 @@ void xtndbl1_hash_table_stats(Xtndbl1HashTable *table) {
 	printf("current table size: %d\n", table->size);
 	printf("    number of keys: %d\n", table->stats.nkeys);
 	printf(" number of buckets: %d\n", table->stats.nbuckets);
+	printf("     bucket memory: %zu bytes\n", slab_bytes(table->slab));
+	printf("  directory memory: %zu bytes\n",
+		(sizeof *table->buckets) * table->size);
 
 	// also calculate CPU usage in seconds and print this
+#ifdef TABLE_TIMING
 	float seconds = table->stats.time * 1.0 / CLOCKS_PER_SEC;
 	printf("    CPU time spent: %.6f sec\n", seconds);
+#else
+	printf("    CPU time spent: not timed (build with -DTABLE_TIMING)\n");
+#endif
 	
 	printf("--- end stats ---\n");
 }
+
+// return how many keys 'table' has space for without growing
+int xtndbl1_hash_table_capacity(Xtndbl1HashTable *table) {
+	assert(table);
+	return table->stats.nbuckets;
+}
+
+// have lookups in 'table' first try an array of the buckets using at most
+// 'depth' hash value bits, or turn this off with depth 0
+void xtndbl1_hash_table_set_shallow_depth(Xtndbl1HashTable *table, int depth) {
+	assert(table && depth >= 0);
+
+	// (readers may be using the old array)
+	write_barrier();
+	free(table->shallow_buckets);
+	table->shallow_buckets = NULL;
+	table->shallow = depth;
+	if (!depth) {
+		return;
+	}
+
+	// fill in the shallow array from the table: each entry's bucket is the
+	// one its bits lead to (repeating the table if it uses fewer bits)
+	int size = 1 << depth;
+	table->shallow_buckets = malloc((sizeof *table->shallow_buckets) * size);
+	assert(table->shallow_buckets);
+	int a;
+	for (a = 0; a < size; a++) {
+		uint32_t index = table->buckets[a & (table->size - 1)];
+		table->shallow_buckets[a] = ((Bucket *)slab_item(table->slab,
+			index))->depth <= depth ? index : DEEP;
+	}
+}
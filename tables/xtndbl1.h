@@ -28,10 +28,48 @@ bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key);
 // returns true if found, false if not
 bool xtndbl1_hash_table_lookup(Xtndbl1HashTable *table, int64 key);
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'. keys are hashed in groups, and the memory they
+// will probe is prefetched before any of them are probed
+// returns how many of the keys were found
+int xtndbl1_hash_table_lookup_batch(Xtndbl1HashTable *table, int64 *keys, int n,
+	bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xtndbl1_hash_table_put(Xtndbl1HashTable *table, int64 key, int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool xtndbl1_hash_table_get(Xtndbl1HashTable *table, int64 key, int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool xtndbl1_hash_table_get_or_insert(Xtndbl1HashTable *table, int64 key,
+	int64 value, int64 *result);
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool xtndbl1_hash_table_delete(Xtndbl1HashTable *table, int64 key);
+
 // print the contents of 'table' to stdout
 void xtndbl1_hash_table_print(Xtndbl1HashTable *table);
 
 // print some statistics about 'table' to stdout
 void xtndbl1_hash_table_stats(Xtndbl1HashTable *table);
 
+// return how many keys 'table' has space for without growing
+int xtndbl1_hash_table_capacity(Xtndbl1HashTable *table);
+
+// have lookups in 'table' first try a separate array of 2^'depth' entries
+// (small enough to stay cached), indexed by the last 'depth' hash value bits,
+// which holds each bucket using no more bits than that. lookups whose
+// bucket is in there skip the table altogether, and the rest fall back to
+// it. this pays off when most buckets are much shallower than the table.
+// depth 0 (the default) turns this off
+void xtndbl1_hash_table_set_shallow_depth(Xtndbl1HashTable *table, int depth);
+
 #endif
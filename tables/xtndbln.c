@@ -8,15 +8,38 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <time.h>
 
 #include "xtndbln.h"
+#include "slab.h"
+#include "seqlock.h"
+#include "parallel.h"
 
 // macro to calculate the rightmost n bits of a number x
 #define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
 
-// a bucket stores an array of keys
+// a parallel build splits the table into (a power of two) ranges of
+// addresses, at least this many per thread, so that threads which finish
+// their ranges early can take on more
+#define RANGES_PER_THREAD 8
+
+// macro to find the bucket that table address 'address' refers to
+#define bucket_at(table, address) \
+	((Bucket *)slab_item((table)->slab, (table)->buckets[address]))
+
+// an entry of the shallow array whose bucket uses more bits than it has
+#define DEEP UINT32_MAX
+
+// an entry is a key stored in a bucket, along with the value it maps to
+typedef struct entry {
+	int64 key;
+	int64 value;
+} Entry;
+
+// a bucket stores an array of entries, inline right after its other fields
+// (so reaching them doesn't take another pointer)
 // it also knows how many bits are shared between possible keys, and the first 
 // table address that references it
 typedef struct xtndbln_bucket {
@@ -24,82 +47,153 @@ typedef struct xtndbln_bucket {
 					// in the table which points to it
 	int depth;		// how many hash value bits are being used by this bucket
 	int nkeys;		// number of keys currently contained in this bucket
-	int64 *keys;	// the keys stored in this bucket
+	Entry entries[];// the keys (and values) stored in this bucket
 } Bucket;
 
 // helper structure to store statistics gathered
 typedef struct stats {
 	int nbuckets;	// how many distinct buckets does the table point to
 	int nkeys;		// how many keys are being stored in the table
-	int time;		// how much CPU time has been used to insert/lookup keys
+	int time;		// how much CPU time has been used to insert/delete keys
 					// in this table
 } Stats;
 
-// a hash table is an array of slots pointing to buckets holding up to 
+// a hash table is an array of slots referring to buckets holding up to 
 // bucketsize keys, along with some information about the number of hash value 
-// bits to use for addressing
+// bits to use for addressing. slots hold 32-bit indices of buckets in the slab
 struct xtndbln_table {
-	Bucket **buckets;	// array of pointers to buckets
-	int size;			// how many entries in the table of pointers (2^depth)
+	uint32_t *buckets;	// array of bucket indices (into 'slab')
+	int size;			// how many entries in the table of indices (2^depth)
 	int depth;			// how many bits of the hash value to use (log2(size))
+	int shallow;		// lookups first try the shallow array below, if this
+						// is fewer than 'depth' (0 = off)
+	uint32_t *shallow_buckets;	// 2^shallow entries: the bucket every
+						// address ending in an entry's bits refers to, if
+						// it uses no more than 'shallow' bits, or else DEEP
 	int bucketsize;		// maximum number of keys per bucket
+	int nmaxdepth;		// how many buckets use all 'depth' bits (when none do,
+						// the table of pointers can be halved)
+	int mindepth;		// the table isn't halved below this many bits (the
+						// depth a batch or build grew it to up front)
+	Slab *slab;			// where the buckets (of bucketsize entries) are
+						// allocated from
 	Stats stats;		// collection of statistics about this hash table
 };
 
+// what each thread building part of a table keeps track of (see
+// xtndbln_hash_table_build_parallel())
+typedef struct builder {
+	int nkeys;			// how many keys the thread placed
+	int64 *overflow;	// keys the thread couldn't place in their bucket
+	int noverflow;
+	int capacity;		// how many keys 'overflow' has room for
+} Builder;
+
+// what the threads building a table between them share
+typedef struct build {
+	XtndblNHashTable *table;
+	Partition partition;	// the keys, grouped by range
+	int shift;				// a key's range is its address >> shift
+	int next;				// the next range no thread has claimed yet
+	Builder *builders;		// one per thread
+} Build;
+
 /******************************* HELP FUNCTION *******************************/
-static Bucket *new_bucket(int first_address, int depth, int bucketsize);
+static uint32_t new_bucket(Slab *slab, int first_address, int depth);
+static void grow_table(XtndblNHashTable *table, int depth);
 static void double_table(XtndblNHashTable * table);
-static void reinsert_key(XtndblNHashTable *table, int64 key);
+static void reinsert_key(XtndblNHashTable *table, int64 key, int64 value);
 static void split_bucket(XtndblNHashTable *table, int address);
+static void halve_table(XtndblNHashTable *table);
+static void merge_buckets(XtndblNHashTable *table, int address);
+static Bucket *hash_bucket(XtndblNHashTable *table, int64 hash);
+static Entry *find_entry_hashed(XtndblNHashTable *table, int64 key,
+	int64 hash);
+static Entry *find_entry(XtndblNHashTable *table, int64 key);
+static void insert_hashed(XtndblNHashTable *table, int64 key, int64 value,
+	int64 hash);
+static void insert_new(XtndblNHashTable *table, int64 key, int64 value);
 /****************************************************************************/
 
-// create a new bucket with size of bucketsize
+// create a new bucket from 'slab', whose items have room for bucketsize
+// entries, and return its index
 // the code was sourced from "xtndbl1.c"
-static Bucket *new_bucket(int first_address, int depth, int bucketsize) {
-	Bucket *bucket = malloc(sizeof *bucket);
-	assert(bucket);
+static uint32_t new_bucket(Slab *slab, int first_address, int depth) {
+	uint32_t index = slab_alloc(slab);
+	Bucket *bucket = slab_item(slab, index);
 
 	bucket->id = first_address;
 	bucket->depth = depth;
 	bucket->nkeys = 0;
-	bucket->keys = malloc((sizeof *bucket->keys) * bucketsize);
-	assert(bucket->keys);
 
-	return bucket;
+	return index;
 }
 
-// the code was sourced from "xtndbl1.c"
-static void double_table(XtndblNHashTable * table) {
-	int size = table->size * 2;
+// grow the table of bucket indices to use 'depth' bits in one step, filling
+// each new entry with a copy of the entry sharing its lower bits (so each
+// doubling copies the whole of the table so far)
+static void grow_table(XtndblNHashTable *table, int depth) {
+	int size = 1 << depth;
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
+	// (the array may move, so no reader can be part way through it)
+	write_barrier();
 	table->buckets = realloc(table->buckets, (sizeof *table->buckets) * size);
 	assert(table->buckets);
 
-	int i;
-	for (i=0; i<table->size; i++) {
-		table->buckets[table->size+i] = table->buckets[i];
+	int n;
+	for (n=table->size; n<size; n*=2) {
+		memcpy(table->buckets + n, table->buckets, (sizeof *table->buckets) * n);
 	}
 
 	table->size = size;
-	table->depth++;
+	table->depth = depth;
+	table->nmaxdepth = 0;
+}
+
+// the code was sourced from "xtndbl1.c"
+static void double_table(XtndblNHashTable * table) {
+	grow_table(table, table->depth + 1);
 }
 
 // the code was sourced from "xtndbl1.c"
 // since the array starts from 0, nkeys is used in insertion
-static void reinsert_key(XtndblNHashTable *table, int64 key) {
-	int address = rightmostnbits(table->depth, h1(key));
-	int order = table->buckets[address]->nkeys;
-	table->buckets[address]->keys[order] = key;
-	table->buckets[address]->nkeys++;
+static void reinsert_key(XtndblNHashTable *table, int64 key, int64 value) {
+	int address = rightmostnbits(table->depth, h1_64(key));
+	int order = bucket_at(table, address)->nkeys;
+	bucket_at(table, address)->entries[order].key = key;
+	bucket_at(table, address)->entries[order].value = value;
+	bucket_at(table, address)->nkeys++;
+}
+
+// record in the shallow array of 'table' (if any) where the bucket at index
+// 'index' of the slab is found, after its depth has changed
+// the code was sourced from "xtndbl1.c"
+static void note_shallow(XtndblNHashTable *table, uint32_t index) {
+	if (!table->shallow) {
+		return;
+	}
+	Bucket *bucket = slab_item(table->slab, index);
+	if (bucket->depth > table->shallow) {
+		// too deep: lookups ending in the shallow bits its id ends in must
+		// use the full table
+		table->shallow_buckets[rightmostnbits(table->shallow, bucket->id)]
+			= DEEP;
+		return;
+	}
+	// every address ending in its (depth bits of) id refers to it
+	int a;
+	for (a = bucket->id; a < 1 << table->shallow; a += 1 << bucket->depth) {
+		table->shallow_buckets[a] = index;
+	}
 }
 
 // the code was sourced from "xtndbl1.c"
 static void split_bucket(XtndblNHashTable *table, int address) {
-	if (table->buckets[address]->depth == table->depth) {
+	if (bucket_at(table, address)->depth == table->depth) {
 		double_table(table);
 	}
-	Bucket *bucket = table->buckets[address];
+	Bucket *bucket = bucket_at(table, address);
 	int depth = bucket->depth;
 	int first_address = bucket->id;
 
@@ -107,8 +201,11 @@ static void split_bucket(XtndblNHashTable *table, int address) {
 	bucket->depth = new_depth;
 
 	int new_first_address = 1 << depth | first_address;
-	Bucket *newbucket = new_bucket(new_first_address, new_depth, table->bucketsize);
+	uint32_t newbucket = new_bucket(table->slab, new_first_address, new_depth);
 	table->stats.nbuckets++;
+	if (new_depth == table->depth) {
+		table->nmaxdepth += 2;
+	}
 
 	int bit_address = rightmostnbits(depth, first_address);
 	int suffix = (1 << depth) | bit_address;
@@ -120,17 +217,92 @@ static void split_bucket(XtndblNHashTable *table, int address) {
 		int a = (prefix << new_depth) | suffix;
 		table->buckets[a] = newbucket;
 	}
+	note_shallow(table, table->buckets[first_address]);
+	note_shallow(table, newbucket);
 	// record the nkeys
 	int num = bucket->nkeys;
 	int i;
-	int64 key;
+	Entry entry;
 	// reset the nkeys
 	bucket->nkeys = 0;
 
 	// reinsert all the keys
 	for (i=0; i<num; i++) {
-		key = bucket->keys[i];
-		reinsert_key(table, key);
+		entry = bucket->entries[i];
+		reinsert_key(table, entry.key, entry.value);
+	}
+}
+
+// halve the table of bucket indices, once no bucket uses all of its bits
+// the code was sourced from "xtndbl1.c"
+static void halve_table(XtndblNHashTable *table) {
+	write_barrier();
+	table->size /= 2;
+	table->depth--;
+	table->buckets = realloc(table->buckets, (sizeof *table->buckets)
+		* table->size);
+	assert(table->buckets);
+
+	table->nmaxdepth = 0;
+	int i;
+	for (i=0; i<table->size; i++) {
+		if (bucket_at(table, i)->id == i
+				&& bucket_at(table, i)->depth == table->depth) {
+			table->nmaxdepth++;
+		}
+	}
+}
+
+// merge the bucket at 'address' with its buddy while they are at most half
+// full between them (leaving room, so that a merge isn't undone by the very
+// next insert), then, if that left no bucket needing all of the table's bits,
+// halve the table while that stays true
+// the code was sourced from "xtndbl1.c"
+static void merge_buckets(XtndblNHashTable *table, int address) {
+	Bucket *bucket = bucket_at(table, address);
+	bool lowered = false;	// did a merge lower a bucket using all the bits?
+
+	while (bucket->depth > 0) {
+		int depth = bucket->depth;
+		Bucket *buddy = bucket_at(table, bucket->id ^ (1 << (depth-1)));
+		if (buddy->depth != depth
+				|| 2 * (bucket->nkeys + buddy->nkeys) > table->bucketsize) {
+			break;
+		}
+
+		if (buddy->id < bucket->id) {
+			Bucket *tmp = bucket;
+			bucket = buddy;
+			buddy = tmp;
+		}
+		int i;
+		for (i=0; i<buddy->nkeys; i++) {
+			bucket->entries[bucket->nkeys++] = buddy->entries[i];
+		}
+
+		uint32_t kept = table->buckets[bucket->id];
+		uint32_t freed = table->buckets[buddy->id];
+		int maxprefix = 1 << (table->depth - depth);
+		int prefix;
+		for (prefix=0; prefix<maxprefix; prefix++) {
+			table->buckets[(prefix << depth) | buddy->id] = kept;
+		}
+
+		if (depth == table->depth) {
+			table->nmaxdepth -= 2;
+			lowered = true;
+		}
+		bucket->depth = depth - 1;
+		note_shallow(table, kept);
+		slab_free(table->slab, freed);
+		table->stats.nbuckets--;
+	}
+
+	// (a table grown up front has no bucket using all of its bits yet, but
+	// that's no reason to shrink it back down)
+	while (lowered && table->depth > table->mindepth
+			&& table->nmaxdepth == 0) {
+		halve_table(table);
 	}
 }
 
@@ -144,9 +316,14 @@ XtndblNHashTable *new_xtndbln_hash_table(int bucketsize) {
 	table->buckets = malloc(sizeof *table->buckets);
 	assert(table->buckets);
 	// initially the size of bucket is 1
-	table->buckets[0] = new_bucket(0, 0, bucketsize);
+	table->slab = new_slab(sizeof (Bucket) + (sizeof (Entry)) * bucketsize);
+	table->buckets[0] = new_bucket(table->slab, 0, 0);
 	table->depth = 0;
+	table->shallow = 0;
+	table->shallow_buckets = NULL;
 	table->bucketsize = bucketsize;
+	table->nmaxdepth = 1;
+	table->mindepth = 0;
 
 	table->stats.nbuckets = 1;
 	table->stats.nkeys = 0;	
@@ -160,15 +337,71 @@ XtndblNHashTable *new_xtndbln_hash_table(int bucketsize) {
 void free_xtndbln_hash_table(XtndblNHashTable *table) {
 	assert(table);
 
+	// the buckets all came from the slab, so they can be freed in one go
+	free_slab(table->slab);
+	free(table->buckets);
+	free(table->shallow_buckets);
+	free(table);
+}
+
+
+// find the bucket that keys with hash value 'hash' belong in. with shallow
+// lookups on, the shallow array (small, so likely cached) is tried first:
+// for buckets using few enough bits it holds the bucket itself, and the
+// table isn't read at all
+static Bucket *hash_bucket(XtndblNHashTable *table, int64 hash) {
+	if (table->shallow && table->shallow < table->depth) {
+		uint32_t index =
+			table->shallow_buckets[rightmostnbits(table->shallow, hash)];
+		if (index != DEEP) {
+			return slab_item(table->slab, index);
+		}
+	}
+	return bucket_at(table, rightmostnbits(table->depth, hash));
+}
+
+// find the entry holding 'key' (whose hash value is 'hash') in 'table', or
+// NULL if it's not in there
+static Entry *find_entry_hashed(XtndblNHashTable *table, int64 key,
+	int64 hash) {
 	int i;
-	for (i=table->size-1; i>=0; i--) {
-		if (table->buckets[i]->id == i) {
-			free(table->buckets[i]->keys);
-			free(table->buckets[i]);
+	Bucket *bucket = hash_bucket(table, hash);
+
+	for (i=0; i<bucket->nkeys; i++) {
+		if (key == bucket->entries[i].key) {
+			return &bucket->entries[i];
 		}
 	}
-	free(table->buckets);
-	free(table);
+	return NULL;
+}
+
+// find the entry holding 'key' in 'table', or NULL if it's not in there
+// (lookups may run on several threads at once, so this writes nothing to the
+// table, not even the timing statistics)
+static Entry *find_entry(XtndblNHashTable *table, int64 key) {
+	return find_entry_hashed(table, key, h1_64(key));
+}
+
+// insert 'key' (which must not be in 'table' already, and whose hash value
+// is 'hash') with value 'value'
+static void insert_hashed(XtndblNHashTable *table, int64 key, int64 value,
+	int64 hash) {
+	int address = rightmostnbits(table->depth, hash);
+
+	while (bucket_at(table, address)->nkeys >= table->bucketsize) {
+		split_bucket(table, address);
+		address = rightmostnbits(table->depth, hash);
+	}
+	reinsert_key(table, key, value);
+
+	table->stats.nkeys++;
+}
+
+// insert 'key' (which must not be in 'table' already) with value 'value'
+static void insert_new(XtndblNHashTable *table, int64 key, int64 value) {
+	int start_time = timer_start();
+	insert_hashed(table, key, value, h1_64(key));
+	timer_add(table->stats.time, start_time);
 }
 
 
@@ -177,25 +410,191 @@ void free_xtndbln_hash_table(XtndblNHashTable *table) {
 // the code was sourced from "xtndbl1.c"
 bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key) {
 	assert(table);
-	int start_time = clock();
-
-	int hash = h1(key);
-	int address = rightmostnbits(table->depth, hash);
 
-	if (xtndbln_hash_table_lookup(table, key)) {
-		// table->stats.time += clock() - start_time;
+	if (find_entry(table, key)) {
 		return false;
 	}
+	insert_new(table, key, 0);
+	return true;
+}
 
-	while (table->buckets[address]->nkeys >= table->bucketsize) {
-		split_bucket(table, address);
-		address = rightmostnbits(table->depth, hash);
+
+// insert each of the 'n' keys in 'keys' into 'table', if it's not in there
+// already, storing whether each one was inserted in 'inserted'
+// returns how many of the keys were inserted
+int xtndbln_hash_table_insert_batch(XtndblNHashTable *table, int64 *keys,
+	int n, bool *inserted) {
+	assert(table);
+	int start_time = timer_start();
+
+	// grow the table of bucket indices (at most once) to roughly the size it
+	// would reach after the whole batch, so that splitting buckets as they
+	// fill up rarely needs to double it. buckets themselves still split on
+	// demand, so sizing for half-full buckets only costs table entries
+	int depth = table->depth;
+	while ((1 << depth) * (int64)table->bucketsize
+			< 2 * ((int64)table->stats.nkeys + n)) {
+		depth++;
+	}
+	if (depth > table->depth) {
+		grow_table(table, depth);
+		table->mindepth = depth;
 	}
-	reinsert_key(table, key);
 
-	table->stats.nkeys++;
-	table->stats.time += clock() - start_time;
-	return true;
+	int64 hashes[BATCH_GROUP];
+	Bucket *buckets[BATCH_GROUP];
+	int count = 0;
+	int i, j;
+	for (i=0; i<n; i+=BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// hash the whole group, prefetching a level at a time as for
+		// 'xtndbln_hash_table_lookup_batch()'
+		for (j=0; j<group; j++) {
+			hashes[j] = h1_64(keys[i+j]);
+			prefetch(&table->buckets[rightmostnbits(table->depth, hashes[j])]);
+		}
+		for (j=0; j<group; j++) {
+			buckets[j] = bucket_at(table, rightmostnbits(table->depth, hashes[j]));
+			prefetch(buckets[j]);
+		}
+
+		// then insert the keys one by one. splits may move keys and the table
+		// of indices around, so addresses are recalculated from the hashes
+		for (j=0; j<group; j++) {
+			inserted[i+j] = !find_entry_hashed(table, keys[i+j], hashes[j]);
+			if (inserted[i+j]) {
+				insert_hashed(table, keys[i+j], 0, hashes[j]);
+				count++;
+			}
+		}
+	}
+
+	timer_add(table->stats.time, start_time);
+	return count;
+}
+
+
+// which range of the table being built 'arg' key 'key' belongs in
+static int range_of(void *arg, int64 key) {
+	Build *build = arg;
+	return (rightmostnbits(build->table->depth, h1_64(key))) >> build->shift;
+}
+
+// note that 'builder' couldn't place 'key', leaving it for later
+// the code was sourced from "linear.c"
+static void defer_key(Builder *builder, int64 key) {
+	if (builder->noverflow == builder->capacity) {
+		builder->capacity = builder->capacity ? 2 * builder->capacity : 64;
+		builder->overflow = realloc(builder->overflow,
+			(sizeof *builder->overflow) * builder->capacity);
+		assert(builder->overflow);
+	}
+	builder->overflow[builder->noverflow++] = key;
+}
+
+// claim ranges of the table being built (as 'arg') one at a time and place
+// their keys. every address has a bucket of its own, which only the thread
+// holding its range touches. keys whose bucket is already full are left for
+// later (splitting would need the rest of the table)
+static void build_ranges(void *arg, int thread) {
+	Build *build = arg;
+	XtndblNHashTable *table = build->table;
+	Builder *builder = &build->builders[thread];
+	int nkeys = 0;
+
+	int range;
+	while ((range = __atomic_fetch_add(&build->next, 1, __ATOMIC_RELAXED))
+			< build->partition.nparts) {
+		int i, j;
+		for (i = build->partition.start[range];
+				i < build->partition.start[range + 1]; i++) {
+			int64 key = build->partition.keys[i];
+			Bucket *bucket = bucket_at(table,
+				rightmostnbits(table->depth, h1_64(key)));
+			for (j=0; j<bucket->nkeys; j++) {
+				if (bucket->entries[j].key == key) {
+					break;
+				}
+			}
+			if (j < bucket->nkeys) {
+				continue;
+			}
+			if (bucket->nkeys == table->bucketsize) {
+				defer_key(builder, key);
+			} else {
+				bucket->entries[bucket->nkeys].key = key;
+				bucket->entries[bucket->nkeys].value = 0;
+				bucket->nkeys++;
+				nkeys++;
+			}
+		}
+	}
+	builder->nkeys = nkeys;
+}
+
+// create an extendible hash table holding the 'n' keys in 'keys', built by
+// 'nthreads' threads at once
+XtndblNHashTable *xtndbln_hash_table_build_parallel(int bucketsize,
+	int64 *keys, int n, int nthreads) {
+	assert(nthreads > 0);
+	int start_time = timer_start();
+	XtndblNHashTable *table = new_xtndbln_hash_table(bucketsize);
+
+	// use enough bits for the buckets to end up at most about 3/4 full (a
+	// bucket per address costs more than a batch's buckets, which split on
+	// demand, so this packs them tighter), and at least enough for each
+	// range to have an address
+	int depth = 0, bits = 0;
+	while ((1 << bits) < nthreads * RANGES_PER_THREAD) {
+		bits++;
+	}
+	while (depth < bits
+			|| 3 * (1 << depth) * (int64)bucketsize < 4 * (int64)n) {
+		depth++;
+	}
+
+	// give every address a bucket of its own (address 0 keeps the first)
+	grow_table(table, depth);
+	bucket_at(table, 0)->depth = depth;
+	int address;
+	for (address=1; address<table->size; address++) {
+		table->buckets[address] = new_bucket(table->slab, address, depth);
+	}
+	table->nmaxdepth = table->size;
+	table->mindepth = depth;
+	table->stats.nbuckets = table->size;
+
+	// group the keys by range of addresses, and fill in the ranges in
+	// parallel
+	Build build = { .table = table, .shift = depth - bits, .next = 0 };
+	build.partition = partition_keys(keys, n, 1 << bits, range_of, &build,
+		nthreads);
+	build.builders = calloc(nthreads, sizeof *build.builders);
+	assert(build.builders);
+	run_threads(nthreads, build_ranges, &build);
+
+	// then insert the keys whose buckets were full one at a time, splitting
+	// buckets as usual
+	int t, i;
+	for (t = 0; t < nthreads; t++) {
+		table->stats.nkeys += build.builders[t].nkeys;
+	}
+	for (t = 0; t < nthreads; t++) {
+		Builder *builder = &build.builders[t];
+		for (i = 0; i < builder->noverflow; i++) {
+			int64 hash = h1_64(builder->overflow[i]);
+			if (!find_entry_hashed(table, builder->overflow[i], hash)) {
+				insert_hashed(table, builder->overflow[i], 0, hash);
+			}
+		}
+		free(builder->overflow);
+	}
+
+	free(build.builders);
+	free_partition(&build.partition);
+	timer_add(table->stats.time, start_time);
+	return table;
 }
 
 
@@ -204,20 +603,126 @@ bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key) {
 // the code was sourced from "xtndbl1.c"
 bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key) {
 	assert(table);
-	int start_time = clock();
+	return find_entry(table, key) != NULL;
+}
 
-	int i;
-	int address = rightmostnbits(table->depth, h1(key));
 
-	bool found = false;
-	if (table->buckets[address]->nkeys != 0) {
-		for (i=0; i<table->buckets[address]->nkeys; i++) {
-			if (key == table->buckets[address]->keys[i]) {
-				found = true;
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int xtndbln_hash_table_lookup_batch(XtndblNHashTable *table, int64 *keys,
+	int n, bool *results) {
+	assert(table);
+
+	uint32_t *entries[BATCH_GROUP];
+	Bucket *buckets[BATCH_GROUP];
+	int found = 0;
+	int i, j, k;
+	for (i=0; i<n; i+=BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// reaching a key takes two dependent loads (table entry, then the
+		// bucket and its entries), so prefetch the group a level at a time
+		for (j=0; j<group; j++) {
+			int address = rightmostnbits(table->depth, h1_64(keys[i+j]));
+			entries[j] = &table->buckets[address];
+			prefetch(entries[j]);
+		}
+		for (j=0; j<group; j++) {
+			buckets[j] = slab_item(table->slab, *entries[j]);
+			prefetch(buckets[j]);
+		}
+
+		// now scan each key's bucket
+		for (j=0; j<group; j++) {
+			results[i+j] = false;
+			for (k=0; k<buckets[j]->nkeys; k++) {
+				if (buckets[j]->entries[k].key == keys[i+j]) {
+					results[i+j] = true;
+					break;
+				}
 			}
+			found += results[i+j];
 		}
 	}
-	table->stats.time += clock() - start_time;
+	return found;
+}
+
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xtndbln_hash_table_put(XtndblNHashTable *table, int64 key, int64 value) {
+	assert(table);
+
+	Entry *entry = find_entry(table, key);
+	if (entry) {
+		entry->value = value;
+		return false;
+	}
+	insert_new(table, key, value);
+	return true;
+}
+
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool xtndbln_hash_table_get(XtndblNHashTable *table, int64 key, int64 *value) {
+	assert(table);
+
+	Entry *entry = find_entry(table, key);
+	if (entry && value) {
+		*value = entry->value;
+	}
+	return entry != NULL;
+}
+
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool xtndbln_hash_table_get_or_insert(XtndblNHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table);
+
+	Entry *entry = find_entry(table, key);
+	if (entry) {
+		value = entry->value;
+	} else {
+		insert_new(table, key, value);
+	}
+	if (result) {
+		*result = value;
+	}
+	return entry == NULL;
+}
+
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool xtndbln_hash_table_delete(XtndblNHashTable *table, int64 key) {
+	assert(table);
+	int start_time = timer_start();
+
+	int address = rightmostnbits(table->depth, h1_64(key));
+	Bucket *bucket = bucket_at(table, address);
+
+	bool found = false;
+	int i;
+	for (i=0; i<bucket->nkeys; i++) {
+		if (bucket->entries[i].key == key) {
+			// fill the gap with the bucket's last key, then see if the bucket
+			// is now empty enough to merge
+			bucket->nkeys--;
+			bucket->entries[i] = bucket->entries[bucket->nkeys];
+			table->stats.nkeys--;
+			merge_buckets(table, address);
+			found = true;
+			break;
+		}
+	}
+	timer_add(table->stats.time, start_time);
 	return found;
 }
 
@@ -235,17 +740,17 @@ void xtndbln_hash_table_print(XtndblNHashTable *table) {
 	int i;
 	for (i = 0; i < table->size; i++) {
 		// table entry
-		printf("%9d | %-9d ", i, table->buckets[i]->id);
+		printf("%9d | %-9d ", i, bucket_at(table, i)->id);
 
 		// if this is the first address at which a bucket occurs, print it now
-		if (table->buckets[i]->id == i) {
-			printf("%9d ", table->buckets[i]->id);
+		if (bucket_at(table, i)->id == i) {
+			printf("%9d ", bucket_at(table, i)->id);
 
 			// print the bucket's contents
 			printf("[");
 			for(int j = 0; j < table->bucketsize; j++) {
-				if (j < table->buckets[i]->nkeys) {
-					printf(" %llu", table->buckets[i]->keys[j]);
+				if (j < bucket_at(table, i)->nkeys) {
+					printf(" %llu", bucket_at(table, i)->entries[j].key);
 				} else {
 					printf(" -");
 				}
@@ -268,8 +773,48 @@ void xtndbln_hash_table_stats(XtndblNHashTable *table) {
 	printf("current table size: %d\n", table->size);
 	printf("    number of keys: %d\n", table->stats.nkeys);
 	printf(" number of buckets: %d\n", table->stats.nbuckets);
+	printf("     bucket memory: %zu bytes\n", slab_bytes(table->slab));
+	printf("  directory memory: %zu bytes\n",
+		(sizeof *table->buckets) * table->size);
 	// also calculate CPU usage in seconds and print this
+#ifdef TABLE_TIMING
 	float seconds = table->stats.time * 1.0 / CLOCKS_PER_SEC;
 	printf("    CPU time spent: %.6f sec\n", seconds);
+#else
+	printf("    CPU time spent: not timed (build with -DTABLE_TIMING)\n");
+#endif
 	printf("--- end stats ---\n");
 }
+
+// return how many keys 'table' has space for without growing
+int xtndbln_hash_table_capacity(XtndblNHashTable *table) {
+	assert(table);
+	return table->stats.nbuckets * table->bucketsize;
+}
+
+// have lookups in 'table' first try an array of the buckets using at most
+// 'depth' hash value bits, or turn this off with depth 0
+void xtndbln_hash_table_set_shallow_depth(XtndblNHashTable *table, int depth) {
+	assert(table && depth >= 0);
+
+	// (readers may be using the old array)
+	write_barrier();
+	free(table->shallow_buckets);
+	table->shallow_buckets = NULL;
+	table->shallow = depth;
+	if (!depth) {
+		return;
+	}
+
+	// fill in the shallow array from the table: each entry's bucket is the
+	// one its bits lead to (repeating the table if it uses fewer bits)
+	int size = 1 << depth;
+	table->shallow_buckets = malloc((sizeof *table->shallow_buckets) * size);
+	assert(table->shallow_buckets);
+	int a;
+	for (a = 0; a < size; a++) {
+		uint32_t index = table->buckets[a & (table->size - 1)];
+		table->shallow_buckets[a] = ((Bucket *)slab_item(table->slab,
+			index))->depth <= depth ? index : DEEP;
+	}
+}
@@ -24,14 +24,66 @@ void free_xtndbln_hash_table(XtndblNHashTable *table);
 // returns true if insertion succeeds, false if it was already in there
 bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key);
 
+// insert each of the 'n' keys in 'keys' into 'table', if it's not in there
+// already, storing whether each one was inserted in 'inserted'. the table is
+// grown at most once, up front, to fit the whole batch
+// returns how many of the keys were inserted
+int xtndbln_hash_table_insert_batch(XtndblNHashTable *table, int64 *keys, int n,
+	bool *inserted);
+
+// create an extendible hash table with 'bucketsize' keys per bucket holding
+// the 'n' keys in 'keys', built by 'nthreads' threads at once: the table
+// starts out deep enough for all of the keys, with a bucket per address, and
+// each thread fills in the buckets of whole ranges of addresses
+XtndblNHashTable *xtndbln_hash_table_build_parallel(int bucketsize,
+	int64 *keys, int n, int nthreads);
+
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key);
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'. keys are hashed in groups, and the memory they
+// will probe is prefetched before any of them are probed
+// returns how many of the keys were found
+int xtndbln_hash_table_lookup_batch(XtndblNHashTable *table, int64 *keys, int n,
+	bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xtndbln_hash_table_put(XtndblNHashTable *table, int64 key, int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool xtndbln_hash_table_get(XtndblNHashTable *table, int64 key, int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool xtndbln_hash_table_get_or_insert(XtndblNHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool xtndbln_hash_table_delete(XtndblNHashTable *table, int64 key);
+
 // print the contents of 'table' to stdout
 void xtndbln_hash_table_print(XtndblNHashTable *table);
 
 // print some statistics about 'table' to stdout
 void xtndbln_hash_table_stats(XtndblNHashTable *table);
 
+// return how many keys 'table' has space for without growing
+int xtndbln_hash_table_capacity(XtndblNHashTable *table);
+
+// have lookups in 'table' first try a separate array of 2^'depth' entries
+// (small enough to stay cached), indexed by the last 'depth' hash value bits,
+// which holds each bucket using no more bits than that. lookups whose
+// bucket is in there skip the table altogether, and the rest fall back to
+// it. this pays off when most buckets are much shallower than the table.
+// depth 0 (the default) turns this off
+void xtndbln_hash_table_set_shallow_depth(XtndblNHashTable *table, int depth);
+
 #endif
\ No newline at end of file
@@ -14,10 +14,16 @@
 #include <time.h>
 
 #include "xuckoo.h"
+#include "slab.h"
+#include "seqlock.h"
 
 // macro to calculate the rightmost n bits of a number x
 #define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
 
+// the most keys a single insertion may move to make room for a new key. if
+// there's no path of moves this short, a bucket is split instead
+#define MAX_PATH 64
+
 // a bucket stores a single key (full=true) or is empty (full=false)
 // it also knows how many bits are shared between possible keys, and the first 
 // table address that references it
@@ -27,6 +33,7 @@ typedef struct bucket {
 	int depth;	// how many hash value bits are being used by this bucket
 	bool full;	// does this bucket contain a key
 	int64 key;	// the key stored in this bucket
+	int64 value;// the value that key maps to
 } Bucket;
 
 // an inner table is an extendible hash table with an array of slots pointing 
@@ -37,8 +44,18 @@ typedef struct inner_table {
 	int size;			// how many entries in the table of pointers (2^depth)
 	int depth;			// how many bits of the hash value to use (log2(size))
 	int nkeys;			// how many keys are being stored in the table
+	int nbuckets;		// how many distinct buckets the table points to
+	Slab *slab;			// where the buckets are allocated from
 } InnerTable;
 
+// a step on a path of moves: a bucket in one of the inner tables, and the
+// step before it, whose key would move into this bucket to make room
+typedef struct step {
+	int t;			// which inner table (1 or 2)
+	Bucket *bucket;	// the bucket in that table
+	int parent;		// index of the step before this one, or -1 for the first
+} Step;
+
 // a xuckoo hash table is just two inner tables for storing inserted keys
 struct xuckoo_table {
 	InnerTable *table1;
@@ -47,24 +64,27 @@ struct xuckoo_table {
 };
 
 /******************************* HELP FUNCTION *******************************/
-static Bucket *new_bucket(int first_address, int depth);
+static Bucket *new_bucket(Slab *slab, int first_address, int depth);
 static void double_inner_table(InnerTable *table);
-static void reinsert_key(InnerTable *table, int64 key, int t);
+static void reinsert_key(InnerTable *table, int64 key, int64 value, int t);
 static void split_bucket(InnerTable *table, int address, int t);
 static void new_inner_table(InnerTable *table);
 static void initialise_xuckoo_table(XuckooHashTable *table, int size);
 void free_x_inner_table(InnerTable *table);
 bool inner_table_insert(InnerTable *table, int64 key, int t);
-bool xuckoo_rehash_1(XuckooHashTable *table, int64 key, int64 record, int st, 
-	int check);
-bool xuckoo_rehash_2(XuckooHashTable *table, int64 key, int64 record, int st, 
-	int check);
+static InnerTable *inner_table(XuckooHashTable *table, int t);
+static int key_address(InnerTable *inner, int64 key, int t);
+static int plan_path(XuckooHashTable *table, int64 key, int start,
+	Step *path);
+static void follow_path(XuckooHashTable *table, Step *path, int end,
+	int64 key, int64 value);
+static Bucket *find_bucket(XuckooHashTable *table, int64 key);
+static void insert_new(XuckooHashTable *table, int64 key, int64 value);
 /****************************************************************************/
 
 // the code was sourced from "xtndbl1.c"
-static Bucket *new_bucket(int first_address, int depth) {
-	Bucket *bucket = malloc(sizeof *bucket);
-	assert(bucket);
+static Bucket *new_bucket(Slab *slab, int first_address, int depth) {
+	Bucket *bucket = slab_item(slab, slab_alloc(slab));
 
 	bucket->id = first_address;
 	bucket->depth = depth;
@@ -80,6 +100,7 @@ static void double_inner_table(InnerTable *table) {
 	int size = table->size * 2;
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
+	write_barrier();
 	table->buckets = realloc(table->buckets, (sizeof *table->buckets) * size);
 	assert(table->buckets);
 	int i;
@@ -91,14 +112,15 @@ static void double_inner_table(InnerTable *table) {
 }
 
 // the code was sourced from "xtndbl1.c"
-static void reinsert_key(InnerTable *table, int64 key, int t) {
+static void reinsert_key(InnerTable *table, int64 key, int64 value, int t) {
 	int address;
 	if (t==1) {
-		address = rightmostnbits(table->depth, h1(key));
+		address = rightmostnbits(table->depth, h1_64(key));
 	} else {
-		address = rightmostnbits(table->depth, h2(key));
+		address = rightmostnbits(table->depth, h2_64(key));
 	}
 	table->buckets[address]->key = key;
+	table->buckets[address]->value = value;
 	table->buckets[address]->full = true;
 }
 
@@ -115,7 +137,8 @@ static void split_bucket(InnerTable *table, int address, int t) {
 	bucket->depth = new_depth;
 
 	int new_first_address = 1 << depth | first_address;
-	Bucket *newbucket = new_bucket(new_first_address, new_depth);
+	Bucket *newbucket = new_bucket(table->slab, new_first_address, new_depth);
+	table->nbuckets++;
 
 	int bit_address = rightmostnbits(depth, first_address);
 	int suffix = (1 << depth) | bit_address;
@@ -127,9 +150,8 @@ static void split_bucket(InnerTable *table, int address, int t) {
 		int a = (prefix << new_depth) | suffix;
 		table->buckets[a] = newbucket;
 	}
-	int64 key = bucket->key;
 	bucket->full = false;
-	reinsert_key(table, key, t);
+	reinsert_key(table, bucket->key, bucket->value, t);
 }
 
 /****************************************************************************/
@@ -142,9 +164,11 @@ static void new_inner_table(InnerTable *table) {
 	table->size = 1;
 	table->buckets = malloc(sizeof *table->buckets);
 	assert(table->buckets);
-	table->buckets[0] = new_bucket(0, 0);
+	table->slab = new_slab(sizeof (Bucket));
+	table->buckets[0] = new_bucket(table->slab, 0, 0);
 	table->depth = 0;
 	table->nkeys = 0;
+	table->nbuckets = 1;
 }
 
 static void initialise_xuckoo_table(XuckooHashTable *table, int size) {
@@ -176,12 +200,8 @@ XuckooHashTable *new_xuckoo_hash_table() {
 void free_x_inner_table(InnerTable *table) {
 	assert(table);
 	
-	int i;
-	for (i=table->size-1; i>=0; i--) {
-		if (table->buckets[i]->id == i) {
-			free(table->buckets[i]);
-		}
-	}
+	// the buckets all came from the slab, so they can be freed in one go
+	free_slab(table->slab);
 	free(table->buckets);
 	free(table);
 }
@@ -196,78 +216,114 @@ void free_xuckoo_hash_table(XuckooHashTable *table) {
 
 /****************************************************************************/
 
-bool xuckoo_rehash_1(XuckooHashTable *table, int64 key, int64 record, int st, 
-	int check) {
-	int hash = h1(key);
-	int address = rightmostnbits(table->table1->depth, hash);
-
-	// st is start table
-	// infinite loop occurs, split bucket
-	if (key == record && st == 1 && check > 0) {
-		split_bucket(table->table1, address, 1);
-		address = rightmostnbits(table->table1->depth, hash);
-		check = 0;
+// inner table 't' (1 or 2) of 'table'
+static InnerTable *inner_table(XuckooHashTable *table, int t) {
+	return t == 1 ? table->table1 : table->table2;
+}
+
+// the address 'key' hashes to in 'inner', which is inner table 't'
+static int key_address(InnerTable *inner, int64 key, int t) {
+	int64 hash = t == 1 ? h1_64(key) : h2_64(key);
+	return rightmostnbits(inner->depth, hash);
+}
+
+// search breadth-first for the shortest path of moves that frees one of the
+// two buckets 'key' can go in (trying the one in table 'start' first), without
+// moving any keys yet. every full bucket leads to just one other bucket
+// (where its key would move to), so this walks the two chains starting from
+// 'key's buckets side by side
+// returns the index of the step in 'path' ending at an empty bucket, or -1
+// if neither chain reaches one within MAX_PATH moves
+static int plan_path(XuckooHashTable *table, int64 key, int start,
+	Step *path) {
+	int other = 3 - start;
+	InnerTable *inner = inner_table(table, start);
+	path[0] = (Step){start, inner->buckets[key_address(inner, key, start)], -1};
+	inner = inner_table(table, other);
+	path[1] = (Step){other, inner->buckets[key_address(inner, key, other)], -1};
+	int nsteps = 2;
+
+	int i;
+	for (i = 0; i < nsteps; i++) {
+		Bucket *bucket = path[i].bucket;
+		if (!bucket->full) {
+			return i;
+		}
+
+		// the key in this bucket would have to move to its other table
+		if (nsteps < 2 * (MAX_PATH + 1)) {
+			int t = 3 - path[i].t;
+			inner = inner_table(table, t);
+			Bucket *next = inner->buckets[key_address(inner, bucket->key, t)];
+			path[nsteps++] = (Step){t, next, i};
+		}
 	}
-	check++;
+	return -1;
+}
 
-	if (!table->table1->buckets[address]->full) {
-		table->table1->buckets[address]->key = key;
-		table->table1->buckets[address]->full = true;
-		table->table1->nkeys++;
-		return true;
-	} else {
-		int64 old_key;
-		old_key = table->table1->buckets[address]->key;
-		table->table1->buckets[address]->key = key;
-		return xuckoo_rehash_2(table, old_key, record, st, check);
+// make room by moving each key on the path ending at 'path[end]' one step
+// along (starting from the empty end), then put 'key' in the bucket this
+// frees at the start of the path
+static void follow_path(XuckooHashTable *table, Step *path, int end,
+	int64 key, int64 value) {
+	int i;
+	for (i = end; path[i].parent >= 0; i = path[i].parent) {
+		Step *prev = &path[path[i].parent];
+		path[i].bucket->key = prev->bucket->key;
+		path[i].bucket->value = prev->bucket->value;
+		path[i].bucket->full = true;
+		inner_table(table, path[i].t)->nkeys++;
+		inner_table(table, prev->t)->nkeys--;
 	}
+	path[i].bucket->key = key;
+	path[i].bucket->value = value;
+	path[i].bucket->full = true;
+	inner_table(table, path[i].t)->nkeys++;
 }
 
-bool xuckoo_rehash_2(XuckooHashTable *table, int64 key, int64 record, int st, 
-	int check) {
-	int hash = h2(key);
-	int address = rightmostnbits(table->table2->depth, hash);
-
-	// st is start table
-	// infinite loop occurs, split bucket
-	if (key == record && st == 2 && check > 0) {
-		split_bucket(table->table2, address, 2);
-		address = rightmostnbits(table->table2->depth, hash);
-		check = 0;
+// insert 'key' (which must not be in 'table' already) with value 'value',
+// starting in whichever table holds fewer keys
+static void insert_new(XuckooHashTable *table, int64 key, int64 value) {
+	int start = table->table1->nkeys <= table->table2->nkeys ? 1 : 2;
+
+	// find a way to make room before moving anything. if there is none,
+	// split the key's bucket in its starting table and try again
+	Step path[2 * (MAX_PATH + 1)];
+	int end = plan_path(table, key, start, path);
+	while (end < 0) {
+		InnerTable *inner = inner_table(table, start);
+		split_bucket(inner, key_address(inner, key, start), start);
+		end = plan_path(table, key, start, path);
 	}
-	check++;
+	follow_path(table, path, end, key, value);
+}
 
-	if (!table->table2->buckets[address]->full) {
-		table->table2->buckets[address]->key = key;
-		table->table2->buckets[address]->full = true;
-		table->table2->nkeys++;
-		return true;
-	} else {
-		int64 old_key;
-		old_key = table->table2->buckets[address]->key;
-		table->table2->buckets[address]->key = key;
-		return xuckoo_rehash_1(table, old_key, record, st, check);
+// find the bucket holding 'key' in 'table', or NULL if it's not in there
+static Bucket *find_bucket(XuckooHashTable *table, int64 key) {
+	int ht1 = rightmostnbits(table->table1->depth, h1_64(key));
+	int ht2 = rightmostnbits(table->table2->depth, h2_64(key));
+
+	Bucket *bucket = table->table1->buckets[ht1];
+	if (bucket->full && bucket->key == key) {
+		return bucket;
+	}
+	bucket = table->table2->buckets[ht2];
+	if (bucket->full && bucket->key == key) {
+		return bucket;
 	}
+	return NULL;
 }
 
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
 	assert(table);
-	// int start_time = clock();
-	bool found;
 
-	if (xuckoo_hash_table_lookup(table, key)) {
-		// table->time = clock() - start_time;
+	if (find_bucket(table, key)) {
 		return false;
 	}
-	if (table->table1->nkeys <= table->table2->nkeys) {
-		found = xuckoo_rehash_1(table, key, key, 1, 0);
-	} else {
-		found = xuckoo_rehash_2(table, key, key, 2, 0);
-	}
-	// table->time = clock() - start_time;
-	return found;
+	insert_new(table, key, 0);
+	return true;
 }
 
 /****************************************************************************/
@@ -276,26 +332,121 @@ bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
 // returns true if found, false if not
 bool xuckoo_hash_table_lookup(XuckooHashTable *table, int64 key) {
 	assert(table);
-	// int start_time = clock();
-	bool found = false;
+	return find_bucket(table, key) != NULL;
+}
 
-	int ht1 = rightmostnbits(table->table1->depth, h1(key));
-	int ht2 = rightmostnbits(table->table2->depth, h2(key));
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'
+// returns how many of the keys were found
+int xuckoo_hash_table_lookup_batch(XuckooHashTable *table, int64 *keys, int n,
+	bool *results) {
+	assert(table);
 
-	if (table->table1->buckets[ht1]->full) {
-		if (table->table1->buckets[ht1]->key == key) {
-			found = true;
+	Bucket **entries1[BATCH_GROUP], **entries2[BATCH_GROUP];
+	Bucket *buckets1[BATCH_GROUP], *buckets2[BATCH_GROUP];
+	int found = 0;
+	int i, j;
+	for (i=0; i<n; i+=BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		// prefetch both candidate buckets of every key in the group, first
+		// their table entries and then the buckets those point to
+		for (j=0; j<group; j++) {
+			int ht1 = rightmostnbits(table->table1->depth, h1_64(keys[i+j]));
+			int ht2 = rightmostnbits(table->table2->depth, h2_64(keys[i+j]));
+			entries1[j] = &table->table1->buckets[ht1];
+			entries2[j] = &table->table2->buckets[ht2];
+			prefetch(entries1[j]);
+			prefetch(entries2[j]);
+		}
+		for (j=0; j<group; j++) {
+			buckets1[j] = *entries1[j];
+			buckets2[j] = *entries2[j];
+			prefetch(buckets1[j]);
+			prefetch(buckets2[j]);
 		}
-	} 
-	if (table->table2->buckets[ht2]->full) {
-		if (table->table2->buckets[ht2]->key == key) {
-			found = true;
+
+		// now check both buckets for each key
+		for (j=0; j<group; j++) {
+			results[i+j] = (buckets1[j]->full && buckets1[j]->key == keys[i+j])
+				|| (buckets2[j]->full && buckets2[j]->key == keys[i+j]);
+			found += results[i+j];
 		}
 	}
-	// table->time += clock() - start_time;
 	return found;
 }
 
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xuckoo_hash_table_put(XuckooHashTable *table, int64 key, int64 value) {
+	assert(table);
+
+	Bucket *bucket = find_bucket(table, key);
+	if (bucket) {
+		bucket->value = value;
+		return false;
+	}
+	insert_new(table, key, value);
+	return true;
+}
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool xuckoo_hash_table_get(XuckooHashTable *table, int64 key, int64 *value) {
+	assert(table);
+
+	Bucket *bucket = find_bucket(table, key);
+	if (bucket && value) {
+		*value = bucket->value;
+	}
+	return bucket != NULL;
+}
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool xuckoo_hash_table_get_or_insert(XuckooHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table);
+
+	Bucket *bucket = find_bucket(table, key);
+	if (bucket) {
+		value = bucket->value;
+	} else {
+		insert_new(table, key, value);
+	}
+	if (result) {
+		*result = value;
+	}
+	return bucket == NULL;
+}
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool xuckoo_hash_table_delete(XuckooHashTable *table, int64 key) {
+	assert(table);
+
+	// like cuckoo hashing, a key can only be in one of two buckets, and
+	// emptying its bucket doesn't affect any other keys
+	int ht1 = rightmostnbits(table->table1->depth, h1_64(key));
+	Bucket *bucket = table->table1->buckets[ht1];
+	if (bucket->full && bucket->key == key) {
+		bucket->full = false;
+		table->table1->nkeys--;
+		return true;
+	}
+	int ht2 = rightmostnbits(table->table2->depth, h2_64(key));
+	bucket = table->table2->buckets[ht2];
+	if (bucket->full && bucket->key == key) {
+		bucket->full = false;
+		table->table2->nkeys--;
+		return true;
+	}
+	return false;
+}
+
 // print the contents of 'table' to stdout
 void xuckoo_hash_table_print(XuckooHashTable *table) {
 	assert(table != NULL);
@@ -349,3 +500,9 @@ void xuckoo_hash_table_stats(XuckooHashTable *table) {
 	// printf("    CPU time spent: %.6f sec\n", seconds);
 	printf("--- end stats ---\n");
 }
+
+// return how many keys 'table' has space for without growing
+int xuckoo_hash_table_capacity(XuckooHashTable *table) {
+	assert(table);
+	return table->table1->nbuckets + table->table2->nbuckets;
+}
@@ -30,10 +30,40 @@ bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key);
 // returns true if found, false if not
 bool xuckoo_hash_table_lookup(XuckooHashTable *table, int64 key);
 
+// lookup whether each of the 'n' keys in 'keys' is inside 'table', storing
+// the answers in 'results'. keys are hashed in groups, and the memory they
+// will probe is prefetched before any of them are probed
+// returns how many of the keys were found
+int xuckoo_hash_table_lookup_batch(XuckooHashTable *table, int64 *keys, int n,
+	bool *results);
+
+// map 'key' to 'value' in 'table', replacing any existing value
+// returns true if 'key' was newly inserted, false if its value was replaced
+bool xuckoo_hash_table_put(XuckooHashTable *table, int64 key, int64 value);
+
+// lookup the value 'key' maps to in 'table', storing it in '*value' (unless
+// 'value' is NULL)
+// returns true if found, false if not
+bool xuckoo_hash_table_get(XuckooHashTable *table, int64 key, int64 *value);
+
+// lookup the value 'key' maps to in 'table', first inserting 'key' with value
+// 'value' if it's not in there, and store the result in '*result' (unless
+// 'result' is NULL)
+// returns true if 'key' was newly inserted, false if it was already in there
+bool xuckoo_hash_table_get_or_insert(XuckooHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+// remove 'key' from 'table', if it's in there
+// returns true if it was removed, false if it wasn't in there
+bool xuckoo_hash_table_delete(XuckooHashTable *table, int64 key);
+
 // print the contents of 'table' to stdout
 void xuckoo_hash_table_print(XuckooHashTable *table);
 
 // print some statistics about 'table' to stdout
 void xuckoo_hash_table_stats(XuckooHashTable *table);
 
+// return how many keys 'table' has space for without growing
+int xuckoo_hash_table_capacity(XuckooHashTable *table);
+
 #endif
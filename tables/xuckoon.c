@@ -11,15 +11,26 @@
 #include <time.h>
 
 #include "xuckoon.h"
+#include "slab.h"
+#include "seqlock.h"
 
 // macro to calculate the rightmost n bits of a number x
 #define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
 
+// the most buckets an insertion may look at while searching for a path of
+// moves to make room for its key. if it finds none, a bucket is split instead
+#define MAX_SEARCH 64
+
+typedef struct entry {
+	int64 key;
+	int64 value;
+} Entry;
+
 typedef struct bucket {
 	int id;
 	int depth;
 	int nkeys;
-	int64 *keys;
+	Entry entries[];	// bucketsize entries, inline after the other fields
 } Bucket;
 
 typedef struct inner_table {
@@ -28,37 +39,51 @@ typedef struct inner_table {
 	int depth;
 	int bucketsize;
 	int nkeys;
+	int nbuckets;
+	Slab *slab;		// where the buckets are allocated from
 } InnerTable;
 
+// a step on a path of moves: a bucket in one of the inner tables, and the
+// step before it, one of whose keys would move into this bucket
+typedef struct step {
+	int t;			// which inner table (1 or 2)
+	Bucket *bucket;	// the bucket in that table
+	int slot;		// the entry in the previous step's bucket to move here
+	int parent;		// index of the step before this one, or -1 for the first
+} Step;
+
 struct xuckoon_table {
 	InnerTable *table1;
 	InnerTable *table2;
 };
 
 /******************************* HELP FUNCTION *******************************/
-static Bucket *new_bucket(int first_address, int depth, int bucketsize);
+static Bucket *new_bucket(Slab *slab, int first_address, int depth);
 static void double_inner_n_table(InnerTable *table);
-static void reinsert_n_key(InnerTable *table, int64 key, int t);
+static void reinsert_n_key(InnerTable *table, Entry entry, int t);
 static void new_inner_n_table(InnerTable *table, int bucketsize);
 static void initialise_xuckoon_table(XuckoonHashTable *table, int size, 
 	int bucketsize);
-bool xuckoon_rehash_1(XuckoonHashTable *table, int64 key, int64 record, 
-	int st, int check);
-bool xuckoon_rehash_2(XuckoonHashTable *table, int64 key, int64 record, 
-	int st, int check);
+static InnerTable *inner_table(XuckoonHashTable *table, int t);
+static int key_address(InnerTable *inner, int64 key, int t);
+static bool on_path(Step *path, int i, Bucket *bucket);
+static int plan_path(XuckoonHashTable *table, int64 key, int start,
+	Step *path);
+static void follow_path(XuckoonHashTable *table, Step *path, int end,
+	int64 key, int64 value);
 void free_inner_n_table(InnerTable *table);
-bool inner_n_table_loopup(InnerTable *table, int64 key, int address);
+static Entry *inner_n_table_find(InnerTable *table, int64 key, int address);
+static Entry *find_entry(XuckoonHashTable *table, int64 key);
+static void insert_new(XuckoonHashTable *table, int64 key, int64 value);
+bool inner_n_table_delete(InnerTable *table, int64 key, int address);
 /****************************************************************************/
 
-static Bucket *new_bucket(int first_address, int depth, int bucketsize) {
-	Bucket *bucket = malloc(sizeof *bucket);
-	assert(bucket);
+static Bucket *new_bucket(Slab *slab, int first_address, int depth) {
+	Bucket *bucket = slab_item(slab, slab_alloc(slab));
 
 	bucket->id = first_address;
 	bucket->depth = depth;
 	bucket->nkeys = 0;
-	bucket->keys = malloc((sizeof *bucket->keys) * bucketsize);
-	assert(bucket->keys);
 
 	return bucket;
 }
@@ -67,6 +92,7 @@ static void double_inner_n_table(InnerTable *table) {
 	int size = table->size * 2;
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
+	write_barrier();
 	table->buckets = realloc(table->buckets, (sizeof *table->buckets) * size);
 	assert(table->buckets);
 	int i;
@@ -77,15 +103,15 @@ static void double_inner_n_table(InnerTable *table) {
 	table->depth++;
 }
 
-static void reinsert_n_key(InnerTable *table, int64 key, int t) {
+static void reinsert_n_key(InnerTable *table, Entry entry, int t) {
 	int address;
 	if (t==1) {
-		address = rightmostnbits(table->depth, h1(key));
+		address = rightmostnbits(table->depth, h1_64(entry.key));
 	} else {
-		address = rightmostnbits(table->depth, h2(key));
+		address = rightmostnbits(table->depth, h2_64(entry.key));
 	}
 	int order = table->buckets[address]->nkeys;
-	table->buckets[address]->keys[order] = key;
+	table->buckets[address]->entries[order] = entry;
 	table->buckets[address]->nkeys++;
 }
 
@@ -101,7 +127,8 @@ static void split_bucket(InnerTable *table, int address, int t) {
 	bucket->depth = new_depth;
 
 	int new_first_address = 1 << depth | first_address;
-	Bucket *newbucket = new_bucket(new_first_address, new_depth, table->bucketsize);
+	Bucket *newbucket = new_bucket(table->slab, new_first_address, new_depth);
+	table->nbuckets++;
 
 	int bit_address = rightmostnbits(depth, first_address);
 	int suffix = (1 << depth) | bit_address;
@@ -115,12 +142,10 @@ static void split_bucket(InnerTable *table, int address, int t) {
 	}
 	int num = bucket->nkeys;
 	int i;
-	int64 key;
 	bucket->nkeys = 0;
 
 	for (i=0; i<num; i++) {
-		key = bucket->keys[i];
-		reinsert_n_key(table, key, t);
+		reinsert_n_key(table, bucket->entries[i], t);
 	}
 }
 
@@ -131,10 +156,12 @@ static void new_inner_n_table(InnerTable *table, int bucketsize) {
 	table->depth = 0;
 	table->bucketsize = bucketsize;
 	table->nkeys = 0;
+	table->nbuckets = 1;
 
 	table->buckets = malloc(sizeof *table->buckets);
 	assert(table->buckets);
-	table->buckets[0] = new_bucket(0, 0, bucketsize);
+	table->slab = new_slab(sizeof (Bucket) + (sizeof (Entry)) * bucketsize);
+	table->buckets[0] = new_bucket(table->slab, 0, 0);
 
 }
 
@@ -163,13 +190,7 @@ XuckoonHashTable *new_xuckoon_hash_table(int bucketsize) {
 void free_inner_n_table(InnerTable *table) {
 	assert(table);
 
-	int i;
-	for (i=table->size-1; i>=0; i--) {
-		if (table->buckets[i]->id == i) {
-			free(table->buckets[i]->keys);
-			free(table->buckets[i]);
-		}
-	}
+	free_slab(table->slab);
 	free(table->buckets);
 	free(table);
 }
@@ -181,102 +202,243 @@ void free_xuckoon_hash_table(XuckoonHashTable *table) {
 	free(table);
 }
 
-bool xuckoon_rehash_1(XuckoonHashTable *table, int64 key, int64 record, 
-	int st, int check) {
-	int hash = h1(key);
-	int address = rightmostnbits(table->table1->depth, hash);
+// inner table 't' (1 or 2) of 'table'
+static InnerTable *inner_table(XuckoonHashTable *table, int t) {
+	return t == 1 ? table->table1 : table->table2;
+}
 
-	if (key == record && st == 1 && check > 0) {
-		split_bucket(table->table1, address, 1);
-		address = rightmostnbits(table->table1->depth, hash);
-		check = 0;
-	}
-	check++;
+// the address 'key' hashes to in 'inner', which is inner table 't'
+static int key_address(InnerTable *inner, int64 key, int t) {
+	int64 hash = t == 1 ? h1_64(key) : h2_64(key);
+	return rightmostnbits(inner->depth, hash);
+}
 
-	int nkeys = table->table1->buckets[address]->nkeys;
-	if (nkeys < table->table1->bucketsize) {
-		table->table1->buckets[address]->keys[nkeys] = key;
-		table->table1->buckets[address]->nkeys++;
-		table->table1->nkeys++;
-		return true;
-	} else {
-		// int rdm = rand() % (table->table1->bucketsize);
-		// using random number occurs segmentation fault
-		int old_key = table->table1->buckets[address]->keys[0];
-		table->table1->buckets[address]->keys[0] = key;
-		return xuckoon_rehash_2(table, old_key, record, st, check);
+// is 'bucket' already on the path leading to 'path[i]'?
+static bool on_path(Step *path, int i, Bucket *bucket) {
+	for (; i >= 0; i = path[i].parent) {
+		if (path[i].bucket == bucket) {
+			return true;
+		}
 	}
+	return false;
 }
 
-bool xuckoon_rehash_2(XuckoonHashTable *table, int64 key, int64 record, 
-	int st, int check) {
-	int hash = h2(key);
-	int address = rightmostnbits(table->table2->depth, hash);
+// search breadth-first for the shortest path of moves that frees room in one
+// of the two buckets 'key' can go in (trying the one in table 'start' first),
+// without moving any keys yet. each key in a full bucket on the path could
+// move to its bucket in the other table
+// returns the index of the step in 'path' reaching a bucket with room, or -1
+// if none is found within MAX_SEARCH buckets
+static int plan_path(XuckoonHashTable *table, int64 key, int start,
+	Step *path) {
+	int nsteps = 0;
+	int t;
+	for (t = start; nsteps < 2; t = 3 - t) {
+		InnerTable *inner = inner_table(table, t);
+		Bucket *bucket = inner->buckets[key_address(inner, key, t)];
+		path[nsteps++] = (Step){t, bucket, -1, -1};
+		if (bucket->nkeys < inner->bucketsize) {
+			return nsteps - 1;
+		}
+	}
+
+	int i, s;
+	for (i = 0; i < nsteps; i++) {
+		Bucket *bucket = path[i].bucket;
+		t = 3 - path[i].t;
+		InnerTable *inner = inner_table(table, t);
+		for (s = 0; s < bucket->nkeys && nsteps < MAX_SEARCH; s++) {
+			int64 other = bucket->entries[s].key;
+			Bucket *next = inner->buckets[key_address(inner, other, t)];
+			// (never back onto the path, which would move keys twice)
+			if (on_path(path, i, next)) {
+				continue;
+			}
+			path[nsteps++] = (Step){t, next, s, i};
+			if (next->nkeys < inner->bucketsize) {
+				return nsteps - 1;
+			}
+		}
+	}
+	return -1;
+}
 
-	if (key == record && st == 2 && check > 0) {
-		split_bucket(table->table2, address, 2);
-		address = rightmostnbits(table->table2->depth, hash);
-		check = 0;
+// make room by moving an entry from each bucket on the path ending at
+// 'path[end]' into the next one (starting by adding one to the end bucket),
+// then put 'key' in the entry this frees at the start of the path
+static void follow_path(XuckoonHashTable *table, Step *path, int end,
+	int64 key, int64 value) {
+	int i = end;
+	int s = path[i].bucket->nkeys++;
+	for (; path[i].parent >= 0; i = path[i].parent) {
+		Step *prev = &path[path[i].parent];
+		path[i].bucket->entries[s] = prev->bucket->entries[path[i].slot];
+		inner_table(table, path[i].t)->nkeys++;
+		inner_table(table, prev->t)->nkeys--;
+		s = path[i].slot;
 	}
-	check++;
+	path[i].bucket->entries[s] = (Entry){key, value};
+	inner_table(table, path[i].t)->nkeys++;
+}
 
-	int nkeys = table->table2->buckets[address]->nkeys;
-	if (nkeys < table->table2->bucketsize) {
-		table->table2->buckets[address]->keys[nkeys] = key;
-		table->table2->buckets[address]->nkeys++;
-		table->table2->nkeys++;
-		return true;
-	} else {
-		// int rdm = rand() % (table->table2->bucketsize);
-		// using random number occurs segmentation fault
-		int old_key = table->table2->buckets[address]->keys[0];
-		table->table2->buckets[address]->keys[0] = key;
-		return xuckoon_rehash_1(table, old_key, record, st, check);
+// insert 'key' (which must not be in 'table' already) with value 'value',
+// starting in whichever table holds fewer keys
+static void insert_new(XuckoonHashTable *table, int64 key, int64 value) {
+	int start = table->table1->nkeys <= table->table2->nkeys ? 1 : 2;
+
+	// find a way to make room before moving anything. if there is none,
+	// split the key's bucket in its starting table and try again
+	Step path[MAX_SEARCH];
+	int end = plan_path(table, key, start, path);
+	while (end < 0) {
+		InnerTable *inner = inner_table(table, start);
+		split_bucket(inner, key_address(inner, key, start), start);
+		end = plan_path(table, key, start, path);
 	}
+	follow_path(table, path, end, key, value);
 }
 
 bool xuckoon_hash_table_insert(XuckoonHashTable *table, int64 key) {
 	assert(table);
 
-	if (xuckoon_hash_table_lookup(table, key)) {
+	if (find_entry(table, key)) {
 		return false;
 	}
-	if (table->table1->nkeys <= table->table2->nkeys) {
-		return xuckoon_rehash_1(table, key, key, 1, 0);
-	} else {
-		return xuckoon_rehash_2(table, key, key, 2, 0);
-	}
+	insert_new(table, key, 0);
+	return true;
 }
 
-bool inner_n_table_loopup(InnerTable *table, int64 key, int address) {
+// find the entry holding 'key' in the bucket at 'address', or NULL
+static Entry *inner_n_table_find(InnerTable *table, int64 key, int address) {
+	Bucket *bucket = table->buckets[address];
 	int i;
+	for (i=0; i<bucket->nkeys; i++) {
+		if (key == bucket->entries[i].key) {
+			return &bucket->entries[i];
+		}
+	}
+	return NULL;
+}
 
-	bool found = false;
-	if (table->buckets[address]->nkeys != 0) {
-		for (i=0; i<table->buckets[address]->nkeys; i++) {
-			if (key == table->buckets[address]->keys[i]) {
-				found = true;
-			}
+// find the entry holding 'key' in either table, or NULL
+static Entry *find_entry(XuckoonHashTable *table, int64 key) {
+	int ht1 = rightmostnbits(table->table1->depth, h1_64(key));
+	Entry *entry = inner_n_table_find(table->table1, key, ht1);
+	if (entry) {
+		return entry;
+	}
+	int ht2 = rightmostnbits(table->table2->depth, h2_64(key));
+	return inner_n_table_find(table->table2, key, ht2);
+}
+
+bool xuckoon_hash_table_lookup(XuckoonHashTable *table, int64 key) {
+	assert(table);
+	return find_entry(table, key) != NULL;
+}
+
+// lookup a group of keys, prefetching both candidate buckets of every key a
+// level at a time (table entry, then bucket) before scanning any of them
+int xuckoon_hash_table_lookup_batch(XuckoonHashTable *table, int64 *keys,
+	int n, bool *results) {
+	assert(table);
+
+	Bucket **entries1[BATCH_GROUP], **entries2[BATCH_GROUP];
+	Bucket *buckets1[BATCH_GROUP], *buckets2[BATCH_GROUP];
+	int ht1[BATCH_GROUP], ht2[BATCH_GROUP];
+	int found = 0;
+	int i, j;
+	for (i=0; i<n; i+=BATCH_GROUP) {
+		int group = n - i < BATCH_GROUP ? n - i : BATCH_GROUP;
+
+		for (j=0; j<group; j++) {
+			ht1[j] = rightmostnbits(table->table1->depth, h1_64(keys[i+j]));
+			ht2[j] = rightmostnbits(table->table2->depth, h2_64(keys[i+j]));
+			entries1[j] = &table->table1->buckets[ht1[j]];
+			entries2[j] = &table->table2->buckets[ht2[j]];
+			prefetch(entries1[j]);
+			prefetch(entries2[j]);
+		}
+		for (j=0; j<group; j++) {
+			buckets1[j] = *entries1[j];
+			buckets2[j] = *entries2[j];
+			prefetch(buckets1[j]);
+			prefetch(buckets2[j]);
+		}
+
+		for (j=0; j<group; j++) {
+			results[i+j] = inner_n_table_find(table->table1, keys[i+j], ht1[j])
+				|| inner_n_table_find(table->table2, keys[i+j], ht2[j]);
+			found += results[i+j];
 		}
 	}
 	return found;
 }
 
-bool xuckoon_hash_table_lookup(XuckoonHashTable *table, int64 key) {
+bool xuckoon_hash_table_put(XuckoonHashTable *table, int64 key, int64 value) {
 	assert(table);
 
-	int ht1 = rightmostnbits(table->table1->depth, h1(key));
-	int ht2 = rightmostnbits(table->table2->depth, h2(key));
+	Entry *entry = find_entry(table, key);
+	if (entry) {
+		entry->value = value;
+		return false;
+	}
+	insert_new(table, key, value);
+	return true;
+}
 
-	if (inner_n_table_loopup(table->table1, key, ht1)) {
-		return true;
+bool xuckoon_hash_table_get(XuckoonHashTable *table, int64 key, int64 *value) {
+	assert(table);
+
+	Entry *entry = find_entry(table, key);
+	if (entry && value) {
+		*value = entry->value;
 	}
-	if (inner_n_table_loopup(table->table2, key, ht2)) {
-		return true;
+	return entry != NULL;
+}
+
+bool xuckoon_hash_table_get_or_insert(XuckoonHashTable *table, int64 key,
+	int64 value, int64 *result) {
+	assert(table);
+
+	Entry *entry = find_entry(table, key);
+	if (entry) {
+		value = entry->value;
+	} else {
+		insert_new(table, key, value);
+	}
+	if (result) {
+		*result = value;
+	}
+	return entry == NULL;
+}
+
+// remove 'key' from the bucket at 'address', moving the bucket's last key
+// into its place so that the keys stay packed at the front
+bool inner_n_table_delete(InnerTable *table, int64 key, int address) {
+	Bucket *bucket = table->buckets[address];
+	int i;
+	for (i=0; i<bucket->nkeys; i++) {
+		if (bucket->entries[i].key == key) {
+			bucket->nkeys--;
+			bucket->entries[i] = bucket->entries[bucket->nkeys];
+			table->nkeys--;
+			return true;
+		}
 	}
 	return false;
 }
 
+bool xuckoon_hash_table_delete(XuckoonHashTable *table, int64 key) {
+	assert(table);
+
+	int ht1 = rightmostnbits(table->table1->depth, h1_64(key));
+	if (inner_n_table_delete(table->table1, key, ht1)) {
+		return true;
+	}
+	int ht2 = rightmostnbits(table->table2->depth, h2_64(key));
+	return inner_n_table_delete(table->table2, key, ht2);
+}
+
 void xuckoon_hash_table_print(XuckoonHashTable *table) {
 	assert(table);
 	printf("--- table ---\n");
@@ -297,7 +459,7 @@ void xuckoon_hash_table_print(XuckoonHashTable *table) {
 				printf("[");
 				for (j=0; j<innertables[t]->bucketsize; j++) {
 					if (j<innertables[t]->buckets[i]->nkeys) {
-						printf(" %llu", innertables[t]->buckets[i]->keys[j]);
+						printf(" %llu", innertables[t]->buckets[i]->entries[j].key);
 					} else {
 						printf(" -");
 					}
@@ -317,4 +479,10 @@ void xuckoon_hash_table_stats(XuckoonHashTable *table) {
 	printf("Table 1: %d items\n", table->table1->nkeys);
 	printf("Table 2: %d items\n", table->table2->nkeys);
 	printf("--- end stats ---\n");
-}
\ No newline at end of file
+}
+
+int xuckoon_hash_table_capacity(XuckoonHashTable *table) {
+	assert(table);
+	return (table->table1->nbuckets + table->table2->nbuckets)
+		* table->table1->bucketsize;
+}
@@ -21,8 +21,22 @@ bool xuckoon_hash_table_insert(XuckoonHashTable *table, int64 key);
 
 bool xuckoon_hash_table_lookup(XuckoonHashTable *table, int64 key);
 
+int xuckoon_hash_table_lookup_batch(XuckoonHashTable *table, int64 *keys,
+	int n, bool *results);
+
+bool xuckoon_hash_table_put(XuckoonHashTable *table, int64 key, int64 value);
+
+bool xuckoon_hash_table_get(XuckoonHashTable *table, int64 key, int64 *value);
+
+bool xuckoon_hash_table_get_or_insert(XuckoonHashTable *table, int64 key,
+	int64 value, int64 *result);
+
+bool xuckoon_hash_table_delete(XuckoonHashTable *table, int64 key);
+
 void xuckoon_hash_table_print(XuckoonHashTable *table);
 
 void xuckoon_hash_table_stats(XuckoonHashTable *table);
 
+int xuckoon_hash_table_capacity(XuckoonHashTable *table);
+
 #endif
\ No newline at end of file